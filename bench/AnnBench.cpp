@@ -0,0 +1,117 @@
+/**
+ * @file AnnBench.cpp
+ * @brief This file contains the recall and throughput benchmark of the HNSW index against brute force.
+ *
+ * The benchmark generates clustered, normalized vectors that resemble function embeddings, computes the exact
+ * top-k of every query with the batched dot-product kernel, and compares the HNSW results at several
+ * candidate list sizes.
+ */
+
+#include "Bench.h"
+#include "HnswIndex.h"
+#include "VectorKernels.h"
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Generates random cluster centers.
+ */
+std::vector<float> clusterCenters(size_t clusters, size_t dimension, std::mt19937_64& rng) {
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::vector<float> centers(clusters * dimension);
+    for (float& value : centers) {
+        value = normal(rng);
+    }
+    return centers;
+}
+
+/**
+ * @brief Generates count normalized vectors scattered around the given cluster centers.
+ */
+std::vector<float> clusteredVectors(size_t count, size_t dimension, const std::vector<float>& centers,
+                                    std::mt19937_64& rng) {
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::uniform_int_distribution<size_t> pick(0, centers.size() / dimension - 1);
+    std::vector<float> vectors(count * dimension);
+    for (size_t i = 0; i < count; ++i) {
+        const float* center = centers.data() + pick(rng) * dimension;
+        float* row = vectors.data() + i * dimension;
+        for (size_t d = 0; d < dimension; ++d) {
+            row[d] = center[d] + 0.35f * normal(rng);
+        }
+        normalizeVector(row, row, dimension);
+    }
+    return vectors;
+}
+
+} // namespace
+
+/**
+ * @brief Runs the recall and throughput benchmarks of the HNSW index against brute force.
+ *
+ * The index is built once; build time is measured with a single repetition since it dominates the run.
+ */
+void runAnnBenches(const BenchConfig& config, BenchReporter& reporter) {
+    if (!reporter.enabled("ann_")) {
+        return;
+    }
+    const size_t count = std::max<size_t>(1000, static_cast<size_t>(100000 * config.scale));
+    const size_t dimension = 128;
+    const size_t queries = 1000;
+    const size_t k = 10;
+    const std::string input = "clustered_n" + std::to_string(count) + "_dim" + std::to_string(dimension);
+
+    std::mt19937_64 rng(config.seed);
+    const size_t clusters = std::max<size_t>(1, count / 1000);
+    const std::vector<float> centers = clusterCenters(clusters, dimension, rng);
+    std::vector<float> base = clusteredVectors(count, dimension, centers, rng);
+    std::vector<float> queryVectors = clusteredVectors(queries, dimension, centers, rng);
+
+    // Exact top-k
+    std::vector<std::vector<uint32_t>> truth(queries);
+    std::vector<float> scores(count);
+    std::vector<uint32_t> ids(count);
+    // Timed once: it is the reference for recall, and scanning every vector per query is slow at full scale.
+    std::vector<double> seconds = {timeOnce([&]() {
+        for (size_t q = 0; q < queries; ++q) {
+            dotBatch(queryVectors.data() + q * dimension, base.data(), count, dimension, scores.data());
+            std::iota(ids.begin(), ids.end(), 0);
+            const size_t top = std::min(k, count);
+            std::partial_sort(ids.begin(), ids.begin() + top, ids.end(),
+                              [&](uint32_t a, uint32_t b) { return scores[a] > scores[b]; });
+            truth[q].assign(ids.begin(), ids.begin() + top);
+        }
+    })};
+    reporter.report("ann_brute_force", input, seconds, static_cast<double>(queries), "queries",
+                    {{"k", static_cast<double>(k)}, {"recall", 1.0}});
+
+    HnswIndex index(dimension);
+    seconds = {timeOnce([&]() { index.build(base.data(), count, config.threads); })};
+    reporter.report("ann_hnsw_build", input, seconds, static_cast<double>(count), "vectors",
+                    {{"M", static_cast<double>(index.params().M)},
+                     {"ef_construction", static_cast<double>(index.params().efConstruction)}});
+
+    for (size_t ef : {16, 32, 64, 128, 256}) {
+        std::vector<std::vector<SearchResult>> results;
+        seconds = measure(config.repeat, [&]() { index.searchBatch(queryVectors.data(), queries, k, results, 1, ef); });
+
+        size_t found = 0;
+        size_t expected = 0;
+        for (size_t q = 0; q < queries; ++q) {
+            std::unordered_set<uint32_t> exact(truth[q].begin(), truth[q].end());
+            expected += exact.size();
+            for (const SearchResult& hit : results[q]) {
+                found += exact.count(hit.id);
+            }
+        }
+        reporter.report("ann_hnsw_query", input, seconds, static_cast<double>(queries), "queries",
+                        {{"k", static_cast<double>(k)},
+                         {"ef", static_cast<double>(ef)},
+                         {"recall", expected ? double(found) / expected : 1.0}});
+    }
+}
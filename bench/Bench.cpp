@@ -0,0 +1,62 @@
+/**
+ * @file Bench.cpp
+ * @brief This file contains the JSON reporting of the benchmarks.
+ */
+
+#include "Bench.h"
+#include "JsonUtil.h"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+/**
+ * @brief Prints the run configuration as the first line of the output.
+ */
+void BenchReporter::environment(const BenchConfig& config, const char* kernels) {
+    out_ << "{\"bench\":\"environment\",\"kernels\":";
+    writeJsonString(out_, kernels);
+    out_ << ",\"hardware_threads\":" << std::thread::hardware_concurrency() << ",\"threads\":" << config.threads
+         << ",\"repeat\":" << config.repeat << ",\"scale\":" << config.scale << ",\"seed\":" << config.seed
+         << ",\"model\":";
+    writeJsonString(out_, config.modelPath);
+    out_ << ",\"embedding_model\":";
+    writeJsonString(out_, config.embeddingModelPath);
+    out_ << "}" << std::endl;
+}
+
+/**
+ * @brief Prints the timing of one benchmark.
+ *
+ * The median is the headline number; min and max show how noisy the run was.
+ */
+void BenchReporter::report(std::string_view bench, std::string_view input, const std::vector<double>& seconds,
+                           double items, std::string_view unit, const Fields& fields) {
+    std::vector<double> sorted = seconds;
+    std::sort(sorted.begin(), sorted.end());
+    const double median = sorted.empty() ? 0.0 : sorted[sorted.size() / 2];
+
+    out_ << "{\"bench\":";
+    writeJsonString(out_, bench);
+    out_ << ",\"input\":";
+    writeJsonString(out_, input);
+    out_ << ",\"repeat\":" << sorted.size() << ",\"median_s\":" << median
+         << ",\"min_s\":" << (sorted.empty() ? 0.0 : sorted.front())
+         << ",\"max_s\":" << (sorted.empty() ? 0.0 : sorted.back()) << ",\"items\":" << items << ",\"unit\":";
+    writeJsonString(out_, unit);
+    out_ << ",\"per_s\":" << (median > 0.0 ? items / median : 0.0);
+    for (const auto& field : fields) {
+        out_ << ",";
+        writeJsonString(out_, field.first);
+        out_ << ":" << field.second;
+    }
+    out_ << "}" << std::endl;
+}
+
+/**
+ * @brief Notes on stderr that a benchmark was skipped.
+ */
+void BenchReporter::skip(std::string_view bench, std::string_view reason) {
+    if (enabled(bench)) {
+        std::cerr << "Skipping " << bench << ": " << reason << std::endl;
+    }
+}
@@ -0,0 +1,114 @@
+/**
+ * @file Bench.h
+ * @brief This file contains the configuration, timing and JSON reporting shared by the benchmarks.
+ *
+ * Every measurement is printed as one JSON object per line, so runs can be diffed or loaded into a script to
+ * compare before and after a change. All inputs are generated from a fixed seed, so two runs with the same
+ * configuration measure the same work.
+ */
+
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Options of a benchmark run.
+ */
+struct BenchConfig {
+    std::filesystem::path workDir;  ///< Directory the synthetic corpora are generated in.
+    std::string modelPath;          ///< Tokenizer model; the tokenize benchmarks are skipped without it.
+    std::string embeddingModelPath; ///< Embedding model; the embedding benchmarks are skipped without it.
+    std::string filter;             ///< Only benchmarks whose name contains this string run.
+    unsigned repeat = 5;            ///< Timed repetitions after one warm-up run.
+    double scale = 1.0;             ///< Multiplies the size of every generated input.
+    unsigned threads = 0;           ///< Worker threads, 0 selects the hardware concurrency.
+    uint64_t seed = 1234;
+};
+
+/**
+ * @brief Writes benchmark results as JSON lines.
+ */
+class BenchReporter {
+public:
+    using Fields = std::vector<std::pair<std::string, double>>;
+
+    BenchReporter(std::ostream& out, std::string filter) : out_(out), filter_(std::move(filter)) {}
+
+    /**
+     * @brief Returns whether a benchmark passes the name filter.
+     */
+    bool enabled(std::string_view bench) const {
+        return filter_.empty() || bench.find(filter_) != std::string_view::npos;
+    }
+
+    /**
+     * @brief Prints the run configuration as the first line of the output.
+     */
+    void environment(const BenchConfig& config, const char* kernels);
+
+    /**
+     * @brief Prints the timing of one benchmark.
+     * @param bench The benchmark name.
+     * @param input The name of the input, e.g. the corpus.
+     * @param seconds The duration of each timed repetition.
+     * @param items The amount of work done per repetition.
+     * @param unit The unit of items, e.g. "functions" or "bytes".
+     * @param fields Additional numeric fields.
+     */
+    void report(std::string_view bench, std::string_view input, const std::vector<double>& seconds, double items,
+                std::string_view unit, const Fields& fields = {});
+
+    /**
+     * @brief Notes on stderr that a benchmark was skipped.
+     */
+    void skip(std::string_view bench, std::string_view reason);
+
+private:
+    std::ostream& out_;
+    std::string filter_;
+};
+
+/**
+ * @brief Times a single call of a function.
+ * @return The duration in seconds.
+ */
+template <typename Fn>
+double timeOnce(Fn&& fn) {
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    fn();
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * @brief Times a function after one untimed warm-up call.
+ * @param repeat The number of timed calls.
+ * @param fn The function to time.
+ * @return The duration of each timed call in seconds.
+ */
+template <typename Fn>
+std::vector<double> measure(unsigned repeat, Fn&& fn) {
+    fn();
+    std::vector<double> seconds;
+    seconds.reserve(repeat);
+    for (unsigned r = 0; r < repeat; ++r) {
+        seconds.push_back(timeOnce(fn));
+    }
+    return seconds;
+}
+
+/**
+ * @brief Runs the file reading, extraction, tokenization, packing and embedding benchmarks.
+ */
+void runPipelineBenches(const BenchConfig& config, BenchReporter& reporter);
+
+/**
+ * @brief Runs the recall and throughput benchmarks of the HNSW index against brute force.
+ */
+void runAnnBenches(const BenchConfig& config, BenchReporter& reporter);
@@ -0,0 +1,91 @@
+/**
+ * @file BenchMain.cpp
+ * @brief This file contains the entry point of the code_chunk_bench benchmark suite.
+ *
+ * Usage: code_chunk_bench [--filter NAME] [--model PATH] [--embedding-model PATH] [--repeat N] [--scale X]
+ *                         [--threads N] [--seed N] [--work-dir DIR] [--output FILE]
+ *
+ * Results are printed as JSON lines on stdout, or written to --output.
+ */
+
+#include "Bench.h"
+#include "VectorKernels.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+
+void printBenchUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "Options:\n"
+              << "  --filter NAME          Only run benchmarks whose name contains NAME\n"
+              << "  --model PATH           Tokenizer model for the tokenize benchmarks\n"
+              << "  --embedding-model PATH Embedding model for the embedding benchmarks\n"
+              << "  --repeat N             Timed repetitions per benchmark (default: 5)\n"
+              << "  --scale X              Size multiplier of the generated inputs (default: 1)\n"
+              << "  --threads N            Worker threads (default: hardware concurrency)\n"
+              << "  --seed N               Seed of the generated inputs (default: 1234)\n"
+              << "  --work-dir DIR         Directory for the generated corpora (default: a temporary directory)\n"
+              << "  --output FILE          Write the JSON lines to FILE instead of stdout\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    config.workDir = std::filesystem::temp_directory_path() / "code_chunk_bench";
+    std::string outputPath;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printBenchUsage(argv[0]);
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (arg == "--filter") {
+            config.filter = value;
+        } else if (arg == "--model") {
+            config.modelPath = value;
+        } else if (arg == "--embedding-model") {
+            config.embeddingModelPath = value;
+        } else if (arg == "--repeat") {
+            config.repeat = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--scale") {
+            config.scale = std::strtod(value, nullptr);
+        } else if (arg == "--threads") {
+            config.threads = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--seed") {
+            config.seed = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--work-dir") {
+            config.workDir = value;
+        } else if (arg == "--output") {
+            outputPath = value;
+        } else {
+            printBenchUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.repeat == 0 || config.scale <= 0.0) {
+        printBenchUsage(argv[0]);
+        return 1;
+    }
+
+    std::ofstream outputFile;
+    if (!outputPath.empty()) {
+        outputFile.open(outputPath, std::ios::trunc);
+        if (!outputFile) {
+            std::cerr << "Failed to open " << outputPath << std::endl;
+            return 1;
+        }
+    }
+    BenchReporter reporter(outputFile.is_open() ? outputFile : std::cout, config.filter);
+    reporter.environment(config, vectorKernelName());
+
+    runPipelineBenches(config, reporter);
+    runAnnBenches(config, reporter);
+    return 0;
+}
@@ -0,0 +1,218 @@
+/**
+ * @file CorpusGenerator.cpp
+ * @brief This file contains the implementation of the synthetic source corpus generators.
+ */
+
+#include "CorpusGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+size_t scaled(size_t count, double scale) {
+    return std::max<size_t>(1, static_cast<size_t>(std::lround(count * scale)));
+}
+
+/**
+ * @brief Appends a loop body of the given number of statements.
+ */
+void writeStatements(std::ostringstream& out, size_t count, std::mt19937_64& rng, const std::string& indent) {
+    std::uniform_int_distribution<int> value(1, 97);
+    for (size_t s = 0; s < count; ++s) {
+        switch (rng() % 4) {
+            case 0:
+                out << indent << "total += values[" << s % 8 << "] * " << value(rng) << ";\n";
+                break;
+            case 1:
+                out << indent << "if (total > " << value(rng) * 100 << ") { total -= " << value(rng) << "; }\n";
+                break;
+            case 2:
+                out << indent << "for (int i = 0; i < " << value(rng) << "; ++i) { total ^= i << 1; }\n";
+                break;
+            default:
+                out << indent << "values[" << s % 8 << "] = static_cast<int>(total % " << value(rng) << ");\n";
+                break;
+        }
+    }
+}
+
+std::string manySmallFile(size_t file, std::mt19937_64& rng) {
+    std::ostringstream out;
+    out << "// Generated: many small functions\n\n";
+    for (size_t f = 0; f < 80; ++f) {
+        out << "int small_" << file << "_" << f << "(int* values, long total) {\n";
+        writeStatements(out, 2 + rng() % 7, rng, "    ");
+        out << "    return static_cast<int>(total);\n}\n\n";
+    }
+    out << "class Widget" << file << " {\npublic:\n";
+    for (size_t m = 0; m < 20; ++m) {
+        out << "    int method" << m << "(int x) const { return x * " << m + 1 << " + state_; }\n";
+    }
+    out << "private:\n    int state_ = 0;\n};\n";
+    return out.str();
+}
+
+std::string fewHugeFile(size_t file, std::mt19937_64& rng) {
+    std::ostringstream out;
+    out << "// Generated: a few huge functions\n\n";
+    for (size_t f = 0; f < 3; ++f) {
+        out << "long huge_" << file << "_" << f << "(int* values, long total) {\n";
+        out << "    switch (values[0]) {\n";
+        const size_t cases = 300 + rng() % 300;
+        for (size_t c = 0; c < cases; ++c) {
+            out << "    case " << c << ": {\n";
+            writeStatements(out, 6, rng, "        ");
+            out << "        break;\n    }\n";
+        }
+        out << "    default:\n        break;\n    }\n    return total;\n}\n\n";
+    }
+    return out.str();
+}
+
+std::string deepNestingFile(size_t file, std::mt19937_64& rng) {
+    std::ostringstream out;
+    out << "// Generated: deep nesting\n\n";
+    const size_t namespaces = 8;
+    for (size_t n = 0; n < namespaces; ++n) {
+        out << "namespace level" << n << " {\n";
+    }
+    out << "struct Outer" << file << " {\n    struct Middle {\n        struct Inner {\n";
+    for (size_t f = 0; f < 10; ++f) {
+        out << "            long nested" << f << "(int* values, long total) const {\n";
+        const size_t depth = 12 + rng() % 12;
+        std::string indent = "                ";
+        for (size_t d = 0; d < depth; ++d) {
+            out << indent << (d % 3 == 0 ? "if (total != " : d % 3 == 1 ? "while (total < " : "for (; total > ")
+                << d << (d % 3 == 2 ? "; --total) {\n" : ") {\n");
+            indent += "    ";
+            if (d % 3 == 1) {
+                out << indent << "++total;\n";
+            }
+        }
+        writeStatements(out, 3, rng, indent);
+        for (size_t d = depth; d-- > 0;) {
+            indent.resize(indent.size() - 4);
+            out << indent << "}\n";
+        }
+        out << "                return total;\n            }\n";
+    }
+    out << "        };\n    };\n};\n";
+    for (size_t n = namespaces; n-- > 0;) {
+        out << "} // namespace level" << n << "\n";
+    }
+    return out.str();
+}
+
+std::string heavyTemplatesFile(size_t file, std::mt19937_64& rng) {
+    std::ostringstream out;
+    out << "// Generated: heavy templates\n"
+        << "#include <algorithm>\n#include <functional>\n#include <map>\n#include <memory>\n"
+        << "#include <string>\n#include <tuple>\n#include <unordered_map>\n#include <vector>\n\n";
+    out << "template <typename T, typename... Rest>\nstruct Fold" << file << " {\n"
+        << "    static constexpr size_t size = sizeof(T) + Fold" << file << "<Rest...>::size;\n};\n"
+        << "template <typename T>\nstruct Fold" << file << "<T> {\n    static constexpr size_t size = sizeof(T);\n};\n\n";
+    for (size_t f = 0; f < 30; ++f) {
+        out << "size_t instantiate_" << file << "_" << f << "(const std::vector<std::string>& names) {\n"
+            << "    std::map<std::string, std::tuple<int, double, std::unique_ptr<int>>> table;\n"
+            << "    std::unordered_map<int, std::function<int(int)>> calls;\n"
+            << "    for (const auto& name : names) {\n"
+            << "        table.emplace(name, std::make_tuple(" << rng() % 100 << ", 1.5, std::make_unique<int>(1)));\n"
+            << "        calls[static_cast<int>(name.size())] = [](int x) { return x * " << f + 1 << "; };\n"
+            << "    }\n"
+            << "    std::vector<std::pair<std::string, int>> sorted;\n"
+            << "    for (const auto& entry : table) { sorted.emplace_back(entry.first, std::get<0>(entry.second)); }\n"
+            << "    std::sort(sorted.begin(), sorted.end());\n"
+            << "    return sorted.size() + Fold" << file << "<int, double, std::string, std::vector<int>>::size;\n"
+            << "}\n\n";
+    }
+    return out.str();
+}
+
+} // namespace
+
+const char* corpusName(CorpusKind kind) {
+    switch (kind) {
+        case CorpusKind::ManySmall:
+            return "many_small";
+        case CorpusKind::FewHuge:
+            return "few_huge";
+        case CorpusKind::DeepNesting:
+            return "deep_nesting";
+        case CorpusKind::HeavyTemplates:
+            return "heavy_templates";
+    }
+    return "unknown";
+}
+
+std::vector<CorpusKind> allCorpusKinds() {
+    return {CorpusKind::ManySmall, CorpusKind::FewHuge, CorpusKind::DeepNesting, CorpusKind::HeavyTemplates};
+}
+
+/**
+ * @brief Writes a corpus into directory/corpusName(kind).
+ *
+ * Files are rewritten on every call, so a stale corpus from a run with another scale is never measured.
+ */
+std::vector<fs::path> generateCorpus(CorpusKind kind, const fs::path& directory, double scale, uint64_t seed) {
+    const fs::path root = directory / corpusName(kind);
+    std::error_code error;
+    fs::remove_all(root, error);
+    fs::create_directories(root, error);
+
+    size_t files = 0;
+    switch (kind) {
+        case CorpusKind::ManySmall:
+            files = scaled(200, scale);
+            break;
+        case CorpusKind::FewHuge:
+            files = scaled(4, scale);
+            break;
+        case CorpusKind::DeepNesting:
+            files = scaled(40, scale);
+            break;
+        case CorpusKind::HeavyTemplates:
+            files = scaled(20, scale);
+            break;
+    }
+
+    std::mt19937_64 rng(seed ^ (static_cast<uint64_t>(kind) + 1) * 0x9E3779B97F4A7C15ull);
+    std::vector<fs::path> paths;
+    paths.reserve(files);
+    for (size_t file = 0; file < files; ++file) {
+        std::string text;
+        switch (kind) {
+            case CorpusKind::ManySmall:
+                text = manySmallFile(file, rng);
+                break;
+            case CorpusKind::FewHuge:
+                text = fewHugeFile(file, rng);
+                break;
+            case CorpusKind::DeepNesting:
+                text = deepNestingFile(file, rng);
+                break;
+            case CorpusKind::HeavyTemplates:
+                text = heavyTemplatesFile(file, rng);
+                break;
+        }
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "file%05zu.cpp", file);
+        const fs::path path = root / name;
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << text;
+        if (!out) {
+            std::cerr << "Failed to write " << path << std::endl;
+            return {};
+        }
+        paths.push_back(path);
+    }
+    return paths;
+}
@@ -0,0 +1,40 @@
+/**
+ * @file CorpusGenerator.h
+ * @brief This file contains the declarations of the synthetic source corpus generators used by the benchmarks.
+ */
+
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+/**
+ * @brief Shapes of generated corpora, each stressing a different part of the pipeline.
+ */
+enum class CorpusKind {
+    ManySmall,      ///< Many files of short functions: per-file and per-function overheads.
+    FewHuge,        ///< A few files with functions of thousands of lines: tokenization and oversized chunks.
+    DeepNesting,    ///< Nested namespaces, classes and blocks: scope tracking and brace matching.
+    HeavyTemplates, ///< Standard headers and template instantiations: libclang header parsing.
+};
+
+/**
+ * @brief Returns the name of a corpus kind as used in benchmark output, e.g. "many_small".
+ */
+const char* corpusName(CorpusKind kind);
+
+/**
+ * @brief Returns every corpus kind.
+ */
+std::vector<CorpusKind> allCorpusKinds();
+
+/**
+ * @brief Writes a corpus into directory/corpusName(kind).
+ * @param kind The shape of the corpus.
+ * @param directory The parent directory.
+ * @param scale Multiplies the number of files.
+ * @param seed The random seed; the same seed always produces the same files.
+ * @return The generated files, sorted.
+ */
+std::vector<std::filesystem::path> generateCorpus(CorpusKind kind, const std::filesystem::path& directory,
+                                                  double scale, uint64_t seed);
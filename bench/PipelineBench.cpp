@@ -0,0 +1,372 @@
+/**
+ * @file PipelineBench.cpp
+ * @brief This file contains the benchmarks of the extraction, tokenization, packing and embedding stages.
+ */
+
+#include "Bench.h"
+#include "ChunkPlanner.h"
+#include "CorpusGenerator.h"
+#include "EmbeddingEngine.h"
+#include "FileUtils.h"
+#include "Hash.h"
+#include "LexicalExtractor.h"
+#include "ModelLoader.h"
+#include "ParallelExtractor.h"
+#include "SourceBuffer.h"
+#include "TokenEstimator.h"
+#include "Tokenizer.h"
+#include "VectorKernels.h"
+#include <clang-c/Index.h>
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <random>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/// Keeps results that are otherwise unused from being optimized away.
+volatile uint64_t benchSink = 0;
+
+/// The benchmarks that share the tokenized corpus functions.
+const std::vector<std::string_view> kTokenizerBenches = {"tokenize", "tokenize_count", "estimate", "tokenize_batch"};
+
+/// Every benchmark run on the generated corpora.
+const std::vector<std::string_view> kCorpusBenches = {"read_files",     "extract_ast", "extract_lexical", "tokenize",
+                                                      "tokenize_count", "estimate",    "tokenize_batch"};
+
+/**
+ * @brief Returns whether any of a group of benchmarks passes the name filter.
+ */
+bool anyEnabled(const BenchReporter& reporter, const std::vector<std::string_view>& benches) {
+    return std::any_of(benches.begin(), benches.end(),
+                       [&](std::string_view bench) { return reporter.enabled(bench); });
+}
+
+/**
+ * @brief The functions of a corpus together with the mapped files their text refers to.
+ */
+struct CorpusFunctions {
+    std::vector<std::unique_ptr<SourceBuffer>> sources;
+    std::vector<FunctionInfo> functions;
+    std::vector<std::string_view> texts;
+};
+
+CorpusFunctions loadCorpusFunctions(const std::vector<fs::path>& files) {
+    CorpusFunctions corpus;
+    for (const fs::path& file : files) {
+        auto source = std::make_unique<SourceBuffer>();
+        if (!source->open(file)) {
+            continue;
+        }
+        const size_t first = corpus.functions.size();
+        extractFileFunctionsLexical(file, *source, nullptr, nullptr, 0, corpus.functions);
+        for (size_t i = first; i < corpus.functions.size(); ++i) {
+            corpus.texts.push_back(source->slice(corpus.functions[i].startOffset, corpus.functions[i].endOffset));
+        }
+        corpus.sources.push_back(std::move(source));
+    }
+    return corpus;
+}
+
+void benchCorpus(CorpusKind kind, const BenchConfig& config, BenchReporter& reporter, const Tokenizer* tokenizer) {
+    const char* name = corpusName(kind);
+    const std::vector<fs::path> files = generateCorpus(kind, config.workDir, config.scale, config.seed);
+    if (files.empty()) {
+        return;
+    }
+    const fs::path root = config.workDir / name;
+
+    if (reporter.enabled("read_files")) {
+        size_t bytes = 0;
+        const auto seconds = measure(config.repeat, [&]() {
+            bytes = 0;
+            uint64_t checksum = 0;
+            for (const fs::path& file : collectSourceFiles(root)) {
+                SourceBuffer source;
+                if (source.open(file)) {
+                    checksum ^= hashString(source.text()) + source.lineCount();
+                    bytes += source.text().size();
+                }
+            }
+            benchSink = checksum;
+        });
+        reporter.report("read_files", name, seconds, static_cast<double>(bytes), "bytes",
+                        {{"files", static_cast<double>(files.size())}});
+    }
+
+    for (ExtractMode mode : {ExtractMode::Ast, ExtractMode::Lexical}) {
+        const char* bench = mode == ExtractMode::Ast ? "extract_ast" : "extract_lexical";
+        if (!reporter.enabled(bench)) {
+            continue;
+        }
+        size_t functions = 0;
+        const auto seconds = measure(config.repeat, [&]() {
+            functions = 0;
+            CXIndex index = mode == ExtractMode::Ast ? clang_createIndex(0, 0) : nullptr;
+            std::vector<FunctionInfo> infos;
+            for (const fs::path& file : files) {
+                SourceBuffer source;
+                infos.clear();
+                if (!source.open(file)) {
+                    continue;
+                }
+                if (mode == ExtractMode::Ast) {
+                    extractFileFunctions(index, file, source, nullptr, nullptr, nullptr, infos);
+                } else {
+                    extractFileFunctionsLexical(file, source, nullptr, nullptr, 0, infos);
+                }
+                functions += infos.size();
+            }
+            if (index) {
+                clang_disposeIndex(index);
+            }
+        });
+        reporter.report(bench, name, seconds, static_cast<double>(functions), "functions",
+                        {{"files", static_cast<double>(files.size())}});
+    }
+
+    if (!anyEnabled(reporter, kTokenizerBenches)) {
+        return;
+    }
+    if (!tokenizer) {
+        reporter.skip("tokenize", "no --model given");
+        return;
+    }
+    const CorpusFunctions corpus = loadCorpusFunctions(files);
+    size_t bytes = 0;
+    for (std::string_view text : corpus.texts) {
+        bytes += text.size();
+    }
+
+    size_t tokens = 0;
+    auto seconds = measure(config.repeat, [&]() {
+        std::vector<llama_token> buffer;
+        tokens = 0;
+        for (std::string_view text : corpus.texts) {
+            tokenizer->tokenize(text, buffer);
+            tokens += buffer.size();
+        }
+    });
+    if (reporter.enabled("tokenize")) {
+        reporter.report("tokenize", name, seconds, static_cast<double>(tokens), "tokens",
+                        {{"functions", static_cast<double>(corpus.texts.size())}, {"bytes", static_cast<double>(bytes)}});
+    }
+
+    if (reporter.enabled("tokenize_count")) {
+        size_t counted = 0;
+        seconds = measure(config.repeat, [&]() {
+            counted = 0;
+            for (std::string_view text : corpus.texts) {
+                counted += static_cast<size_t>(tokenizer->count(text));
+            }
+        });
+        reporter.report("tokenize_count", name, seconds, static_cast<double>(counted), "tokens",
+                        {{"functions", static_cast<double>(corpus.texts.size())}});
+    }
+
+    if (reporter.enabled("estimate")) {
+        std::vector<int> counts;
+        for (std::string_view text : corpus.texts) {
+            counts.push_back(tokenizer->count(text));
+        }
+        TokenEstimator estimator;
+        estimator.calibrate(corpus.texts, counts);
+
+        double absoluteError = 0.0;
+        size_t outside = 0;
+        seconds = measure(config.repeat, [&]() {
+            absoluteError = 0.0;
+            outside = 0;
+            for (size_t i = 0; i < corpus.texts.size(); ++i) {
+                const TokenEstimate estimate = estimator.estimate(corpus.texts[i]);
+                absoluteError += std::abs(estimate.tokens - counts[i]);
+                outside += counts[i] < estimate.low || counts[i] > estimate.high ? 1 : 0;
+            }
+        });
+        const double n = static_cast<double>(std::max<size_t>(corpus.texts.size(), 1));
+        reporter.report("estimate", name, seconds, static_cast<double>(tokens), "tokens",
+                        {{"functions", static_cast<double>(corpus.texts.size())},
+                         {"relative_error", absoluteError / std::max<double>(static_cast<double>(tokens), 1.0)},
+                         {"outside_bounds", static_cast<double>(outside) / n}});
+    }
+
+    if (reporter.enabled("tokenize_batch")) {
+        seconds = measure(config.repeat, [&]() {
+            std::vector<std::vector<llama_token>> batch;
+            tokenizer->tokenize_batch(corpus.texts, batch);
+        });
+        reporter.report("tokenize_batch", name, seconds, static_cast<double>(tokens), "tokens",
+                        {{"functions", static_cast<double>(corpus.texts.size())}});
+    }
+}
+
+/**
+ * @brief Generates function token counts without any source, for the packer benchmarks.
+ */
+FunctionTable syntheticFunctions(bool heavyTail, size_t count, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<int> uniform(50, 400);
+    std::lognormal_distribution<double> lognormal(5.0, 1.0);
+    FunctionTable functions;
+    functions.reserve(count);
+    FunctionInfo info{};
+    for (size_t i = 0; i < count; ++i) {
+        info.filePath = "file" + std::to_string(i / 50) + ".cpp";
+        info.startLine = static_cast<int>(i % 50) * 20 + 1;
+        info.endLine = info.startLine + 10;
+        info.tokenCount = heavyTail ? std::min(8000, static_cast<int>(lognormal(rng)) + 1) : uniform(rng);
+        functions.append(info);
+    }
+    return functions;
+}
+
+void benchPacking(const BenchConfig& config, BenchReporter& reporter) {
+    const size_t count = std::max<size_t>(1, static_cast<size_t>(200000 * config.scale));
+    for (bool heavyTail : {false, true}) {
+        const FunctionTable functions = syntheticFunctions(heavyTail, count, config.seed);
+        const int budget = ChunkPlanner::suggestBudget(functions);
+        const int64_t totalTokens = functions.totalTokens();
+
+        for (const char* strategyName : {"first-fit", "best-fit-decreasing", "locality"}) {
+            const std::string bench = std::string("pack_") + strategyName;
+            if (!reporter.enabled(bench)) {
+                continue;
+            }
+            PackingStrategy strategy;
+            parsePackingStrategy(strategyName, strategy);
+            ChunkPlanner planner(budget, strategy);
+            size_t chunks = 0;
+            const auto seconds = measure(config.repeat, [&]() { chunks = planner.plan(functions).size(); });
+            const double capacity = static_cast<double>(chunks) * budget;
+            reporter.report(bench, heavyTail ? "heavy_tail" : "uniform", seconds, static_cast<double>(count),
+                            "functions",
+                            {{"budget", static_cast<double>(budget)},
+                             {"chunks", static_cast<double>(chunks)},
+                             {"fill", capacity > 0 ? totalTokens / capacity : 0.0}});
+        }
+    }
+}
+
+void benchVectors(const BenchConfig& config, BenchReporter& reporter) {
+    std::mt19937_64 rng(config.seed);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    for (int dimension : {384, 768, 4096}) {
+        const size_t count = std::max<size_t>(1, static_cast<size_t>(20000 * config.scale * 384 / dimension));
+        std::vector<float> vectors(count * dimension);
+        for (float& value : vectors) {
+            value = normal(rng);
+        }
+        std::vector<float> output(vectors.size());
+        const std::string input = "dim" + std::to_string(dimension);
+
+        if (reporter.enabled("normalize")) {
+            const auto seconds = measure(config.repeat, [&]() {
+                for (size_t i = 0; i < count; ++i) {
+                    normalize(vectors.data() + i * dimension, output.data() + i * dimension, dimension);
+                }
+            });
+            reporter.report("normalize", input, seconds, static_cast<double>(count), "vectors");
+        }
+        if (reporter.enabled("dot_batch")) {
+            std::vector<float> scores(count);
+            const auto seconds = measure(config.repeat, [&]() {
+                dotBatch(vectors.data(), vectors.data(), count, dimension, scores.data());
+            });
+            reporter.report("dot_batch", input, seconds, static_cast<double>(count), "vectors");
+        }
+    }
+}
+
+void benchEmbeddings(const BenchConfig& config, BenchReporter& reporter, llama_model* embeddingModel) {
+    const bool single = reporter.enabled("generate_embeddings");
+    const bool batched = reporter.enabled("embed_batched");
+    if (!single && !batched) {
+        return;
+    }
+    if (!embeddingModel) {
+        reporter.skip(single ? "generate_embeddings" : "embed_batched", "no --embedding-model given");
+        return;
+    }
+
+    // Embedding is slow, so a fixed sample of the small-function corpus is used regardless of scale.
+    const std::vector<fs::path> files = generateCorpus(CorpusKind::ManySmall, config.workDir, 0.05, config.seed);
+    const CorpusFunctions corpus = loadCorpusFunctions(files);
+    Tokenizer tokenizer(embeddingModel);
+    std::vector<std::vector<llama_token>> sequences;
+    tokenizer.tokenize_batch(corpus.texts, sequences);
+    EmbeddingEngineParams params;
+    params.threads = config.threads;
+    for (auto& tokens : sequences) {
+        tokens.resize(std::min<size_t>(tokens.size(), params.batchTokens));
+    }
+    sequences.resize(std::min<size_t>(sequences.size(), 512));
+    size_t tokenTotal = 0;
+    for (const auto& tokens : sequences) {
+        tokenTotal += tokens.size();
+    }
+    const BenchReporter::Fields fields = {{"tokens", static_cast<double>(tokenTotal)}};
+
+    if (single) {
+        llama_context_params ctx_params = llama_context_default_params();
+        ctx_params.embeddings = true;
+        ctx_params.n_ctx = params.batchTokens;
+        ctx_params.n_batch = params.batchTokens;
+        ctx_params.n_ubatch = params.batchTokens;
+        if (config.threads > 0) {
+            ctx_params.n_threads = config.threads;
+            ctx_params.n_threads_batch = config.threads;
+        }
+        llama_context* ctx = llama_new_context_with_model(embeddingModel, ctx_params);
+        if (ctx) {
+            const auto seconds = measure(config.repeat, [&]() {
+                for (const auto& tokens : sequences) {
+                    generate_embeddings(ctx, tokens);
+                }
+            });
+            reporter.report("generate_embeddings", "many_small", seconds, static_cast<double>(sequences.size()),
+                            "sequences", fields);
+            llama_free(ctx);
+        }
+    }
+    if (batched) {
+        EmbeddingEngine engine(embeddingModel, params);
+        if (engine.valid()) {
+            std::vector<float> output;
+            const auto seconds = measure(config.repeat, [&]() { engine.embed(sequences, output); });
+            reporter.report("embed_batched", "many_small", seconds, static_cast<double>(sequences.size()),
+                            "sequences", fields);
+        }
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Runs the file reading, extraction, tokenization, packing and embedding benchmarks.
+ */
+void runPipelineBenches(const BenchConfig& config, BenchReporter& reporter) {
+    llama_model* model = config.modelPath.empty() ? nullptr : load_model(config.modelPath.c_str());
+    std::unique_ptr<Tokenizer> tokenizer = model ? std::make_unique<Tokenizer>(model) : nullptr;
+
+    if (anyEnabled(reporter, kCorpusBenches)) {
+        for (CorpusKind kind : allCorpusKinds()) {
+            benchCorpus(kind, config, reporter, tokenizer.get());
+        }
+    }
+    benchPacking(config, reporter);
+    benchVectors(config, reporter);
+
+    llama_model* embeddingModel =
+        config.embeddingModelPath.empty() ? nullptr : load_model(config.embeddingModelPath.c_str(), false);
+    benchEmbeddings(config, reporter, embeddingModel);
+
+    tokenizer.reset();
+    if (model) {
+        llama_free_model(model);
+    }
+    if (embeddingModel) {
+        llama_free_model(embeddingModel);
+    }
+}
@@ -0,0 +1,155 @@
+/**
+ * @file BoundedQueue.h
+ * @brief This file contains a bounded, lock-free multi-producer multi-consumer queue.
+ *
+ * The queue is Dmitry Vyukov's bounded MPMC ring buffer: every cell carries a sequence number, and producers
+ * and consumers claim cells with a single compare-and-swap on their own position counter. The blocking
+ * push() and pop() wrappers back off when the queue is full or empty, which is how the streaming pipeline
+ * applies backpressure between stages. close() marks the end of the stream.
+ */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+
+/**
+ * @brief Bounded MPMC queue with blocking, backoff-based push and pop.
+ * @tparam T The element type; must be default-constructible and move-assignable.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    /**
+     * @brief Creates a queue.
+     * @param capacity The number of elements the queue holds, rounded up to a power of two.
+     */
+    explicit BoundedQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        mask_ = size - 1;
+        cells_ = std::make_unique<Cell[]>(size);
+        for (size_t i = 0; i < size; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /**
+     * @brief Pushes an element if there is room.
+     * @param value The element; moved from only on success.
+     * @return True if the element was pushed.
+     */
+    bool tryPush(T& value) {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Pops an element if one is available.
+     * @param value Receives the element.
+     * @return True if an element was popped.
+     */
+    bool tryPop(T& value) {
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    cell.value = T();
+                    cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Pushes an element, waiting while the queue is full.
+     * @param value The element.
+     * @return False if the queue was closed before the element could be pushed.
+     */
+    bool push(T value) {
+        for (unsigned attempt = 0; !tryPush(value); ++attempt) {
+            if (closed_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            backoff(attempt);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Pops an element, waiting while the queue is empty.
+     * @param value Receives the element.
+     * @return False once the queue is closed and drained.
+     */
+    bool pop(T& value) {
+        for (unsigned attempt = 0; !tryPop(value); ++attempt) {
+            if (closed_.load(std::memory_order_acquire)) {
+                return tryPop(value);
+            }
+            backoff(attempt);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Marks the end of the stream. Consumers drain the remaining elements, then pop() returns false.
+     */
+    void close() { closed_.store(true, std::memory_order_release); }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    /**
+     * @brief Spins briefly, then yields, then sleeps, so idle stages do not burn a core.
+     */
+    static void backoff(unsigned attempt) {
+        if (attempt < 64) {
+            return;
+        }
+        if (attempt < 128) {
+            std::this_thread::yield();
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> enqueuePos_{0};
+    alignas(64) std::atomic<size_t> dequeuePos_{0};
+    alignas(64) std::atomic<bool> closed_{false};
+};
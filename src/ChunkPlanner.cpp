@@ -0,0 +1,289 @@
+/**
+ * @file ChunkPlanner.cpp
+ * @brief This file contains the implementation of the ChunkPlanner.
+ */
+
+#include "ChunkPlanner.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <set>
+#include <utility>
+
+namespace {
+
+/**
+ * @brief Number of recently opened chunks the locality strategy may still add to.
+ */
+constexpr size_t kLocalityWindow = 4;
+
+/**
+ * @brief Max segment tree over the remaining capacity of chunk slots.
+ *
+ * Every slot starts with the full budget, so the first slot that has never been used is always the leftmost
+ * slot past the opened chunks. Finding the leftmost slot with enough room therefore either returns an open
+ * chunk or the next chunk to open.
+ */
+class CapacityTree {
+public:
+    CapacityTree(size_t slots, int capacity) : size_(1) {
+        while (size_ < slots) {
+            size_ *= 2;
+        }
+        tree_.assign(2 * size_, capacity);
+    }
+
+    /**
+     * @brief Finds the leftmost slot with at least the requested capacity.
+     * @param need The requested capacity.
+     * @return The slot index, or size() if no slot has enough room.
+     */
+    size_t findFirst(int need) const {
+        if (tree_[1] < need) {
+            return size_;
+        }
+        size_t node = 1;
+        while (node < size_) {
+            node = tree_[2 * node] >= need ? 2 * node : 2 * node + 1;
+        }
+        return node - size_;
+    }
+
+    void set(size_t slot, int capacity) {
+        size_t node = slot + size_;
+        tree_[node] = capacity;
+        for (node /= 2; node >= 1; node /= 2) {
+            tree_[node] = std::max(tree_[2 * node], tree_[2 * node + 1]);
+        }
+    }
+
+    int get(size_t slot) const { return tree_[slot + size_]; }
+    size_t size() const { return size_; }
+
+private:
+    size_t size_;
+    std::vector<int> tree_;
+};
+
+} // namespace
+
+/**
+ * @brief The chunk of every function while a strategy runs, turned into a ChunkPlan at the end.
+ */
+struct ChunkAssignment {
+    std::vector<uint32_t> visit;   ///< Functions in the order the strategy placed them.
+    std::vector<uint32_t> chunkOf; ///< Chunk of each function, by function index.
+    std::vector<int> tokens;       ///< Token count of each chunk.
+
+    explicit ChunkAssignment(size_t functions) : chunkOf(functions) { visit.reserve(functions); }
+
+    /**
+     * @brief Opens a new chunk holding a single function.
+     * @return The index of the new chunk.
+     */
+    size_t open(uint32_t function, int need) {
+        tokens.push_back(need);
+        visit.push_back(function);
+        chunkOf[function] = static_cast<uint32_t>(tokens.size() - 1);
+        return tokens.size() - 1;
+    }
+
+    /**
+     * @brief Adds a function to an open chunk.
+     */
+    void place(uint32_t function, size_t chunk, int need) {
+        tokens[chunk] += need;
+        visit.push_back(function);
+        chunkOf[function] = static_cast<uint32_t>(chunk);
+    }
+
+    /**
+     * @brief Groups the functions by chunk with a counting sort, keeping the placement order within a chunk.
+     */
+    ChunkPlan finish() const {
+        ChunkPlan plan;
+        plan.chunks.resize(tokens.size());
+        for (uint32_t function : visit) {
+            ++plan.chunks[chunkOf[function]].end;
+        }
+        uint32_t offset = 0;
+        for (size_t c = 0; c < plan.chunks.size(); ++c) {
+            const uint32_t count = plan.chunks[c].end;
+            plan.chunks[c] = {offset, offset, tokens[c]};
+            offset += count;
+        }
+        plan.order.resize(visit.size());
+        for (uint32_t function : visit) {
+            plan.order[plan.chunks[chunkOf[function]].end++] = function;
+        }
+        return plan;
+    }
+};
+
+/**
+ * @brief Packs functions into chunks.
+ * @param functions The functions to pack.
+ * @return The plan, whose chunks are in the order they were opened.
+ */
+ChunkPlan ChunkPlanner::plan(const FunctionTable& functions) const {
+    TRACE_SCOPE("pack");
+    ChunkAssignment assignment(functions.size());
+    switch (strategy_) {
+        case PackingStrategy::BestFitDecreasing:
+            planBestFitDecreasing(functions, assignment);
+            break;
+        case PackingStrategy::Locality:
+            planLocality(functions, assignment);
+            break;
+        case PackingStrategy::FirstFit:
+        default:
+            planFirstFit(functions, assignment);
+            break;
+    }
+    return assignment.finish();
+}
+
+/**
+ * @brief First-fit in input order, using a capacity tree to find the first chunk with room in O(log n).
+ */
+void ChunkPlanner::planFirstFit(const FunctionTable& functions, ChunkAssignment& assignment) const {
+    const std::vector<int>& tokens = functions.tokenCounts();
+    CapacityTree capacities(std::max<size_t>(tokens.size(), 1), budget_);
+
+    for (uint32_t i = 0; i < tokens.size(); ++i) {
+        const int need = tokens[i];
+        size_t slot = need <= budget_ ? capacities.findFirst(need) : assignment.tokens.size();
+
+        if (slot >= assignment.tokens.size()) {
+            slot = assignment.open(i, need);
+        } else {
+            assignment.place(i, slot, need);
+        }
+        capacities.set(slot, std::max(0, budget_ - assignment.tokens[slot]));
+    }
+}
+
+/**
+ * @brief Best-fit decreasing, using an ordered set of (remaining capacity, chunk) pairs.
+ *
+ * Functions are placed largest first; each goes to the open chunk with the smallest remaining capacity that
+ * still holds it. Ties are broken by chunk index so that the result is deterministic.
+ */
+void ChunkPlanner::planBestFitDecreasing(const FunctionTable& functions, ChunkAssignment& assignment) const {
+    const std::vector<int>& tokens = functions.tokenCounts();
+    std::vector<uint32_t> order(tokens.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return tokens[a] > tokens[b]; });
+
+    std::set<std::pair<int, size_t>> open;
+
+    for (uint32_t i : order) {
+        const int need = tokens[i];
+        auto it = open.lower_bound({need, 0});
+
+        if (need > budget_ || it == open.end()) {
+            const size_t chunk = assignment.open(i, need);
+            if (need < budget_) {
+                open.insert({budget_ - need, chunk});
+            }
+            continue;
+        }
+
+        const size_t chunk = it->second;
+        open.erase(it);
+        assignment.place(i, chunk, need);
+        if (assignment.tokens[chunk] < budget_) {
+            open.insert({budget_ - assignment.tokens[chunk], chunk});
+        }
+    }
+}
+
+/**
+ * @brief Locality-preserving packing.
+ *
+ * Functions are taken in (file, start line) order. Each goes to the first chunk with room among the last
+ * kLocalityWindow opened chunks, so a chunk only ever holds functions that are close together in the
+ * sorted order, which keeps files and the namespaces inside them together.
+ */
+void ChunkPlanner::planLocality(const FunctionTable& functions, ChunkAssignment& assignment) const {
+    const std::vector<int>& tokens = functions.tokenCounts();
+    std::vector<uint32_t> order(tokens.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        if (functions.fileId(a) != functions.fileId(b)) {
+            return functions.filePath(a) < functions.filePath(b);
+        }
+        return functions.startLine(a) < functions.startLine(b);
+    });
+
+    for (uint32_t i : order) {
+        const int need = tokens[i];
+        bool placed = false;
+
+        const size_t chunks = assignment.tokens.size();
+        const size_t windowStart = chunks > kLocalityWindow ? chunks - kLocalityWindow : 0;
+        for (size_t c = windowStart; c < chunks && need <= budget_; ++c) {
+            if (assignment.tokens[c] + need <= budget_) {
+                assignment.place(i, c, need);
+                placed = true;
+                break;
+            }
+        }
+
+        if (!placed) {
+            assignment.open(i, need);
+        }
+    }
+}
+
+/**
+ * @brief Suggests a power-of-two budget that minimizes padding.
+ * @param functions The functions to pack.
+ * @return The suggested budget.
+ */
+int ChunkPlanner::suggestBudget(const FunctionTable& functions) {
+    int64_t totalTokens = 0;
+    int maxTokenCount = 1;
+    for (int tokenCount : functions.tokenCounts()) {
+        totalTokens += tokenCount;
+        maxTokenCount = std::max(maxTokenCount, tokenCount);
+    }
+
+    int64_t chunkSize = static_cast<int64_t>(std::pow(2, std::ceil(std::log2(maxTokenCount))));
+    int64_t optimalChunkSize = chunkSize;
+    int64_t minPadding = totalTokens;
+    for (int64_t currentChunkSize = chunkSize; currentChunkSize <= totalTokens; currentChunkSize *= 2) {
+        int64_t numChunks = (totalTokens + currentChunkSize - 1) / currentChunkSize;
+        int64_t currentPadding = numChunks * currentChunkSize - totalTokens;
+
+        if (currentPadding >= minPadding) {
+            break;
+        }
+        minPadding = currentPadding;
+        optimalChunkSize = currentChunkSize;
+        if (minPadding == 0) {
+            break;
+        }
+    }
+    return static_cast<int>(optimalChunkSize);
+}
+
+/**
+ * @brief Parses a packing strategy name.
+ * @param name The strategy name.
+ * @param strategy Receives the parsed strategy.
+ * @return True if the name was recognized.
+ */
+bool parsePackingStrategy(const std::string& name, PackingStrategy& strategy) {
+    if (name == "first-fit") {
+        strategy = PackingStrategy::FirstFit;
+    } else if (name == "best-fit-decreasing" || name == "bfd") {
+        strategy = PackingStrategy::BestFitDecreasing;
+    } else if (name == "locality") {
+        strategy = PackingStrategy::Locality;
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file ChunkPlanner.h
+ * @brief This file contains the declaration of the ChunkPlanner, which packs functions into token-bounded chunks.
+ *
+ * The planner supports several bin-packing strategies:
+ * - FirstFit: functions in input order, each placed in the first chunk with room.
+ * - BestFitDecreasing: largest functions first, each placed in the chunk it fills most tightly.
+ * - Locality: functions ordered by file and line, placed in one of the few most recently opened chunks, so
+ *   that neighbouring functions of the same file end up together.
+ *
+ * All strategies run in O(n log n) and accept any positive budget. A plan holds no copies of the functions: it
+ * is one permutation of their indices, grouped by chunk, and each chunk is a range of that permutation.
+ */
+
+#pragma once
+#include "FunctionTable.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The bin-packing strategy used by the ChunkPlanner.
+ */
+enum class PackingStrategy {
+    FirstFit,
+    BestFitDecreasing,
+    Locality,
+};
+
+/**
+ * @brief A chunk of functions: the range [begin, end) of ChunkPlan::order.
+ */
+struct Chunk {
+    uint32_t begin = 0;
+    uint32_t end = 0;
+    int tokenCount = 0;
+
+    size_t size() const { return end - begin; }
+};
+
+/**
+ * @brief The result of packing: every function index exactly once, grouped by chunk.
+ */
+struct ChunkPlan {
+    std::vector<uint32_t> order; ///< Function indices, the members of each chunk stored contiguously.
+    std::vector<Chunk> chunks;   ///< The chunks, in the order they were opened.
+
+    size_t size() const { return chunks.size(); }
+
+    /**
+     * @brief Returns the index of the k-th function of a chunk.
+     */
+    uint32_t function(const Chunk& chunk, size_t k) const { return order[chunk.begin + k]; }
+};
+
+struct ChunkAssignment;
+
+/**
+ * @brief Packs functions into chunks whose token count does not exceed a budget.
+ *
+ * A function larger than the budget is placed alone in its own chunk.
+ */
+class ChunkPlanner {
+public:
+    /**
+     * @brief Creates a planner.
+     * @param budget The maximum number of tokens per chunk.
+     * @param strategy The packing strategy.
+     */
+    ChunkPlanner(int budget, PackingStrategy strategy) : budget_(budget), strategy_(strategy) {}
+
+    /**
+     * @brief Packs functions into chunks.
+     * @param functions The functions to pack.
+     * @return The plan, whose chunks are in the order they were opened.
+     */
+    ChunkPlan plan(const FunctionTable& functions) const;
+
+    /**
+     * @brief Suggests a power-of-two budget that minimizes padding.
+     * @param functions The functions to pack.
+     * @return The smallest power of two that holds the largest function, doubled while that reduces the
+     *         padding of the total token count.
+     */
+    static int suggestBudget(const FunctionTable& functions);
+
+    int budget() const { return budget_; }
+    PackingStrategy strategy() const { return strategy_; }
+
+private:
+    void planFirstFit(const FunctionTable& functions, ChunkAssignment& assignment) const;
+    void planBestFitDecreasing(const FunctionTable& functions, ChunkAssignment& assignment) const;
+    void planLocality(const FunctionTable& functions, ChunkAssignment& assignment) const;
+
+    int budget_;
+    PackingStrategy strategy_;
+};
+
+/**
+ * @brief Parses a packing strategy name.
+ * @param name One of "first-fit", "best-fit-decreasing" (or "bfd"), "locality".
+ * @param strategy Receives the parsed strategy.
+ * @return True if the name was recognized.
+ */
+bool parsePackingStrategy(const std::string& name, PackingStrategy& strategy);
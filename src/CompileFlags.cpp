@@ -0,0 +1,413 @@
+/**
+ * @file CompileFlags.cpp
+ * @brief This file contains the implementation of the per-file compiler arguments.
+ */
+
+#include "CompileFlags.h"
+#include "SourceBuffer.h"
+#include <clang-c/CXCompilationDatabase.h>
+#include <clang-c/Index.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * @brief Copies a CXString into a std::string and disposes it.
+ */
+std::string takeString(CXString string) {
+    const char* text = clang_getCString(string);
+    std::string result = text ? text : "";
+    clang_disposeString(string);
+    return result;
+}
+
+/**
+ * @brief Converts a compiler command line into libclang arguments.
+ *
+ * The compiler, the input file, the output and the dependency-file options are dropped. The command's directory
+ * is passed with -working-directory so that relative include paths resolve as they do in the build.
+ */
+std::vector<std::string> toParseArguments(CXCompileCommand command, const fs::path& directory, const fs::path& file) {
+    static const std::unordered_set<std::string> dropWithValue = {"-o", "-MF", "-MT", "-MQ"};
+    static const std::unordered_set<std::string> drop = {"-c", "-MD", "-MMD", "-M", "-MM", "-MP"};
+
+    std::vector<std::string> arguments;
+    const unsigned numArgs = clang_CompileCommand_getNumArgs(command);
+    for (unsigned i = 1; i < numArgs; ++i) {
+        std::string arg = takeString(clang_CompileCommand_getArg(command, i));
+        if (dropWithValue.count(arg)) {
+            ++i;
+            continue;
+        }
+        if (arg == "--") {
+            break;
+        }
+        if (drop.count(arg) || arg.rfind("-o", 0) == 0 || (directory / arg).lexically_normal() == file) {
+            continue;
+        }
+        arguments.push_back(std::move(arg));
+    }
+    arguments.push_back("-working-directory");
+    arguments.push_back(directory.string());
+    return arguments;
+}
+
+std::string trim(std::string_view text) {
+    const size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string_view::npos) {
+        return {};
+    }
+    const size_t end = text.find_last_not_of(" \t");
+    return std::string(text.substr(begin, end - begin + 1));
+}
+
+/**
+ * @brief Collects the #include directives at the top of a file.
+ * @param source The mapped file.
+ * @param includes Receives the include targets, e.g. "<vector>" or "\"util.h\"".
+ * @return False if another directive such as #define or #if comes before the first declaration, in which case a
+ *         shared prefix header could change the meaning of the file.
+ */
+bool scanLeadingIncludes(const SourceBuffer& source, std::vector<std::string>& includes) {
+    bool inComment = false;
+    for (size_t n = 1; n <= source.lineCount(); ++n) {
+        std::string line = trim(source.line(n));
+        if (inComment) {
+            const size_t end = line.find("*/");
+            if (end == std::string::npos) {
+                continue;
+            }
+            line = trim(std::string_view(line).substr(end + 2));
+            inComment = false;
+        }
+        if (line.empty() || line.rfind("//", 0) == 0) {
+            continue;
+        }
+        if (line.rfind("/*", 0) == 0) {
+            inComment = line.find("*/", 2) == std::string::npos;
+            continue;
+        }
+        if (line[0] != '#') {
+            return true;
+        }
+
+        std::string directive = trim(std::string_view(line).substr(1));
+        if (directive.rfind("pragma once", 0) == 0) {
+            continue;
+        }
+        if (directive.rfind("include", 0) != 0) {
+            return false;
+        }
+        std::string target = trim(std::string_view(directive).substr(7));
+        if (target.empty() || (target[0] != '<' && target[0] != '"')) {
+            return false;
+        }
+        const size_t close = target[0] == '<' ? target.find('>') : target.find('"', 1);
+        if (close == std::string::npos) {
+            return false;
+        }
+        includes.push_back(target.substr(0, close + 1));
+    }
+    return true;
+}
+
+/**
+ * @brief The directories searched for #include "..." and #include <...>, in the order the compiler searches them.
+ *
+ * The system directories the compiler adds on its own are not listed; headers found there are identified by their
+ * spelling, which is safe because every file compared shares the same argument list.
+ */
+struct IncludePaths {
+    std::vector<fs::path> quoted;
+    std::vector<fs::path> angled;
+};
+
+/**
+ * @brief Collects the -iquote, -I and -isystem directories of an argument list.
+ * @param arguments The parse arguments, ending with -working-directory.
+ * @return The search directories, made absolute against the working directory.
+ */
+IncludePaths includePaths(const std::vector<std::string>& arguments) {
+    fs::path workingDirectory;
+    for (size_t i = 0; i + 1 < arguments.size(); ++i) {
+        if (arguments[i] == "-working-directory") {
+            workingDirectory = arguments[i + 1];
+        }
+    }
+
+    IncludePaths paths;
+    std::vector<fs::path> system;
+    for (size_t i = 0; i < arguments.size(); ++i) {
+        const std::string& arg = arguments[i];
+        for (const char* flag : {"-iquote", "-isystem", "-I"}) {
+            const size_t length = std::char_traits<char>::length(flag);
+            if (arg.compare(0, length, flag) != 0) {
+                continue;
+            }
+            std::string value = arg.substr(length);
+            if (value.empty() && i + 1 < arguments.size()) {
+                value = arguments[++i];
+            }
+            const fs::path directory = (workingDirectory / value).lexically_normal();
+            if (flag[1] == 'q') {
+                paths.quoted.push_back(directory);
+            } else if (flag[2] == 's') {
+                system.push_back(directory);
+            } else {
+                paths.angled.push_back(directory);
+            }
+            break;
+        }
+    }
+    paths.angled.insert(paths.angled.end(), system.begin(), system.end());
+    return paths;
+}
+
+/**
+ * @brief Identifies the header an #include directive refers to.
+ * @param include The include target as written, e.g. "<vector>" or "\"util.h\"".
+ * @param file The absolute path of the including file.
+ * @param paths The including file's search directories.
+ * @return The target as "\"<real path>\"" if it resolves to a file in the search directories, otherwise as
+ *         "<name>". Either form can be written back into an #include directive.
+ */
+std::string resolveInclude(const std::string& include, const fs::path& file, const IncludePaths& paths) {
+    const std::string name = include.substr(1, include.size() - 2);
+    std::vector<fs::path> directories;
+    if (include[0] == '"') {
+        directories.push_back(file.parent_path());
+        directories.insert(directories.end(), paths.quoted.begin(), paths.quoted.end());
+    }
+    directories.insert(directories.end(), paths.angled.begin(), paths.angled.end());
+    if (fs::path(name).is_absolute()) {
+        directories.assign(1, fs::path());
+    }
+
+    for (const fs::path& directory : directories) {
+        std::error_code error;
+        const fs::path resolved = fs::canonical(directory / name, error);
+        if (!error && fs::is_regular_file(resolved, error)) {
+            return "\"" + resolved.string() + "\"";
+        }
+    }
+    return "<" + name + ">";
+}
+
+std::string joinArguments(const std::vector<std::string>& arguments) {
+    std::string joined;
+    for (const std::string& arg : arguments) {
+        joined += arg;
+        joined += '\0';
+    }
+    return joined;
+}
+
+} // namespace
+
+std::string CompileFlags::key(const fs::path& file) {
+    std::error_code error;
+    fs::path absolute = fs::absolute(file, error);
+    return (error ? file : absolute).lexically_normal().string();
+}
+
+/**
+ * @brief Loads the compile_commands.json found in a directory.
+ * @param directory The directory that contains compile_commands.json.
+ * @return False if the database could not be loaded.
+ */
+bool CompileFlags::loadDatabase(const fs::path& directory) {
+    CXCompilationDatabase_Error error = CXCompilationDatabase_NoError;
+    CXCompilationDatabase database = clang_CompilationDatabase_fromDirectory(directory.string().c_str(), &error);
+    if (error != CXCompilationDatabase_NoError || !database) {
+        std::cerr << "Failed to load compile_commands.json from " << directory << std::endl;
+        return false;
+    }
+
+    CXCompileCommands commands = clang_CompilationDatabase_getAllCompileCommands(database);
+    const unsigned count = clang_CompileCommands_getSize(commands);
+    for (unsigned i = 0; i < count; ++i) {
+        CXCompileCommand command = clang_CompileCommands_getCommand(commands, i);
+        const fs::path commandDirectory = takeString(clang_CompileCommand_getDirectory(command));
+        const fs::path file = (commandDirectory / takeString(clang_CompileCommand_getFilename(command))).lexically_normal();
+
+        std::vector<std::string> arguments = toParseArguments(command, commandDirectory, file);
+        directoryCommands_.emplace(key(file.parent_path()), arguments);
+        commands_.emplace(key(file), std::move(arguments));
+    }
+    clang_CompileCommands_dispose(commands);
+    clang_CompilationDatabase_dispose(database);
+    return true;
+}
+
+/**
+ * @brief Returns the arguments to parse a file with.
+ * @param file The source file.
+ * @return The arguments of the file's compile command, of the nearest command in an enclosing directory, or an
+ *         empty list.
+ */
+const std::vector<std::string>& CompileFlags::argumentsFor(const fs::path& file) const {
+    const std::string fileKey = key(file);
+    auto it = commands_.find(fileKey);
+    if (it != commands_.end()) {
+        return it->second;
+    }
+
+    // Files missing from the database, such as new or generated sources, borrow the flags of a neighbour.
+    for (fs::path directory = fs::path(fileKey).parent_path(); !directory.empty(); directory = directory.parent_path()) {
+        auto dir = directoryCommands_.find(directory.string());
+        if (dir != directoryCommands_.end()) {
+            return dir->second;
+        }
+        if (directory == directory.root_path()) {
+            break;
+        }
+    }
+    return empty_;
+}
+
+/**
+ * @brief Returns the arguments to parse a file with the precompiled header.
+ * @param file The source file.
+ * @return The arguments including -include-pch, or nullptr if the PCH does not apply to the file.
+ */
+const std::vector<std::string>* CompileFlags::precompiledArgumentsFor(const fs::path& file) const {
+    if (pchArguments_.empty() || !pchFiles_.count(key(file))) {
+        return nullptr;
+    }
+    return &pchArguments_;
+}
+
+/**
+ * @brief Precompiles the headers shared by most files into a PCH.
+ * @param files The files that will be parsed.
+ * @param directory The directory that receives the prefix header and its PCH.
+ * @return False if no PCH was built.
+ */
+bool CompileFlags::buildPrecompiledHeader(const std::vector<fs::path>& files, const fs::path& directory) {
+    // A PCH is only valid for the options it was built with, so it targets the most common argument list.
+    std::map<std::string, size_t> argumentCounts;
+    for (const fs::path& file : files) {
+        argumentCounts[joinArguments(argumentsFor(file))]++;
+    }
+    if (argumentCounts.empty()) {
+        return false;
+    }
+    const std::string dominant =
+        std::max_element(argumentCounts.begin(), argumentCounts.end(),
+                         [](const auto& a, const auto& b) { return a.second < b.second; })->first;
+
+    // Includes are compared by the header they resolve to, so "util.h" next to one file and "util.h" next to
+    // another stay distinct.
+    std::vector<std::pair<std::string, std::vector<std::string>>> candidates;
+    const std::vector<std::string>* baseArguments = nullptr;
+    for (const fs::path& file : files) {
+        const std::vector<std::string>& arguments = argumentsFor(file);
+        if (joinArguments(arguments) != dominant) {
+            continue;
+        }
+        SourceBuffer source;
+        std::vector<std::string> includes;
+        if (!source.open(file) || !scanLeadingIncludes(source, includes)) {
+            continue;
+        }
+        baseArguments = &arguments;
+        const IncludePaths paths = includePaths(arguments);
+        const std::string fileKey = key(file);
+        for (std::string& include : includes) {
+            include = resolveInclude(include, fileKey, paths);
+        }
+        candidates.emplace_back(fileKey, std::move(includes));
+    }
+
+    // The PCH stands in for the first includes of a file, so it only applies to files whose include sequence
+    // starts with exactly the prefix. Grow the prefix one header at a time while at least half the candidates
+    // still start with it.
+    std::vector<std::string> prefix;
+    std::vector<size_t> matching(candidates.size());
+    for (size_t i = 0; i < matching.size(); ++i) {
+        matching[i] = i;
+    }
+    for (;;) {
+        std::map<std::string, size_t> nextCounts;
+        for (size_t i : matching) {
+            const std::vector<std::string>& includes = candidates[i].second;
+            if (includes.size() > prefix.size()) {
+                nextCounts[includes[prefix.size()]]++;
+            }
+        }
+        if (nextCounts.empty()) {
+            break;
+        }
+        const auto next = std::max_element(nextCounts.begin(), nextCounts.end(),
+                                           [](const auto& a, const auto& b) { return a.second < b.second; });
+        if (next->second * 2 < candidates.size()) {
+            break;
+        }
+        prefix.push_back(next->first);
+        matching.erase(std::remove_if(matching.begin(), matching.end(),
+                                      [&](size_t i) {
+                                          const std::vector<std::string>& includes = candidates[i].second;
+                                          return includes.size() < prefix.size() ||
+                                                 includes[prefix.size() - 1] != prefix.back();
+                                      }),
+                       matching.end());
+    }
+    if (prefix.empty() || matching.size() < 2) {
+        return false;
+    }
+
+    std::error_code error;
+    fs::create_directories(directory, error);
+    const fs::path headerPath = fs::absolute(directory / "prefix.hpp", error);
+    const fs::path pchPath = fs::path(headerPath.string() + ".pch");
+    {
+        std::ofstream header(headerPath, std::ios::trunc);
+        for (const std::string& include : prefix) {
+            header << "#include " << include << "\n";
+        }
+        if (!header) {
+            std::cerr << "Failed to write " << headerPath << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<std::string> headerArguments = *baseArguments;
+    headerArguments.push_back("-x");
+    headerArguments.push_back("c++-header");
+    std::vector<const char*> argv;
+    for (const std::string& arg : headerArguments) {
+        argv.push_back(arg.c_str());
+    }
+
+    CXIndex index = clang_createIndex(0, 0);
+    CXTranslationUnit unit = nullptr;
+    const CXErrorCode parseError = clang_parseTranslationUnit2(
+        index, headerPath.string().c_str(), argv.data(), static_cast<int>(argv.size()), nullptr, 0,
+        CXTranslationUnit_ForSerialization | CXTranslationUnit_Incomplete, &unit);
+    bool saved = false;
+    if (parseError == CXError_Success && unit) {
+        saved = clang_saveTranslationUnit(unit, pchPath.string().c_str(), clang_defaultSaveOptions(unit)) ==
+                CXSaveError_None;
+        clang_disposeTranslationUnit(unit);
+    }
+    clang_disposeIndex(index);
+    if (!saved) {
+        std::cerr << "Failed to build precompiled header " << pchPath << std::endl;
+        return false;
+    }
+
+    pchArguments_ = *baseArguments;
+    pchArguments_.push_back("-include-pch");
+    pchArguments_.push_back(pchPath.string());
+    for (size_t i : matching) {
+        pchFiles_.insert(candidates[i].first);
+    }
+    std::cerr << "Precompiled " << prefix.size() << " headers for " << matching.size() << " files" << std::endl;
+    return true;
+}
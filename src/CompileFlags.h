@@ -0,0 +1,72 @@
+/**
+ * @file CompileFlags.h
+ * @brief This file contains the declaration of the per-file compiler arguments used to parse translation units.
+ *
+ * Arguments come from a compile_commands.json read through libclang's compilation database API. To avoid
+ * re-parsing the same framework headers in every translation unit, the headers that most files include first
+ * can be precompiled once into a PCH, which compatible files then load with -include-pch.
+ */
+
+#pragma once
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * @brief Compiler arguments for each source file, with an optional shared precompiled header.
+ *
+ * All lookups are const and read only tables built up front, so one instance can be shared by every parser thread.
+ */
+class CompileFlags {
+public:
+    /**
+     * @brief Loads the compile_commands.json found in a directory.
+     * @param directory The directory that contains compile_commands.json, usually the build directory.
+     * @return False if the database could not be loaded.
+     */
+    bool loadDatabase(const std::filesystem::path& directory);
+
+    /**
+     * @brief Precompiles the headers shared by most files into a PCH.
+     * @param files The files that will be parsed.
+     * @param directory The directory that receives the prefix header and its PCH.
+     * @return False if no PCH was built; files are then parsed without one.
+     *
+     * Only files that share the most common argument list and whose first lines are plain #include directives
+     * take part. Includes are compared by the header they resolve to, and the longest leading sequence shared by
+     * at least half of the files forms the prefix header. Only files whose includes start with that exact sequence
+     * load the PCH.
+     */
+    bool buildPrecompiledHeader(const std::vector<std::filesystem::path>& files, const std::filesystem::path& directory);
+
+    /**
+     * @brief Returns the arguments to parse a file with.
+     * @param file The source file.
+     * @return The arguments of the file's compile command, of the nearest command in an enclosing directory, or an
+     *         empty list.
+     */
+    const std::vector<std::string>& argumentsFor(const std::filesystem::path& file) const;
+
+    /**
+     * @brief Returns the arguments to parse a file with the precompiled header.
+     * @param file The source file.
+     * @return The arguments including -include-pch, or nullptr if the PCH does not apply to the file.
+     */
+    const std::vector<std::string>* precompiledArgumentsFor(const std::filesystem::path& file) const;
+
+    /**
+     * @brief Returns the number of compile commands loaded.
+     */
+    size_t size() const { return commands_.size(); }
+
+private:
+    static std::string key(const std::filesystem::path& file);
+
+    std::unordered_map<std::string, std::vector<std::string>> commands_;
+    std::unordered_map<std::string, std::vector<std::string>> directoryCommands_;
+    std::vector<std::string> empty_;
+    std::vector<std::string> pchArguments_;
+    std::unordered_set<std::string> pchFiles_;
+};
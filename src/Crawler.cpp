@@ -0,0 +1,624 @@
+/**
+ * @file Crawler.cpp
+ * @brief This file contains the implementation of the parallel source tree crawler and the file read-ahead pool.
+ */
+
+#include "Crawler.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cctype>
+#include <deque>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr size_t kGeneratedProbeBytes = 2048;
+constexpr size_t kReadAheadBlock = 256 * 1024;
+
+/**
+ * @brief One exclude rule, already split into its flags.
+ */
+struct IgnoreRule {
+    std::string base;    ///< Directory the rule applies under, relative to the crawl root, "" or ending in '/'.
+    std::string pattern; ///< The glob, without its '!', leading '/' or trailing '/'.
+    bool negate = false;
+    bool directoryOnly = false;
+    bool anchored = false; ///< Whether the pattern matches the path below base rather than the name alone.
+};
+
+using IgnoreRules = std::vector<IgnoreRule>;
+
+/**
+ * @brief Parses one line of a .gitignore file.
+ * @return False for blank lines and comments.
+ */
+bool parseIgnoreRule(std::string line, const std::string& base, IgnoreRule& rule) {
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+    while (!line.empty() && line.back() == ' ' && (line.size() < 2 || line[line.size() - 2] != '\\')) {
+        line.pop_back();
+    }
+    if (line.empty() || line[0] == '#') {
+        return false;
+    }
+
+    rule = IgnoreRule();
+    rule.base = base;
+    if (line[0] == '!') {
+        rule.negate = true;
+        line.erase(0, 1);
+    } else if (line[0] == '\\' && line.size() > 1 && (line[1] == '!' || line[1] == '#')) {
+        line.erase(0, 1);
+    }
+    if (!line.empty() && line.back() == '/') {
+        rule.directoryOnly = true;
+        line.pop_back();
+    }
+    rule.anchored = line.find('/') != std::string::npos;
+    if (!line.empty() && line[0] == '/') {
+        line.erase(0, 1);
+    }
+    rule.pattern = std::move(line);
+    return !rule.pattern.empty();
+}
+
+/**
+ * @brief Decides whether a path is excluded; the last matching rule wins.
+ * @param relative The path relative to the crawl root, with '/' separators.
+ */
+bool isIgnored(const IgnoreRules& rules, const std::string& relative, bool isDirectory) {
+    bool ignored = false;
+    const size_t slash = relative.rfind('/');
+    const std::string_view name = slash == std::string::npos ? std::string_view(relative)
+                                                             : std::string_view(relative).substr(slash + 1);
+    for (const IgnoreRule& rule : rules) {
+        if ((rule.directoryOnly && !isDirectory) || relative.compare(0, rule.base.size(), rule.base) != 0) {
+            continue;
+        }
+        const std::string_view below = std::string_view(relative).substr(rule.base.size());
+        if (globMatch(rule.pattern, rule.anchored ? below : name)) {
+            ignored = !rule.negate;
+        }
+    }
+    return ignored;
+}
+
+/**
+ * @brief Returns the rules of a directory: its parent's, followed by those of its own .gitignore if it has one.
+ */
+std::shared_ptr<const IgnoreRules> directoryRules(const fs::path& directory, const std::string& relative,
+                                                  const std::shared_ptr<const IgnoreRules>& parent) {
+    std::ifstream in(directory / ".gitignore");
+    if (!in) {
+        return parent;
+    }
+    auto rules = std::make_shared<IgnoreRules>(*parent);
+    const std::string base = relative.empty() ? std::string() : relative + '/';
+    std::string line;
+    IgnoreRule rule;
+    while (std::getline(in, line)) {
+        if (parseIgnoreRule(line, base, rule)) {
+            rules->push_back(std::move(rule));
+        }
+    }
+    return rules;
+}
+
+/**
+ * @brief Looks for the markers code generators put at the top of their output.
+ */
+bool looksGenerated(const fs::path& path) {
+    static const char* const kMarkers[] = {"@generated", "do not edit", "automatically generated", "auto-generated",
+                                           "autogenerated", "generated by"};
+
+    std::ifstream in(path, std::ios::binary);
+    std::string head(kGeneratedProbeBytes, '\0');
+    in.read(head.data(), static_cast<std::streamsize>(head.size()));
+    head.resize(static_cast<size_t>(in.gcount()));
+    std::transform(head.begin(), head.end(), head.begin(), [](unsigned char c) { return std::tolower(c); });
+    for (const char* marker : kMarkers) {
+        if (head.find(marker) != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Why a directory entry is or is not returned by the crawl.
+ */
+enum class FileVerdict {
+    Accepted,
+    NotSource, ///< Not a regular file with a source extension.
+    Excluded,
+    TooLarge,
+    Generated,
+};
+
+/**
+ * @brief Applies the per-file filters of the crawl, cheapest first.
+ * @param entry The file.
+ * @param relative The path of the file relative to the crawl root, with '/' separators.
+ * @param rules The exclude rules in force in the file's directory.
+ * @param options The extensions and filters.
+ */
+FileVerdict checkFile(const fs::directory_entry& entry, const std::string& relative, const IgnoreRules& rules,
+                      const CrawlOptions& options) {
+    std::error_code error;
+    if (!entry.is_regular_file(error) || !hasExtension(entry.path(), options.extensions)) {
+        return FileVerdict::NotSource;
+    }
+    if (isIgnored(rules, relative, false)) {
+        return FileVerdict::Excluded;
+    }
+    if (options.maxFileSize > 0 && entry.file_size(error) > options.maxFileSize) {
+        return FileVerdict::TooLarge;
+    }
+    if (options.skipGenerated && looksGenerated(entry.path())) {
+        return FileVerdict::Generated;
+    }
+    return FileVerdict::Accepted;
+}
+
+/**
+ * @brief Parses the exclude options into the rules that apply from the crawl root down.
+ */
+std::shared_ptr<const IgnoreRules> rootRules(const CrawlOptions& options) {
+    auto rules = std::make_shared<IgnoreRules>();
+    IgnoreRule rule;
+    for (const std::string& exclude : options.excludes) {
+        if (parseIgnoreRule(exclude, std::string(), rule)) {
+            rules->push_back(std::move(rule));
+        }
+    }
+    return rules;
+}
+
+/**
+ * @brief A directory waiting to be listed.
+ */
+struct DirectoryTask {
+    fs::path path;
+    std::string relative; ///< Relative to the crawl root, "" for the root itself.
+    std::shared_ptr<const IgnoreRules> rules;
+};
+
+} // namespace
+
+/**
+ * @brief Parses a comma-separated list of file extensions.
+ * @param text The text to parse.
+ * @param extensions Receives the lowercase extensions, each with a leading dot.
+ * @return True if the list held at least one extension.
+ */
+bool parseExtensions(const std::string& text, std::vector<std::string>& extensions) {
+    std::vector<std::string> parsed;
+    size_t begin = 0;
+    while (begin <= text.size()) {
+        size_t end = text.find(',', begin);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string extension = text.substr(begin, end - begin);
+        if (!extension.empty()) {
+            if (extension[0] != '.') {
+                extension.insert(extension.begin(), '.');
+            }
+            std::transform(extension.begin(), extension.end(), extension.begin(),
+                           [](unsigned char c) { return std::tolower(c); });
+            parsed.push_back(std::move(extension));
+        }
+        begin = end + 1;
+    }
+    if (parsed.empty()) {
+        return false;
+    }
+    extensions = std::move(parsed);
+    return true;
+}
+
+/**
+ * @brief Checks whether a path has one of the given extensions, ignoring case.
+ * @param path The path to check.
+ * @param extensions Lowercase extensions, with the dot.
+ * @return True if the extension of path is in the list.
+ */
+bool hasExtension(const fs::path& path, const std::vector<std::string>& extensions) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    return std::find(extensions.begin(), extensions.end(), ext) != extensions.end();
+}
+
+/**
+ * @brief Matches a path against a .gitignore-style glob.
+ * @param pattern The glob.
+ * @param text The path or file name to match.
+ * @return True if the whole text matches the pattern.
+ */
+bool globMatch(std::string_view pattern, std::string_view text) {
+    size_t p = 0;
+    size_t t = 0;
+    while (p < pattern.size()) {
+        const char c = pattern[p];
+        if (c == '*') {
+            if (p + 1 < pattern.size() && pattern[p + 1] == '*') {
+                // "**/" matches zero or more whole directories, any other "**" matches everything
+                const bool directories = p + 2 < pattern.size() && pattern[p + 2] == '/';
+                const std::string_view rest = pattern.substr(p + (directories ? 3 : 2));
+                for (size_t k = t; k <= text.size(); ++k) {
+                    if ((!directories || k == t || text[k - 1] == '/') && globMatch(rest, text.substr(k))) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            const std::string_view rest = pattern.substr(p + 1);
+            for (size_t k = t; k <= text.size(); ++k) {
+                if (globMatch(rest, text.substr(k))) {
+                    return true;
+                }
+                if (k < text.size() && text[k] == '/') {
+                    break;
+                }
+            }
+            return false;
+        }
+
+        if (t >= text.size() || ((c == '?' || c == '[') && text[t] == '/')) {
+            return false;
+        }
+        if (c == '?') {
+            ++p;
+            ++t;
+        } else if (c == '[' && pattern.find(']', p + 2) != std::string_view::npos) {
+            const size_t close = pattern.find(']', p + 2);
+            size_t i = p + 1;
+            const bool negate = pattern[i] == '!' || pattern[i] == '^';
+            i += negate;
+            bool matched = false;
+            for (; i < close; ++i) {
+                if (i + 2 < close && pattern[i + 1] == '-') {
+                    matched |= text[t] >= pattern[i] && text[t] <= pattern[i + 2];
+                    i += 2;
+                } else {
+                    matched |= text[t] == pattern[i];
+                }
+            }
+            if (matched == negate) {
+                return false;
+            }
+            p = close + 1;
+            ++t;
+        } else {
+            const char literal = c == '\\' && p + 1 < pattern.size() ? pattern[++p] : c;
+            if (literal != text[t]) {
+                return false;
+            }
+            ++p;
+            ++t;
+        }
+    }
+    return t == text.size();
+}
+
+/**
+ * @brief Collects the source files under a directory, or a single file.
+ *
+ * Worker threads pull directories from a shared queue, list them, queue the subdirectories that are not excluded
+ * and keep the files that pass every filter. File sizes are only looked up when there is a size limit, and file
+ * heads only read when generated files are skipped, so the default crawl costs one directory read per directory.
+ *
+ * @param path The directory or file.
+ * @param options The extensions and filters.
+ * @param stats Receives what was seen and dropped, or nullptr.
+ * @return The sorted list of files found.
+ */
+std::vector<fs::path> crawlSourceFiles(const fs::path& path, const CrawlOptions& options, CrawlStats* stats) {
+    TRACE_SCOPE("crawl");
+    std::vector<fs::path> files;
+    CrawlStats totals;
+
+    if (!fs::is_directory(path)) {
+        if (fs::is_regular_file(path) && hasExtension(path, options.extensions)) {
+            files.push_back(path);
+        }
+        totals.files = files.size();
+        if (stats) {
+            *stats = totals;
+        }
+        return files;
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<DirectoryTask> queue;
+    size_t busy = 0;
+    queue.push_back({path, std::string(), rootRules(options)});
+
+    auto worker = [&]() {
+        std::vector<fs::path> found;
+        CrawlStats counts;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [&] { return !queue.empty() || busy == 0; });
+            if (queue.empty()) {
+                break;
+            }
+            DirectoryTask task = std::move(queue.front());
+            queue.pop_front();
+            ++busy;
+            lock.unlock();
+
+            ++counts.directories;
+            const std::shared_ptr<const IgnoreRules> rules =
+                options.useGitignore ? directoryRules(task.path, task.relative, task.rules) : task.rules;
+            std::vector<DirectoryTask> subdirectories;
+            std::error_code error;
+            for (fs::directory_iterator it(task.path, fs::directory_options::skip_permission_denied, error), end;
+                 !error && it != end; it.increment(error)) {
+                const fs::directory_entry& entry = *it;
+                const std::string name = entry.path().filename().string();
+                std::string relative = task.relative.empty() ? name : task.relative + '/' + name;
+
+                std::error_code typeError;
+                if (entry.is_directory(typeError) && !entry.is_symlink(typeError)) {
+                    if (isIgnored(*rules, relative, true)) {
+                        ++counts.excluded;
+                    } else {
+                        subdirectories.push_back({entry.path(), std::move(relative), rules});
+                    }
+                    continue;
+                }
+                switch (checkFile(entry, relative, *rules, options)) {
+                    case FileVerdict::Accepted:
+                        found.push_back(entry.path());
+                        break;
+                    case FileVerdict::NotSource:
+                        break;
+                    case FileVerdict::Excluded:
+                        ++counts.excluded;
+                        break;
+                    case FileVerdict::TooLarge:
+                        ++counts.tooLarge;
+                        break;
+                    case FileVerdict::Generated:
+                        ++counts.generated;
+                        break;
+                }
+            }
+
+            lock.lock();
+            for (auto& subdirectory : subdirectories) {
+                queue.push_back(std::move(subdirectory));
+            }
+            --busy;
+            wake.notify_all();
+        }
+
+        files.insert(files.end(), std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+        totals.directories += counts.directories;
+        totals.excluded += counts.excluded;
+        totals.tooLarge += counts.tooLarge;
+        totals.generated += counts.generated;
+    };
+
+    const unsigned numThreads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> threads;
+    threads.reserve(numThreads);
+    for (unsigned t = 0; t < numThreads; ++t) {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::sort(files.begin(), files.end());
+    totals.files = files.size();
+    if (stats) {
+        *stats = totals;
+    }
+    return files;
+}
+
+/**
+ * @brief The exclude rules of the root and the .gitignore rules read so far, keyed by relative directory.
+ */
+struct CrawlFilter::State {
+    fs::path root;
+    bool useGitignore = false;
+    std::shared_ptr<const IgnoreRules> rootRules;
+    std::mutex mutex;
+    std::map<std::string, std::shared_ptr<const IgnoreRules>> directories;
+
+    /**
+     * @brief Returns the rules in force in a directory, reading the .gitignore files from the root down to it.
+     * @param directory The directory relative to the root, "" for the root itself.
+     */
+    std::shared_ptr<const IgnoreRules> rules(const std::string& directory) {
+        if (!useGitignore) {
+            return rootRules;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = directories.find(directory);
+            if (it != directories.end()) {
+                return it->second;
+            }
+        }
+        const size_t slash = directory.rfind('/');
+        const std::shared_ptr<const IgnoreRules> parent =
+            directory.empty() ? rootRules
+                              : rules(slash == std::string::npos ? std::string() : directory.substr(0, slash));
+        auto result = directoryRules(root / directory, directory, parent);
+        std::lock_guard<std::mutex> lock(mutex);
+        directories.emplace(directory, result);
+        return result;
+    }
+};
+
+/**
+ * @brief Prepares the checks of a crawl rooted at a directory.
+ * @param root The crawl root.
+ * @param options The extensions and filters.
+ */
+CrawlFilter::CrawlFilter(const fs::path& root, const CrawlOptions& options)
+    : options_(options), state_(std::make_unique<State>()) {
+    state_->root = root;
+    state_->useGitignore = options.useGitignore;
+    state_->rootRules = rootRules(options);
+}
+
+CrawlFilter::~CrawlFilter() = default;
+
+/**
+ * @brief Returns the path below the root with '/' separators, or false if the path is not below the root.
+ */
+bool CrawlFilter::relativeTo(const fs::path& path, std::string& relative) const {
+    const fs::path below = path.lexically_relative(state_->root);
+    if (below.empty() || *below.begin() == "..") {
+        return false;
+    }
+    relative = below == "." ? std::string() : below.generic_string();
+    return true;
+}
+
+/**
+ * @brief Checks that no directory from the root down to a relative directory is excluded.
+ */
+bool CrawlFilter::reachable(const std::string& directory) const {
+    size_t end = 0;
+    while (end < directory.size()) {
+        const size_t begin = end;
+        end = directory.find('/', begin);
+        if (end == std::string::npos) {
+            end = directory.size();
+        }
+        const std::string parent = begin == 0 ? std::string() : directory.substr(0, begin - 1);
+        if (isIgnored(*state_->rules(parent), directory.substr(0, end), true)) {
+            return false;
+        }
+        ++end;
+    }
+    return true;
+}
+
+/**
+ * @brief Whether the crawl descends into a directory.
+ * @param path The directory, below the root.
+ * @return False if the directory or one of its parents is excluded, or it is not below the root.
+ */
+bool CrawlFilter::acceptsDirectory(const fs::path& path) const {
+    std::string relative;
+    return relativeTo(path, relative) && reachable(relative);
+}
+
+/**
+ * @brief Whether the crawl returns a file.
+ * @param path The file, below the root.
+ * @return True if the file exists, is not excluded or below an excluded directory, has a source extension and
+ *         passes the size and generated-code filters.
+ */
+bool CrawlFilter::acceptsFile(const fs::path& path) const {
+    std::string relative;
+    if (!relativeTo(path, relative) || relative.empty()) {
+        return false;
+    }
+    const size_t slash = relative.rfind('/');
+    const std::string directory = slash == std::string::npos ? std::string() : relative.substr(0, slash);
+    if (!reachable(directory)) {
+        return false;
+    }
+    std::error_code error;
+    const fs::directory_entry entry(path, error);
+    return !error && checkFile(entry, relative, *state_->rules(directory), options_) == FileVerdict::Accepted;
+}
+
+/**
+ * @brief Drops the .gitignore rules read so far, e.g. after one of the files changed.
+ */
+void CrawlFilter::forgetRules() {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->directories.clear();
+}
+
+/**
+ * @brief Starts the reader threads.
+ * @param files The files in the order they will be consumed.
+ * @param threads The number of reader threads, 0 to read nothing.
+ * @param window The number of files read ahead of the consumers.
+ */
+FilePrefetcher::FilePrefetcher(const std::vector<fs::path>& files, unsigned threads, size_t window)
+    : files_(files), window_(std::max<size_t>(window, 1)) {
+    threads_.reserve(threads);
+    for (unsigned t = 0; t < threads; ++t) {
+        threads_.emplace_back(&FilePrefetcher::run, this);
+    }
+}
+
+FilePrefetcher::~FilePrefetcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+/**
+ * @brief Reports that a consumer took a file.
+ * @param index The position of the file in the list.
+ */
+void FilePrefetcher::consumed(size_t index) {
+    if (threads_.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // A consumer that got here first needs no read-ahead for its file
+        consumed_ = std::max(consumed_, index + 1);
+        next_ = std::max(next_, consumed_);
+    }
+    wake_.notify_all();
+}
+
+/**
+ * @brief Reads the next file within the window until the list is done or the prefetcher is stopped.
+ *
+ * Files are read with plain blocking reads into a scratch buffer; the data is discarded and only its presence in
+ * the page cache matters. Several readers keep several requests in flight, which is what hides the latency of a
+ * network file system.
+ */
+void FilePrefetcher::run() {
+    std::vector<char> buffer(kReadAheadBlock);
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [&] { return stop_ || next_ >= files_.size() || next_ < consumed_ + window_; });
+        if (stop_ || next_ >= files_.size()) {
+            return;
+        }
+        const size_t index = next_++;
+        lock.unlock();
+
+        const int fd = open(files_[index].c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            int64_t bytes = 0;
+            for (ssize_t n; (n = read(fd, buffer.data(), buffer.size())) > 0;) {
+                bytes += n;
+            }
+            close(fd);
+            traceCount(TraceCounter::ReadAheadBytes, bytes);
+        }
+
+        lock.lock();
+    }
+}
@@ -0,0 +1,172 @@
+/**
+ * @file Crawler.h
+ * @brief This file contains the declarations of the parallel source tree crawler and the file read-ahead pool.
+ *
+ * On network mounts and cold checkouts, listing directories and reading files can take longer than parsing them.
+ * The crawler lists directories from a pool of threads, so many directory reads are in flight at once, and filters
+ * entries as it goes: by extension, by .gitignore-style exclude rules, by size, and by the markers code generators
+ * leave in their output. The read-ahead pool then reads the files a bounded distance ahead of the parse workers,
+ * so that parsing finds them in the page cache.
+ */
+
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Which files the crawler returns.
+ */
+struct CrawlOptions {
+    std::vector<std::string> extensions = {".cpp", ".cc", ".cxx"}; ///< Lowercase extensions, with the dot.
+    std::vector<std::string> excludes; ///< .gitignore-style patterns, relative to the crawled directory.
+    bool useGitignore = false;   ///< Whether to also apply the .gitignore file of every directory to its subtree.
+    uint64_t maxFileSize = 0;    ///< Larger files are skipped, 0 for no limit.
+    bool skipGenerated = false;  ///< Whether to skip files whose first lines say they were generated.
+    unsigned threads = 0;        ///< Directory listing threads, 0 selects the hardware concurrency.
+};
+
+/**
+ * @brief What the crawler saw and why it dropped files.
+ */
+struct CrawlStats {
+    size_t directories = 0; ///< Directories listed.
+    size_t files = 0;       ///< Source files returned.
+    size_t excluded = 0;    ///< Files and directories matched by an exclude rule.
+    size_t tooLarge = 0;    ///< Source files above the size limit.
+    size_t generated = 0;   ///< Source files with a generated-code marker.
+};
+
+/**
+ * @brief Parses a comma-separated list of file extensions.
+ * @param text The text to parse, e.g. "cpp,cc,.h". The leading dots are optional.
+ * @param extensions Receives the lowercase extensions, each with a leading dot.
+ * @return True if the list held at least one extension.
+ */
+bool parseExtensions(const std::string& text, std::vector<std::string>& extensions);
+
+/**
+ * @brief Checks whether a path has one of the given extensions, ignoring case.
+ * @param path The path to check.
+ * @param extensions Lowercase extensions, with the dot.
+ * @return True if the extension of path is in the list.
+ */
+bool hasExtension(const std::filesystem::path& path, const std::vector<std::string>& extensions);
+
+/**
+ * @brief Matches a path against a .gitignore-style glob.
+ * @param pattern The glob. '*' and '?' do not match '/', "**" matches across directories, and [...] matches a
+ *                character class, negated by a leading '!' or '^'.
+ * @param text The path or file name to match, with '/' separators.
+ * @return True if the whole text matches the pattern.
+ */
+bool globMatch(std::string_view pattern, std::string_view text);
+
+/**
+ * @brief Collects the source files under a directory, or a single file.
+ * @param path The directory or file.
+ * @param options The extensions and filters.
+ * @param stats Receives what was seen and dropped, or nullptr.
+ * @return The sorted list of files found.
+ *
+ * Exclude rules follow .gitignore: a rule without a slash matches a name at any depth, a rule with one is anchored
+ * to the directory it applies to, a trailing slash only matches directories, a leading '!' re-includes, and the last
+ * matching rule wins. Excluded directories are not descended into. Symbolic links to files are followed, symbolic
+ * links to directories are not. A single file is only checked against the extensions.
+ *
+ * The list is sorted so that every run sees the files in the same order regardless of how the directory listing
+ * was scheduled.
+ */
+std::vector<std::filesystem::path> crawlSourceFiles(const std::filesystem::path& path, const CrawlOptions& options,
+                                                    CrawlStats* stats = nullptr);
+
+/**
+ * @brief The per-path checks of the crawl, for paths that arrive one at a time, like the files a watcher reports.
+ *
+ * A path passes exactly when crawlSourceFiles() on the root would return the file, or descend into the directory:
+ * no directory on the way down is excluded, the file itself is not excluded, and it passes the extension, size and
+ * generated-code filters. The .gitignore rules of each directory are read once, until forgetRules().
+ */
+class CrawlFilter {
+public:
+    /**
+     * @brief Prepares the checks of a crawl rooted at a directory.
+     * @param root The crawl root. Paths passed to the checks are made relative to it lexically.
+     * @param options The extensions and filters.
+     */
+    CrawlFilter(const std::filesystem::path& root, const CrawlOptions& options);
+    ~CrawlFilter();
+
+    CrawlFilter(const CrawlFilter&) = delete;
+    CrawlFilter& operator=(const CrawlFilter&) = delete;
+
+    /**
+     * @brief Whether the crawl descends into a directory below the root.
+     */
+    bool acceptsDirectory(const std::filesystem::path& path) const;
+
+    /**
+     * @brief Whether the crawl returns a file below the root. Reads its size or first bytes if those filters are on.
+     */
+    bool acceptsFile(const std::filesystem::path& path) const;
+
+    /**
+     * @brief Drops the .gitignore rules read so far, so they are read again on the next check.
+     */
+    void forgetRules();
+
+private:
+    struct State;
+
+    bool relativeTo(const std::filesystem::path& path, std::string& relative) const;
+    bool reachable(const std::string& directory) const;
+
+    CrawlOptions options_;
+    std::unique_ptr<State> state_;
+};
+
+/**
+ * @brief Reads files into the page cache ahead of the threads that parse them.
+ *
+ * The consumers take files in list order and report each position they take. Reader threads read the files that
+ * follow, never more than a window ahead of the furthest position taken, so a large tree does not evict the files
+ * that are about to be parsed. The destructor stops the readers.
+ */
+class FilePrefetcher {
+public:
+    /**
+     * @brief Starts the reader threads.
+     * @param files The files in the order they will be consumed. The list must outlive the prefetcher.
+     * @param threads The number of reader threads, 0 to read nothing.
+     * @param window The number of files read ahead of the consumers.
+     */
+    FilePrefetcher(const std::vector<std::filesystem::path>& files, unsigned threads, size_t window = 64);
+    ~FilePrefetcher();
+
+    FilePrefetcher(const FilePrefetcher&) = delete;
+    FilePrefetcher& operator=(const FilePrefetcher&) = delete;
+
+    /**
+     * @brief Reports that a consumer took a file, letting the readers move on.
+     * @param index The position of the file in the list.
+     */
+    void consumed(size_t index);
+
+private:
+    void run();
+
+    const std::vector<std::filesystem::path>& files_;
+    size_t window_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    size_t next_ = 0;     ///< Next file to read.
+    size_t consumed_ = 0; ///< One past the furthest position taken by a consumer.
+    bool stop_ = false;
+    std::vector<std::thread> threads_;
+};
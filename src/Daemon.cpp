@@ -0,0 +1,831 @@
+/**
+ * @file Daemon.cpp
+ * @brief This file contains the implementation of the resident server mode.
+ */
+
+#include "Daemon.h"
+#include "EmbeddingEngine.h"
+#include "FileUtils.h"
+#include "FunctionTable.h"
+#include "Hash.h"
+#include "JsonUtil.h"
+#include "LexicalExtractor.h"
+#include "SourceBuffer.h"
+#include "Trace.h"
+#include "VectorKernels.h"
+#include <clang-c/Index.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * @brief Quiet time after the last file event before changed files are re-extracted.
+ */
+constexpr int kDebounceMs = 100;
+
+/**
+ * @brief Batches of more changed files than this are extracted in parallel from scratch, e.g. after a checkout.
+ */
+constexpr size_t kWarmBatch = 8;
+
+/**
+ * @brief Longest request line accepted.
+ */
+constexpr size_t kMaxRequestBytes = 16 << 20;
+
+/**
+ * @brief How long a connected client may take to send its whole request line.
+ */
+constexpr int kClientTimeoutSeconds = 5;
+
+constexpr uint32_t kWatchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE;
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void onStopSignal(int) {
+    stopRequested = 1;
+}
+
+/**
+ * @brief Translation units of recently changed files, kept alive so that the next change only reparses them.
+ *
+ * Units are parsed with a precompiled preamble: the first parse precompiles the headers at the top of the file,
+ * and reparses reuse them as long as that part of the file and the headers do not change. The least recently
+ * used unit is disposed once the capacity is exceeded.
+ */
+class WarmUnits {
+public:
+    WarmUnits(size_t capacity, const CompileFlags* flags) : index_(clang_createIndex(0, 0)), capacity_(capacity),
+                                                            flags_(flags) {}
+
+    ~WarmUnits() {
+        for (auto& entry : lru_) {
+            clang_disposeTranslationUnit(entry.second);
+        }
+        clang_disposeIndex(index_);
+    }
+
+    WarmUnits(const WarmUnits&) = delete;
+    WarmUnits& operator=(const WarmUnits&) = delete;
+
+    size_t size() const { return lru_.size(); }
+
+    /**
+     * @brief Reparses or parses a file and extracts its functions.
+     * @return False if the file could not be parsed.
+     */
+    bool extract(const fs::path& file, const SourceBuffer& source, const Tokenizer* tokenizer,
+                 const FunctionCache* cache, const FunctionSplitter* splitter, std::vector<FunctionInfo>& functions) {
+        const std::string filename = file.string();
+        CXTranslationUnit unit = nullptr;
+        auto it = units_.find(filename);
+        if (it != units_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            unit = it->second->second;
+            TRACE_SCOPE("reparse");
+            if (clang_reparseTranslationUnit(unit, 0, nullptr, clang_defaultReparseOptions(unit)) != 0) {
+                // A unit whose reparse failed is no longer usable
+                forget(filename);
+                unit = nullptr;
+            }
+        }
+
+        if (unit == nullptr) {
+            unit = parse(file, true);
+            if (unit == nullptr) {
+                return false;
+            }
+            lru_.emplace_front(filename, unit);
+            units_[filename] = lru_.begin();
+        }
+
+        visitTranslationUnit(unit, source, tokenizer, cache, functions, splitter);
+        while (lru_.size() > capacity_) {
+            forget(lru_.back().first);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Parses a file and extracts its functions without keeping its unit, so no kept unit is evicted.
+     * @return False if the file could not be parsed.
+     */
+    bool extractOnce(const fs::path& file, const SourceBuffer& source, const Tokenizer* tokenizer,
+                     const FunctionCache* cache, const FunctionSplitter* splitter,
+                     std::vector<FunctionInfo>& functions) {
+        CXTranslationUnit unit = parse(file, false);
+        if (unit == nullptr) {
+            return false;
+        }
+        visitTranslationUnit(unit, source, tokenizer, cache, functions, splitter);
+        clang_disposeTranslationUnit(unit);
+        return true;
+    }
+
+    /**
+     * @brief Disposes the unit of a file, if it is kept.
+     */
+    void forget(const std::string& filename) {
+        auto it = units_.find(filename);
+        if (it == units_.end()) {
+            return;
+        }
+        clang_disposeTranslationUnit(it->second->second);
+        lru_.erase(it->second);
+        units_.erase(it);
+    }
+
+private:
+    /**
+     * @brief Parses a file, with a precompiled preamble if the unit is kept for reparsing.
+     */
+    CXTranslationUnit parse(const fs::path& file, bool keep) {
+        TRACE_SCOPE("parse");
+        static const std::vector<std::string> noArguments;
+        const std::vector<std::string>& arguments = flags_ ? flags_->argumentsFor(file) : noArguments;
+        std::vector<const char*> argv;
+        argv.reserve(arguments.size());
+        for (const std::string& arg : arguments) {
+            argv.push_back(arg.c_str());
+        }
+
+        const unsigned options =
+            keep ? CXTranslationUnit_PrecompiledPreamble | CXTranslationUnit_CreatePreambleOnFirstParse
+                 : CXTranslationUnit_None;
+        CXTranslationUnit unit = nullptr;
+        if (clang_parseTranslationUnit2(index_, file.string().c_str(), argv.data(), static_cast<int>(argv.size()),
+                                        nullptr, 0, options, &unit) != CXError_Success) {
+            return nullptr;
+        }
+        return unit;
+    }
+
+    using Entry = std::pair<std::string, CXTranslationUnit>;
+
+    CXIndex index_;
+    size_t capacity_;
+    const CompileFlags* flags_;
+    std::list<Entry> lru_; ///< Most recently used first.
+    std::unordered_map<std::string, std::list<Entry>::iterator> units_;
+};
+
+/**
+ * @brief The functions of one file, with one embedding row per function when embeddings are kept.
+ */
+struct FileState {
+    std::vector<FunctionInfo> functions;
+    std::vector<float> embeddings;
+};
+
+/**
+ * @brief Writes one function with the fields of the streaming pipeline's JSONL output.
+ */
+void writeFunctionJson(std::ostream& out, const FunctionTable& functions, size_t i) {
+    out << "{\"file\":";
+    writeJsonString(out, functions.filePath(i));
+    out << ",\"signature\":";
+    writeJsonString(out, functions.signature(i));
+    out << ",\"startLine\":" << functions.startLine(i) << ",\"endLine\":" << functions.endLine(i)
+        << ",\"tokens\":" << functions.tokenCount(i);
+    if (functions.fragment(i) >= 0) {
+        char parent[17];
+        std::snprintf(parent, sizeof(parent), "%016" PRIx64, functions.parentHash(i));
+        out << ",\"parent\":\"" << parent << "\",\"fragment\":" << functions.fragment(i);
+    }
+    out << "}";
+}
+
+std::string errorResponse(std::string_view message) {
+    std::ostringstream out;
+    out << "{\"ok\":false,\"error\":";
+    writeJsonString(out, message);
+    out << "}";
+    return out.str();
+}
+
+/**
+ * @brief The state and event loop of a running daemon.
+ */
+class Daemon {
+public:
+    Daemon(const DaemonOptions& options, const Tokenizer& tokenizer, llama_model* embeddingModel,
+           const FunctionCache* cache)
+        : options_(options), tokenizer_(tokenizer), cache_(cache), units_(options.warmUnits, options.compileFlags) {
+        root_ = fs::absolute(options.root).lexically_normal();
+        if (!root_.has_filename()) {
+            root_ = root_.parent_path();
+        }
+        rootIsFile_ = !fs::is_directory(root_);
+        filter_ = std::make_unique<CrawlFilter>(root_, options.crawl);
+        if (options.embed) {
+            engine_ = std::make_unique<EmbeddingEngine>(embeddingModel);
+            embeddingTokenizer_ = std::make_unique<Tokenizer>(embeddingModel);
+        }
+    }
+
+    ~Daemon() {
+        if (listen_ >= 0) {
+            close(listen_);
+            unlink(options_.socketPath.c_str());
+        }
+        if (inotify_ >= 0) {
+            close(inotify_);
+        }
+    }
+
+    Daemon(const Daemon&) = delete;
+    Daemon& operator=(const Daemon&) = delete;
+
+    bool run();
+
+private:
+    bool listenOnSocket();
+    bool startWatching();
+    void watchTree(const fs::path& directory);
+    void readEvents();
+    void handleEvent(const inotify_event& event);
+    bool inScope(const fs::path& path) const;
+    void markDirty(const fs::path& path);
+    void refresh();
+    void extract(const std::vector<fs::path>& files);
+    void serve(int client);
+    std::string handle(std::string_view request);
+    std::string chunkResponse(const FunctionTable& functions);
+    bool embedText(const std::string& text, std::vector<float>& embedding);
+
+    const DaemonOptions& options_;
+    const Tokenizer& tokenizer_;
+    const FunctionCache* cache_;
+    WarmUnits units_;
+    std::unique_ptr<EmbeddingEngine> engine_;
+    std::unique_ptr<Tokenizer> embeddingTokenizer_;
+
+    fs::path root_;
+    bool rootIsFile_ = false;
+    std::unique_ptr<CrawlFilter> filter_; ///< The crawl's checks, applied to every path the watches report.
+    int listen_ = -1;
+    int inotify_ = -1;
+    bool stop_ = false;
+    std::unordered_map<int, fs::path> watches_;
+    std::map<std::string, FileState> files_; ///< Keyed by absolute path, so the tree is walked in sorted order.
+    std::set<std::string> dirty_;            ///< Files changed since the last refresh.
+};
+
+bool Daemon::listenOnSocket() {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    const std::string path = options_.socketPath.string();
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Invalid socket path: " << path << std::endl;
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::cerr << "Failed to create socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    // A socket file left by a daemon that died is replaced; one that still answers is not
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0) {
+        std::cerr << "A daemon is already listening on " << path << std::endl;
+        close(fd);
+        return false;
+    }
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, 16) != 0) {
+        std::cerr << "Failed to listen on " << path << ": " << std::strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+    listen_ = fd;
+    return true;
+}
+
+bool Daemon::startWatching() {
+    inotify_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_ < 0) {
+        std::cerr << "Failed to initialize inotify: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    watchTree(rootIsFile_ ? root_.parent_path() : root_);
+    return !watches_.empty();
+}
+
+/**
+ * @brief Watches a directory and every directory below it. A single-file root only watches its own directory.
+ *
+ * Excluded directories, such as .git or a build tree, are neither watched nor descended into, so they do not use
+ * up the inotify watch limit.
+ */
+void Daemon::watchTree(const fs::path& directory) {
+    auto addWatch = [this](const fs::path& path) {
+        const int wd = inotify_add_watch(inotify_, path.c_str(), kWatchMask);
+        if (wd < 0) {
+            std::cerr << "Failed to watch " << path.string() << ": " << std::strerror(errno) << std::endl;
+            return;
+        }
+        watches_[wd] = path;
+    };
+
+    addWatch(directory);
+    if (rootIsFile_) {
+        return;
+    }
+    std::error_code error;
+    for (auto it = fs::recursive_directory_iterator(directory, fs::directory_options::skip_permission_denied, error);
+         it != fs::recursive_directory_iterator(); it.increment(error)) {
+        if (error) {
+            break;
+        }
+        if (it->is_directory(error) && !it->is_symlink(error)) {
+            if (filter_->acceptsDirectory(it->path())) {
+                addWatch(it->path());
+            } else {
+                it.disable_recursion_pending();
+            }
+        }
+    }
+}
+
+/**
+ * @brief Whether the crawl of the root would return a file, so that saved files obey the same filters.
+ */
+bool Daemon::inScope(const fs::path& path) const {
+    return rootIsFile_ ? path == root_ : filter_->acceptsFile(path);
+}
+
+/**
+ * @brief Marks a file for the next refresh if it is in scope, or was, so that a file that left it is dropped.
+ */
+void Daemon::markDirty(const fs::path& path) {
+    if (files_.count(path.string()) || inScope(path)) {
+        dirty_.insert(path.string());
+    }
+}
+
+/**
+ * @brief Drains the pending inotify events without blocking.
+ */
+void Daemon::readEvents() {
+    alignas(inotify_event) char buffer[64 * 1024];
+    for (;;) {
+        const ssize_t n = read(inotify_, buffer, sizeof(buffer));
+        if (n <= 0) {
+            return;
+        }
+        for (const char* p = buffer; p < buffer + n;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(p);
+            handleEvent(*event);
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+}
+
+/**
+ * @brief Marks the files an event affects as dirty and keeps the directory watches in step with the tree.
+ */
+void Daemon::handleEvent(const inotify_event& event) {
+    if (event.mask & IN_Q_OVERFLOW) {
+        // Events were lost: compare everything against the tree on the next refresh
+        for (const auto& entry : files_) {
+            dirty_.insert(entry.first);
+        }
+        for (const fs::path& file : collectSourceFiles(root_, options_.crawl)) {
+            dirty_.insert(file.string());
+        }
+        return;
+    }
+
+    auto it = watches_.find(event.wd);
+    if (it == watches_.end()) {
+        return;
+    }
+    if (event.mask & IN_IGNORED) {
+        watches_.erase(it);
+        return;
+    }
+    if (event.len == 0) {
+        return;
+    }
+
+    const fs::path path = it->second / event.name;
+    if (!(event.mask & IN_ISDIR) && path.filename() == ".gitignore" && options_.crawl.useGitignore) {
+        // Files the changed rules now exclude are dropped on their next change; a full rescan is not worth it
+        filter_->forgetRules();
+        return;
+    }
+    if (!(event.mask & IN_ISDIR)) {
+        if (event.mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE)) {
+            markDirty(path);
+        }
+        return;
+    }
+    if (rootIsFile_) {
+        return;
+    }
+
+    if (event.mask & (IN_CREATE | IN_MOVED_TO)) {
+        if (!filter_->acceptsDirectory(path)) {
+            return;
+        }
+        // Files may have been written before the watch on the new directory existed. The exclude rules are
+        // relative to the root, so the new directory is listed by extension only and its files checked one by one.
+        watchTree(path);
+        CrawlOptions byExtension;
+        byExtension.extensions = options_.crawl.extensions;
+        byExtension.threads = options_.crawl.threads;
+        for (const fs::path& file : collectSourceFiles(path, byExtension)) {
+            markDirty(file);
+        }
+    } else if (event.mask & (IN_MOVED_FROM | IN_DELETE)) {
+        const std::string prefix = path.string() + '/';
+        for (auto file = files_.lower_bound(prefix); file != files_.end() && file->first.rfind(prefix, 0) == 0;
+             ++file) {
+            dirty_.insert(file->first);
+        }
+        // A directory moved out of the tree keeps its watches; drop them so its events are not misattributed
+        for (auto watch = watches_.begin(); watch != watches_.end();) {
+            const std::string watched = watch->second.string();
+            if (watched == path.string() || watched.rfind(prefix, 0) == 0) {
+                inotify_rm_watch(inotify_, watch->first);
+                watch = watches_.erase(watch);
+            } else {
+                ++watch;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Re-extracts the dirty files and forgets the ones that no longer exist.
+ */
+void Daemon::refresh() {
+    if (dirty_.empty()) {
+        return;
+    }
+    std::vector<fs::path> changed;
+    size_t removed = 0;
+    for (const std::string& path : dirty_) {
+        std::error_code error;
+        if (fs::is_regular_file(path, error) && inScope(path)) {
+            changed.emplace_back(path);
+        } else {
+            removed += files_.erase(path);
+            units_.forget(path);
+        }
+    }
+    dirty_.clear();
+    extract(changed);
+    std::cerr << "Re-extracted " << changed.size() << " files, removed " << removed << std::endl;
+}
+
+/**
+ * @brief Extracts files and replaces their state.
+ *
+ * Small batches, the usual result of saving in an editor, go through the warm translation units one file at a
+ * time. Larger batches and lexical mode use the parallel extractor and leave the warm units alone.
+ */
+void Daemon::extract(const std::vector<fs::path>& files) {
+    if (files.empty()) {
+        return;
+    }
+
+    FunctionTable functions;
+    if (options_.mode == ExtractMode::Lexical || options_.warmUnits == 0 || files.size() > kWarmBatch) {
+        functions = extractFunctionsParallel(files, &tokenizer_, options_.threads, cache_, options_.compileFlags,
+                                             options_.mode, options_.splitter);
+    } else {
+        std::vector<FunctionInfo> infos;
+        for (const fs::path& file : files) {
+            SourceBuffer source;
+            infos.clear();
+            if (!source.open(file)) {
+                std::cerr << "Failed to open file: " << file.string() << std::endl;
+                continue;
+            }
+            if (!units_.extract(file, source, &tokenizer_, cache_, options_.splitter, infos)) {
+                std::cerr << "Unable to parse translation unit: " << file.string() << std::endl;
+            }
+            functions.append(infos);
+        }
+    }
+
+    std::vector<float> embeddings;
+    if (engine_) {
+        embeddings = embedFunctions(functions, *engine_, *embeddingTokenizer_, cache_);
+    }
+    const size_t dimension = engine_ ? static_cast<size_t>(engine_->dimension()) : 0;
+
+    for (const fs::path& file : files) {
+        files_[file.string()] = FileState{};
+    }
+    for (size_t i = 0; i < functions.size(); ++i) {
+        FileState& state = files_[std::string(functions.filePath(i))];
+        state.functions.push_back(functions.row(i));
+        if (dimension > 0) {
+            state.embeddings.insert(state.embeddings.end(), embeddings.begin() + i * dimension,
+                                    embeddings.begin() + (i + 1) * dimension);
+        }
+    }
+}
+
+/**
+ * @brief Packs functions with the configured strategy and writes the chunks.
+ */
+std::string Daemon::chunkResponse(const FunctionTable& functions) {
+    const int budget = options_.chunkBudget > 0 ? options_.chunkBudget : ChunkPlanner::suggestBudget(functions);
+    const ChunkPlan plan = ChunkPlanner(budget, options_.packing).plan(functions);
+
+    std::ostringstream out;
+    out << "{\"ok\":true,\"budget\":" << budget << ",\"totalTokens\":" << functions.totalTokens() << ",\"chunks\":[";
+    for (size_t c = 0; c < plan.size(); ++c) {
+        const Chunk& chunk = plan.chunks[c];
+        out << (c ? "," : "") << "{\"chunk\":" << c << ",\"tokens\":" << chunk.tokenCount << ",\"functions\":[";
+        for (size_t k = 0; k < chunk.size(); ++k) {
+            out << (k ? "," : "");
+            writeFunctionJson(out, functions, plan.function(chunk, k));
+        }
+        out << "]}";
+    }
+    out << "]}";
+    return out.str();
+}
+
+bool Daemon::embedText(const std::string& text, std::vector<float>& embedding) {
+    TRACE_SCOPE("embed");
+    std::vector<std::vector<llama_token>> sequences(1);
+    embeddingTokenizer_->tokenize(text, sequences[0]);
+    return engine_->embed(sequences, embedding) && embedding.size() == static_cast<size_t>(engine_->dimension());
+}
+
+/**
+ * @brief Answers one request line.
+ */
+std::string Daemon::handle(std::string_view request) {
+    const size_t space = request.find(' ');
+    const std::string_view command = request.substr(0, space);
+    std::string_view argument = space == std::string_view::npos ? std::string_view() : request.substr(space + 1);
+    while (!argument.empty() && argument.front() == ' ') {
+        argument.remove_prefix(1);
+    }
+
+    if (command == "status") {
+        size_t functions = 0;
+        for (const auto& entry : files_) {
+            functions += entry.second.functions.size();
+        }
+        std::ostringstream out;
+        out << "{\"ok\":true,\"files\":" << files_.size() << ",\"functions\":" << functions
+            << ",\"warmUnits\":" << units_.size() << "}";
+        return out.str();
+    }
+
+    if (command == "shutdown") {
+        stop_ = true;
+        return "{\"ok\":true}";
+    }
+
+    if (command == "chunk-tree") {
+        FunctionTable functions;
+        for (const auto& entry : files_) {
+            functions.append(entry.second.functions);
+        }
+        return chunkResponse(functions);
+    }
+
+    if (command == "chunk-file") {
+        if (argument.empty()) {
+            return errorResponse("chunk-file requires a path");
+        }
+        const fs::path file = fs::absolute(fs::path(argument)).lexically_normal();
+        FunctionTable functions;
+        auto it = files_.find(file.string());
+        if (it != files_.end()) {
+            functions.append(it->second.functions);
+        } else {
+            // A file outside the watched tree is extracted on demand and not kept
+            SourceBuffer source;
+            if (!source.open(file)) {
+                return errorResponse("cannot open " + file.string());
+            }
+            std::vector<FunctionInfo> infos;
+            if (options_.mode == ExtractMode::Lexical) {
+                extractFileFunctionsLexical(file, source, &tokenizer_, cache_, hashString(source.text()), infos,
+                                            options_.splitter);
+            } else if (!units_.extractOnce(file, source, &tokenizer_, cache_, options_.splitter, infos)) {
+                return errorResponse("cannot parse " + file.string());
+            }
+            functions.append(infos);
+        }
+        return chunkResponse(functions);
+    }
+
+    if (command == "embed" || command == "query") {
+        if (!engine_) {
+            return errorResponse("the daemon was started without --embed");
+        }
+        unsigned k = 0;
+        if (command == "query") {
+            const size_t end = argument.find(' ');
+            const std::string count(argument.substr(0, end));
+            char* parsedEnd = nullptr;
+            k = static_cast<unsigned>(std::strtoul(count.c_str(), &parsedEnd, 10));
+            if (count.empty() || *parsedEnd != '\0' || k == 0 || end == std::string_view::npos) {
+                return errorResponse("usage: query K \"TEXT\"");
+            }
+            argument.remove_prefix(end + 1);
+        }
+        std::string text;
+        if (!readJsonString(argument, text)) {
+            return errorResponse("expected a JSON string");
+        }
+        std::vector<float> embedding;
+        if (!embedText(text, embedding)) {
+            return errorResponse("embedding failed");
+        }
+
+        std::ostringstream out;
+        if (command == "embed") {
+            out << "{\"ok\":true,\"dimension\":" << embedding.size() << ",\"embedding\":[";
+            for (size_t d = 0; d < embedding.size(); ++d) {
+                out << (d ? "," : "") << embedding[d];
+            }
+            out << "]}";
+            return out.str();
+        }
+
+        // Embeddings are normalized, so the dot product is the cosine similarity
+        struct Hit {
+            float score;
+            const FunctionInfo* function;
+        };
+        std::vector<Hit> hits;
+        std::vector<float> scores;
+        const size_t dimension = embedding.size();
+        for (const auto& entry : files_) {
+            const FileState& state = entry.second;
+            const size_t rows = state.embeddings.size() / dimension;
+            scores.resize(rows);
+            dotBatch(embedding.data(), state.embeddings.data(), rows, dimension, scores.data());
+            for (size_t i = 0; i < rows; ++i) {
+                hits.push_back({scores[i], &state.functions[i]});
+            }
+        }
+        const size_t count = std::min<size_t>(k, hits.size());
+        std::partial_sort(hits.begin(), hits.begin() + count, hits.end(),
+                          [](const Hit& a, const Hit& b) { return a.score > b.score; });
+
+        out << "{\"ok\":true,\"results\":[";
+        for (size_t i = 0; i < count; ++i) {
+            const FunctionInfo& info = *hits[i].function;
+            out << (i ? "," : "") << "{\"file\":";
+            writeJsonString(out, info.filePath);
+            out << ",\"signature\":";
+            writeJsonString(out, info.signature);
+            out << ",\"startLine\":" << info.startLine << ",\"endLine\":" << info.endLine
+                << ",\"score\":" << hits[i].score << "}";
+        }
+        out << "]}";
+        return out.str();
+    }
+
+    return errorResponse("unknown command: " + std::string(command));
+}
+
+/**
+ * @brief Reads one request from a client, answers it and closes the connection.
+ *
+ * Requests are served on the event loop, so the whole request must arrive within kClientTimeoutSeconds; a client
+ * that trickles bytes is dropped without an answer.
+ */
+void Daemon::serve(int client) {
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point deadline = Clock::now() + std::chrono::seconds(kClientTimeoutSeconds);
+
+    std::string request;
+    char buffer[4096];
+    while (request.find('\n') == std::string::npos && request.size() < kMaxRequestBytes) {
+        const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+        pollfd fd = {client, POLLIN, 0};
+        const int ready = remaining.count() > 0 ? poll(&fd, 1, static_cast<int>(remaining.count()) + 1) : 0;
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready <= 0) {
+            close(client);
+            return;
+        }
+        const ssize_t n = recv(client, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            break;
+        }
+        request.append(buffer, static_cast<size_t>(n));
+    }
+    request.resize(std::min(request.find('\n'), request.size()));
+    if (!request.empty() && request.back() == '\r') {
+        request.pop_back();
+    }
+
+    const std::string response = handle(request) + '\n';
+    for (size_t sent = 0; sent < response.size();) {
+        const ssize_t n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            break;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    close(client);
+}
+
+/**
+ * @brief Extracts the tree, then serves requests and file events until asked to stop.
+ *
+ * Watches are set up before the initial extraction, so a file saved while it runs is extracted again afterwards.
+ * Changed files are re-extracted once the tree has been quiet for kDebounceMs, or right before a request is
+ * answered, whichever comes first.
+ */
+bool Daemon::run() {
+    if (engine_ && !engine_->valid()) {
+        return false;
+    }
+    if (!listenOnSocket() || !startWatching()) {
+        return false;
+    }
+
+    extract(collectSourceFiles(root_, options_.crawl));
+    std::cerr << "Serving " << files_.size() << " files on " << options_.socketPath.string() << std::endl;
+
+    struct sigaction action {};
+    action.sa_handler = onStopSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    while (!stop_ && !stopRequested) {
+        pollfd fds[2] = {{listen_, POLLIN, 0}, {inotify_, POLLIN, 0}};
+        const int ready = poll(fds, 2, dirty_.empty() ? -1 : kDebounceMs);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "poll failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        if (ready == 0) {
+            refresh();
+            continue;
+        }
+        if (fds[1].revents & POLLIN) {
+            readEvents();
+        }
+        if (fds[0].revents & POLLIN) {
+            const int client = accept4(listen_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client >= 0) {
+                readEvents();
+                refresh();
+                serve(client);
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+/**
+ * @brief Runs the daemon until a shutdown request, SIGINT or SIGTERM.
+ * @param options The daemon settings.
+ * @param tokenizer The tokenizer used to count function tokens.
+ * @param embeddingModel The embedding model, loaded with its weights if options.embed is set.
+ * @param cache The cache of token counts and embeddings, or nullptr.
+ * @return False if the socket or the watches could not be set up.
+ */
+bool runDaemon(const DaemonOptions& options, const Tokenizer& tokenizer, llama_model* embeddingModel,
+               const FunctionCache* cache) {
+    Daemon daemon(options, tokenizer, embeddingModel, cache);
+    return daemon.run();
+}
@@ -0,0 +1,61 @@
+/**
+ * @file Daemon.h
+ * @brief This file contains the declaration of the resident server mode.
+ *
+ * The daemon pays for model loading and a full extraction of the tree once, then keeps the per-file results current
+ * by watching the tree with inotify and re-extracting only the files that changed. A small number of recently
+ * changed files keep their translation units alive, so that saving a file again only reparses it against its
+ * precompiled preamble instead of parsing all of its headers.
+ *
+ * Clients connect to a Unix domain socket and send one request line; the daemon answers with one JSON line and
+ * closes the connection. Requests are served one at a time, in arrival order:
+ *
+ *     status                 {"ok":true,"files":F,"functions":N,"warmUnits":W}
+ *     chunk-file PATH        The functions of one file, packed into chunks.
+ *     chunk-tree             The functions of the whole tree, packed into chunks.
+ *     embed "TEXT"           The embedding of a JSON string.
+ *     query K "TEXT"         The K functions of the tree closest to the embedding of a JSON string.
+ *     shutdown               Stops the daemon.
+ *
+ * Chunks are written with the same fields as the JSONL output of the streaming pipeline. Errors are answered with
+ * {"ok":false,"error":"..."}.
+ */
+
+#pragma once
+#include "ChunkPlanner.h"
+#include "CompileFlags.h"
+#include "Crawler.h"
+#include "FunctionCache.h"
+#include "FunctionSplitter.h"
+#include "ParallelExtractor.h"
+#include "Tokenizer.h"
+#include "llama.h"
+#include <filesystem>
+
+/**
+ * @brief Settings of the daemon.
+ */
+struct DaemonOptions {
+    std::filesystem::path socketPath; ///< Path of the Unix domain socket to listen on.
+    std::filesystem::path root;       ///< The source file or directory to extract and watch.
+    unsigned threads = 0;             ///< Extraction threads for large batches, 0 selects the hardware concurrency.
+    int chunkBudget = 0;              ///< Token budget per chunk, 0 derives one from the functions of each request.
+    PackingStrategy packing = PackingStrategy::FirstFit;
+    ExtractMode mode = ExtractMode::Ast;
+    const CompileFlags* compileFlags = nullptr;
+    const FunctionSplitter* splitter = nullptr;
+    bool embed = false;     ///< Whether to keep an embedding of every function, enabling embed and query.
+    size_t warmUnits = 64;  ///< Translation units kept alive for reparsing, 0 parses every change from scratch.
+    CrawlOptions crawl;     ///< Filters of directory scans; changed files are only matched by extension.
+};
+
+/**
+ * @brief Runs the daemon until a shutdown request, SIGINT or SIGTERM.
+ * @param options The daemon settings.
+ * @param tokenizer The tokenizer used to count function tokens.
+ * @param embeddingModel The embedding model, loaded with its weights if options.embed is set.
+ * @param cache The cache of token counts and embeddings, or nullptr.
+ * @return False if the socket or the watches could not be set up.
+ */
+bool runDaemon(const DaemonOptions& options, const Tokenizer& tokenizer, llama_model* embeddingModel,
+               const FunctionCache* cache);
@@ -0,0 +1,37 @@
+/**
+ * @file DefinitionSet.cpp
+ * @brief This file contains the implementation of the DefinitionSet.
+ */
+
+#include "DefinitionSet.h"
+#include "Hash.h"
+
+/**
+ * @brief Claims a definition.
+ *
+ * The key is a 64-bit hash of the USR, file and offset; the top bits select the shard and the whole hash is
+ * stored, which keeps the set at a few bytes per definition.
+ *
+ * @param usr The Unified Symbol Resolution of the function.
+ * @param file The real path of the file the function is defined in.
+ * @param offset The byte offset of the start of the definition in that file.
+ * @return True if this call claimed it, false if it had been claimed before.
+ */
+bool DefinitionSet::claim(std::string_view usr, std::string_view file, unsigned offset) {
+    const uint64_t key = hashCombine(hashCombine(hashString(usr), hashString(file)), offset);
+    Shard& shard = shards_[key >> 58];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.keys.insert(key).second;
+}
+
+/**
+ * @brief Returns the number of claimed definitions.
+ */
+size_t DefinitionSet::size() const {
+    size_t total = 0;
+    for (const Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.keys.size();
+    }
+    return total;
+}
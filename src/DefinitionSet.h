@@ -0,0 +1,48 @@
+/**
+ * @file DefinitionSet.h
+ * @brief This file contains the declaration of the DefinitionSet, which lets one translation unit claim each header
+ * function.
+ *
+ * Inline functions and template members defined in a header are seen by every translation unit that includes the
+ * header. When headers are extracted, each such definition is keyed by its USR and the location of its definition,
+ * and only the first translation unit to claim the key records, tokenizes and embeds it.
+ */
+
+#pragma once
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <unordered_set>
+
+/**
+ * @brief A concurrent set of claimed definitions shared by all parser threads.
+ *
+ * Keys are spread over independently locked shards, so threads claiming different definitions rarely contend.
+ */
+class DefinitionSet {
+public:
+    /**
+     * @brief Claims a definition.
+     * @param usr The Unified Symbol Resolution of the function.
+     * @param file The real path of the file the function is defined in.
+     * @param offset The byte offset of the start of the definition in that file.
+     * @return True if this call claimed it, false if it had been claimed before.
+     */
+    bool claim(std::string_view usr, std::string_view file, unsigned offset);
+
+    /**
+     * @brief Returns the number of claimed definitions.
+     */
+    size_t size() const;
+
+private:
+    static constexpr size_t kShards = 64;
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_set<uint64_t> keys;
+    };
+
+    std::array<Shard, kShards> shards_;
+};
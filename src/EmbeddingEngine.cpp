@@ -0,0 +1,238 @@
+/**
+ * @file EmbeddingEngine.cpp
+ * @brief This file contains the implementation of the batched embedding engine.
+ */
+
+#include "EmbeddingEngine.h"
+#include "FunctionCache.h"
+#include "ModelLoader.h"
+#include "SourceBuffer.h"
+#include "Tokenizer.h"
+#include "Trace.h"
+#include "common/common.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * @brief Creates an embedding context for a model loaded with its weights.
+ *
+ * Embedding models are usually non-causal, so every sequence must fit in one micro-batch; the micro-batch
+ * size is therefore set to the full batch size.
+ *
+ * @param model The embedding model.
+ * @param params The batch and sequence limits.
+ */
+EmbeddingEngine::EmbeddingEngine(llama_model* model, const EmbeddingEngineParams& params)
+    : n_embd_(llama_n_embd(model)), batchTokens_(params.batchTokens),
+      sequenceTokens_(maxSequenceTokens(model, params)), maxSequences_(params.maxSequences) {
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.embeddings = true;
+    ctx_params.n_ctx = params.batchTokens;
+    ctx_params.n_batch = params.batchTokens;
+    ctx_params.n_ubatch = params.batchTokens;
+    ctx_params.n_seq_max = params.maxSequences;
+    if (params.threads > 0) {
+        ctx_params.n_threads = params.threads;
+        ctx_params.n_threads_batch = params.threads;
+    }
+
+    ctx_ = llama_new_context_with_model(model, ctx_params);
+    if (!ctx_) {
+        std::cerr << "Failed to create embedding context." << std::endl;
+        return;
+    }
+
+    batch_ = llama_batch_init(static_cast<int32_t>(batchTokens_), 0, static_cast<int32_t>(maxSequences_));
+    batchOutput_.resize(static_cast<size_t>(maxSequences_) * n_embd_);
+}
+
+EmbeddingEngine::~EmbeddingEngine() {
+    if (ctx_) {
+        llama_batch_free(batch_);
+        llama_free(ctx_);
+    }
+}
+
+/**
+ * @brief The longest sequence an engine embeds whole.
+ *
+ * Positions past the trained context are meaningless to an embedding model, so longer sequences are truncated
+ * even when the batch would hold them.
+ */
+uint32_t EmbeddingEngine::maxSequenceTokens(const llama_model* model, const EmbeddingEngineParams& params) {
+    const int32_t trained = llama_n_ctx_train(model);
+    return trained > 0 ? std::min(params.batchTokens, static_cast<uint32_t>(trained)) : params.batchTokens;
+}
+
+/**
+ * @brief Embeds many token sequences.
+ *
+ * Sequences are visited from longest to shortest and appended to the current batch while both the token
+ * budget and the sequence limit allow it. Sorting keeps sequences of similar length together, so the
+ * batches fill up evenly and fewer decode calls are needed.
+ *
+ * @param sequences The token sequences.
+ * @param output Receives one normalized row per sequence.
+ * @return False if the engine is not valid or a batch could not be decoded.
+ */
+bool EmbeddingEngine::embed(const std::vector<std::vector<llama_token>>& sequences, std::vector<float>& output) {
+    TRACE_SCOPE("embed");
+    output.assign(sequences.size() * n_embd_, 0.0f);
+    if (!ctx_) {
+        return false;
+    }
+    if (sequences.empty()) {
+        return true;
+    }
+
+    std::vector<size_t> order(sequences.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return sequences[a].size() > sequences[b].size(); });
+
+    std::vector<size_t> slots; // batch sequence id -> index into sequences
+    slots.reserve(maxSequences_);
+    size_t batchTokenCount = 0;
+    bool ok = true;
+
+    auto flush = [&]() {
+        if (slots.empty()) {
+            return;
+        }
+        ok = batch_decode(ctx_, batch_, batchOutput_.data(), static_cast<int>(slots.size()), n_embd_) && ok;
+        for (size_t slot = 0; slot < slots.size(); ++slot) {
+            std::memcpy(output.data() + slots[slot] * n_embd_, batchOutput_.data() + slot * n_embd_,
+                        n_embd_ * sizeof(float));
+        }
+        llama_batch_clear(batch_);
+        slots.clear();
+        batchTokenCount = 0;
+    };
+
+    llama_batch_clear(batch_);
+    for (size_t index : order) {
+        const std::vector<llama_token>& tokens = sequences[index];
+        const size_t length = std::min<size_t>(tokens.size(), sequenceTokens_);
+        if (length == 0) {
+            continue;
+        }
+        if (length < tokens.size()) {
+            std::cerr << "Truncating sequence of " << tokens.size() << " tokens to " << length << std::endl;
+        }
+
+        if (batchTokenCount + length > batchTokens_ || slots.size() == maxSequences_) {
+            flush();
+        }
+
+        const auto seq_id = static_cast<llama_seq_id>(slots.size());
+        for (size_t i = 0; i < length; ++i) {
+            llama_batch_add(batch_, tokens[i], static_cast<llama_pos>(i), {seq_id}, i == length - 1);
+        }
+        slots.push_back(index);
+        batchTokenCount += length;
+    }
+    flush();
+    return ok;
+}
+
+/**
+ * @brief Computes the embedding of every function.
+ * @param functions The functions to embed.
+ * @param engine The embedding engine.
+ * @param tokenizer The tokenizer of the embedding model.
+ * @param cache The cache of embeddings, or nullptr.
+ * @param representatives For every function, the function whose embedding it shares, or nullptr.
+ * @param exactCounts Whether the token counts of functions may be stored in the cache.
+ * @return One normalized row per function.
+ */
+std::vector<float> embedFunctions(const FunctionTable& functions, EmbeddingEngine& engine,
+                                  const Tokenizer& tokenizer, const FunctionCache* cache,
+                                  const std::vector<uint32_t>* representatives, bool exactCounts) {
+    constexpr size_t kBlockSize = 4096;
+    const size_t n_embd = engine.dimension();
+    std::vector<float> embeddings(functions.size() * n_embd, 0.0f);
+
+    std::vector<size_t> pending;
+    std::vector<int> pendingCounts; // Token count stored with each new embedding
+    std::vector<std::string_view> texts;
+    std::vector<std::vector<llama_token>> tokens;
+    std::vector<float> output;
+    std::unordered_map<uint32_t, SourceBuffer> sources;
+    std::unordered_set<uint32_t> unreadable; // Files of the block that failed to open
+
+    for (size_t blockStart = 0; blockStart < functions.size(); blockStart += kBlockSize) {
+        const size_t blockEnd = std::min(blockStart + kBlockSize, functions.size());
+        pending.clear();
+        pendingCounts.clear();
+        texts.clear();
+        sources.clear();
+        unreadable.clear();
+
+        for (size_t i = blockStart; i < blockEnd; ++i) {
+            if (representatives && (*representatives)[i] != i) {
+                continue;
+            }
+            CacheEntry entry;
+            const bool cached = cache && cache->lookup({functions.fileHash(i), functions.extentHash(i)}, entry);
+            if (cached && entry.embedding.size() == n_embd) {
+                std::copy(entry.embedding.begin(), entry.embedding.end(), embeddings.begin() + i * n_embd);
+                continue;
+            }
+
+            auto it = sources.find(functions.fileId(i));
+            if (it == sources.end()) {
+                it = sources.emplace(functions.fileId(i), SourceBuffer()).first;
+                if (!it->second.open(functions.filePath(i))) {
+                    std::cerr << "Failed to open file: " << functions.filePath(i) << "; its functions are not embedded"
+                              << std::endl;
+                    unreadable.insert(functions.fileId(i));
+                }
+            }
+            if (unreadable.count(functions.fileId(i))) {
+                continue;
+            }
+            pending.push_back(i);
+            pendingCounts.push_back(cached ? entry.tokenCount : exactCounts ? functions.tokenCount(i) : kNoTokenCount);
+            texts.push_back(it->second.slice(functions.startOffset(i), functions.endOffset(i)));
+        }
+
+        if (pending.empty()) {
+            continue;
+        }
+
+        tokenizer.tokenize_batch(texts, tokens);
+        const bool embedded = engine.embed(tokens, output);
+        if (!embedded) {
+            std::cerr << "Failed to embed " << pending.size() << " functions; they are not cached" << std::endl;
+        }
+
+        for (size_t k = 0; k < pending.size(); ++k) {
+            const size_t i = pending[k];
+            std::copy(output.begin() + k * n_embd, output.begin() + (k + 1) * n_embd, embeddings.begin() + i * n_embd);
+            if (cache && embedded) {
+                CacheEntry entry;
+                entry.tokenCount = pendingCounts[k];
+                entry.embedding.assign(output.begin() + k * n_embd, output.begin() + (k + 1) * n_embd);
+                cache->store({functions.fileHash(i), functions.extentHash(i)}, entry);
+            }
+        }
+    }
+
+    if (representatives) {
+        // Representatives precede their duplicates, so every source row is final when it is copied
+        for (size_t i = 0; i < functions.size(); ++i) {
+            const size_t representative = (*representatives)[i];
+            if (representative != i) {
+                std::copy(embeddings.begin() + representative * n_embd,
+                          embeddings.begin() + (representative + 1) * n_embd, embeddings.begin() + i * n_embd);
+            }
+        }
+    }
+
+    return embeddings;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file EmbeddingEngine.h
+ * @brief This file contains the declaration of the batched embedding engine.
+ *
+ * The engine embeds many token sequences per llama_decode call. Sequences are sorted by length and packed
+ * into one llama_batch as separate sequence ids until the batch token budget or the context's sequence limit
+ * is reached. Pooled, normalized vectors are read back per sequence.
+ */
+
+#pragma once
+#include "FunctionTable.h"
+#include "llama.h"
+#include <cstdint>
+#include <vector>
+
+class FunctionCache;
+class Tokenizer;
+
+/**
+ * @brief Parameters of the embedding engine's context.
+ */
+struct EmbeddingEngineParams {
+    uint32_t batchTokens = 2048; ///< Tokens per decode call; also bounds the longest sequence embedded whole.
+    uint32_t maxSequences = 64;  ///< Sequences per decode call.
+    uint32_t threads = 0;        ///< Decode threads, 0 keeps llama's default.
+};
+
+/**
+ * @brief Packs many sequences into shared batches and returns one normalized embedding per sequence.
+ */
+class EmbeddingEngine {
+public:
+    /**
+     * @brief Creates an embedding context for a model loaded with its weights.
+     * @param model The embedding model. The engine does not take ownership.
+     * @param params The batch and sequence limits.
+     */
+    EmbeddingEngine(llama_model* model, const EmbeddingEngineParams& params = {});
+    ~EmbeddingEngine();
+
+    EmbeddingEngine(const EmbeddingEngine&) = delete;
+    EmbeddingEngine& operator=(const EmbeddingEngine&) = delete;
+
+    /**
+     * @brief Whether the context was created successfully.
+     */
+    bool valid() const { return ctx_ != nullptr; }
+
+    /**
+     * @brief The number of embedding dimensions.
+     */
+    int dimension() const { return n_embd_; }
+
+    /**
+     * @brief The longest sequence an engine embeds whole: the batch token budget, or the context the model was
+     *        trained with if that is shorter.
+     * @param model The embedding model.
+     * @param params The engine parameters.
+     */
+    static uint32_t maxSequenceTokens(const llama_model* model, const EmbeddingEngineParams& params = {});
+
+    /**
+     * @brief Embeds many token sequences.
+     * @param sequences The token sequences. Sequences longer than maxSequenceTokens() are truncated.
+     * @param output Receives a row-major matrix with one normalized row of dimension() floats per sequence.
+     * @return False if a batch could not be decoded. The rows of its sequences are zero and must not be cached.
+     */
+    bool embed(const std::vector<std::vector<llama_token>>& sequences, std::vector<float>& output);
+
+private:
+    llama_context* ctx_ = nullptr;
+    llama_batch batch_{};
+    int n_embd_ = 0;
+    uint32_t batchTokens_ = 0;
+    uint32_t sequenceTokens_ = 0;
+    uint32_t maxSequences_ = 0;
+    std::vector<float> batchOutput_;
+};
+
+/**
+ * @brief Computes the embedding of every function.
+ * @param functions The functions to embed. Their text is read back from their files.
+ * @param engine The embedding engine.
+ * @param tokenizer The tokenizer of the embedding model.
+ * @param cache The cache of embeddings, or nullptr.
+ * @param representatives For every function, the earlier function whose embedding it shares, or its own index; see
+ *                        findNearDuplicates(). nullptr embeds every function.
+ * @param exactCounts Whether the token counts of functions are exact. Estimated counts are never written to the
+ *                    cache: a new entry stores kNoTokenCount, and an exact count already cached is kept.
+ * @return A row-major matrix with one normalized row of engine.dimension() floats per function.
+ *
+ * Functions are processed in blocks so that only one block of token sequences is held in memory at a time.
+ * Cached embeddings are reused, and newly computed ones are written back to the cache unless their block failed
+ * to embed; the rows of a failed block stay zero. Functions whose file cannot be read are neither embedded nor
+ * cached, and their rows stay zero too. Only representatives are embedded; the row of every other function is a
+ * copy of its representative's row.
+ */
+std::vector<float> embedFunctions(const FunctionTable& functions, EmbeddingEngine& engine,
+                                  const Tokenizer& tokenizer, const FunctionCache* cache,
+                                  const std::vector<uint32_t>* representatives = nullptr, bool exactCounts = true);
@@ -0,0 +1,558 @@
+/**
+ * @file EmbeddingIndex.cpp
+ * @brief This file contains the implementation of the binary, memory-mappable embedding index.
+ */
+
+#include "EmbeddingIndex.h"
+#include "Trace.h"
+#include "VectorKernels.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char kIndexMagic[8] = {'C', 'C', 'H', 'U', 'N', 'K', 'I', 'X'};
+constexpr uint32_t kIndexVersion = 3;
+constexpr uint64_t kSectionAlignment = 64;
+
+uint64_t alignUp(uint64_t value) {
+    return (value + kSectionAlignment - 1) & ~(kSectionAlignment - 1);
+}
+
+size_t elementSize(EmbeddingType type) {
+    switch (type) {
+        case EmbeddingType::Fp16:
+            return sizeof(uint16_t);
+        case EmbeddingType::Int8:
+            return sizeof(int8_t);
+        case EmbeddingType::Fp32:
+        default:
+            return sizeof(float);
+    }
+}
+
+/**
+ * @brief Appends strings to a table once and returns their offsets.
+ *
+ * Strings are looked up by view, so the interned strings must outlive the interner.
+ */
+class StringInterner {
+public:
+    uint32_t intern(std::string_view text) {
+        auto it = offsets_.find(text);
+        if (it != offsets_.end()) {
+            return it->second;
+        }
+        const auto offset = static_cast<uint32_t>(data_.size());
+        data_.append(text);
+        data_.push_back('\0');
+        offsets_.emplace(text, offset);
+        return offset;
+    }
+
+    const std::string& data() const { return data_; }
+
+private:
+    std::string data_;
+    std::unordered_map<std::string_view, uint32_t> offsets_;
+};
+
+void writePadding(std::ofstream& out, uint64_t offset) {
+    static const char zeros[kSectionAlignment] = {};
+    const uint64_t current = static_cast<uint64_t>(out.tellp());
+    out.write(zeros, static_cast<std::streamsize>(offset - current));
+}
+
+} // namespace
+
+/**
+ * @brief Parses an embedding type name.
+ * @param name One of "fp32", "fp16", "int8".
+ * @param type Receives the parsed type.
+ * @return True if the name was recognized.
+ */
+bool parseEmbeddingType(const std::string& name, EmbeddingType& type) {
+    if (name == "fp32") {
+        type = EmbeddingType::Fp32;
+    } else if (name == "fp16") {
+        type = EmbeddingType::Fp16;
+    } else if (name == "int8") {
+        type = EmbeddingType::Int8;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Writes one segment file.
+ * @param path The segment path.
+ * @param functions The function metadata.
+ * @param embeddings A row-major matrix with one row per function, or nullptr if dimension is 0.
+ * @param dimension The number of embedding dimensions.
+ * @param type The storage type of the embeddings.
+ * @param coveredFiles Files the segment supersedes in addition to those of its records.
+ * @return True on success.
+ */
+bool writeIndexSegment(const fs::path& path, const FunctionTable& functions, const float* embeddings,
+                       size_t dimension, EmbeddingType type, const std::vector<std::string>& coveredFiles) {
+    if (!embeddings) {
+        dimension = 0;
+    }
+
+    StringInterner strings;
+    std::vector<IndexRecord> records;
+    records.reserve(functions.size());
+    for (size_t i = 0; i < functions.size(); ++i) {
+        IndexRecord record{};
+        record.filePathOffset = strings.intern(functions.filePath(i));
+        record.filePathLength = static_cast<uint32_t>(functions.filePath(i).size());
+        record.signatureOffset = strings.intern(functions.signature(i));
+        record.signatureLength = static_cast<uint32_t>(functions.signature(i).size());
+        record.startLine = functions.startLine(i);
+        record.endLine = functions.endLine(i);
+        record.tokenCount = functions.tokenCount(i);
+        record.startOffset = functions.startOffset(i);
+        record.endOffset = functions.endOffset(i);
+        record.fragment = static_cast<uint32_t>(functions.fragment(i) + 1);
+        record.fileHash = functions.fileHash(i);
+        record.extentHash = functions.extentHash(i);
+        record.parentHash = functions.parentHash(i);
+        records.push_back(record);
+    }
+
+    std::vector<IndexFileRef> covered;
+    covered.reserve(coveredFiles.size());
+    for (const std::string& file : coveredFiles) {
+        covered.push_back({strings.intern(file), static_cast<uint32_t>(file.size())});
+    }
+
+    const size_t rowBytes = dimension * elementSize(type);
+
+    IndexHeader header{};
+    std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    header.version = kIndexVersion;
+    header.embeddingType = static_cast<uint32_t>(type);
+    header.dimension = static_cast<uint32_t>(dimension);
+    header.count = functions.size();
+    header.stringsOffset = alignUp(sizeof(IndexHeader));
+    header.stringsSize = strings.data().size();
+    header.recordsOffset = alignUp(header.stringsOffset + header.stringsSize);
+    uint64_t end = header.recordsOffset + records.size() * sizeof(IndexRecord);
+    if (type == EmbeddingType::Int8 && dimension > 0) {
+        header.scalesOffset = alignUp(end);
+        end = header.scalesOffset + functions.size() * sizeof(float);
+    }
+    header.embeddingsOffset = alignUp(end);
+    header.coveredOffset = alignUp(header.embeddingsOffset + functions.size() * rowBytes);
+    header.coveredCount = covered.size();
+    header.fileSize = header.coveredOffset + covered.size() * sizeof(IndexFileRef);
+
+    fs::path tempPath = path;
+    tempPath += ".tmp." + std::to_string(getpid());
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to create index segment: " << tempPath << std::endl;
+        return false;
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writePadding(out, header.stringsOffset);
+    out.write(strings.data().data(), static_cast<std::streamsize>(strings.data().size()));
+    writePadding(out, header.recordsOffset);
+    out.write(reinterpret_cast<const char*>(records.data()),
+              static_cast<std::streamsize>(records.size() * sizeof(IndexRecord)));
+
+    if (dimension > 0) {
+        std::vector<unsigned char> row(rowBytes);
+        std::vector<float> scales;
+        std::vector<unsigned char> matrix;
+        matrix.reserve(functions.size() * rowBytes);
+
+        for (size_t i = 0; i < functions.size(); ++i) {
+            const float* source = embeddings + i * dimension;
+            switch (type) {
+                case EmbeddingType::Fp16:
+                    fp32ToFp16(source, reinterpret_cast<uint16_t*>(row.data()), dimension);
+                    break;
+                case EmbeddingType::Int8:
+                    scales.push_back(quantizeInt8(source, reinterpret_cast<int8_t*>(row.data()), dimension));
+                    break;
+                case EmbeddingType::Fp32:
+                default:
+                    std::memcpy(row.data(), source, rowBytes);
+                    break;
+            }
+            matrix.insert(matrix.end(), row.begin(), row.end());
+        }
+
+        if (type == EmbeddingType::Int8) {
+            writePadding(out, header.scalesOffset);
+            out.write(reinterpret_cast<const char*>(scales.data()),
+                      static_cast<std::streamsize>(scales.size() * sizeof(float)));
+        }
+        writePadding(out, header.embeddingsOffset);
+        out.write(reinterpret_cast<const char*>(matrix.data()), static_cast<std::streamsize>(matrix.size()));
+    }
+    writePadding(out, header.coveredOffset);
+    out.write(reinterpret_cast<const char*>(covered.data()),
+              static_cast<std::streamsize>(covered.size() * sizeof(IndexFileRef)));
+
+    out.close();
+    std::error_code ec;
+    if (!out) {
+        fs::remove(tempPath, ec);
+        std::cerr << "Failed to write index segment: " << path << std::endl;
+        return false;
+    }
+    fs::rename(tempPath, path, ec);
+    return !ec;
+}
+
+/**
+ * @brief Maps a segment file and validates its header and string references.
+ * @param path The segment path.
+ * @return True if the file is a valid segment.
+ */
+bool IndexSegment::open(const fs::path& path) {
+    header_ = nullptr;
+    path_ = path;
+    if (!file_.open(path) || file_.size() < sizeof(IndexHeader)) {
+        return false;
+    }
+
+    const auto* header = reinterpret_cast<const IndexHeader*>(file_.data());
+    if (std::memcmp(header->magic, kIndexMagic, sizeof(kIndexMagic)) != 0 || header->version != kIndexVersion ||
+        header->embeddingType > static_cast<uint32_t>(EmbeddingType::Int8) || header->fileSize != file_.size()) {
+        return false;
+    }
+
+    const size_t rowBytes = header->dimension * elementSize(static_cast<EmbeddingType>(header->embeddingType));
+    const bool inBounds =
+        header->stringsOffset + header->stringsSize <= file_.size() &&
+        header->recordsOffset + header->count * sizeof(IndexRecord) <= file_.size() &&
+        (header->scalesOffset == 0 || header->scalesOffset + header->count * sizeof(float) <= file_.size()) &&
+        header->embeddingsOffset + header->count * rowBytes <= file_.size() &&
+        header->coveredOffset + header->coveredCount * sizeof(IndexFileRef) <= file_.size();
+    if (!inBounds) {
+        return false;
+    }
+    const auto* covered = reinterpret_cast<const IndexFileRef*>(file_.data() + header->coveredOffset);
+    for (uint64_t i = 0; i < header->coveredCount; ++i) {
+        if (static_cast<uint64_t>(covered[i].offset) + covered[i].length > header->stringsSize) {
+            return false;
+        }
+    }
+    const auto* records = reinterpret_cast<const IndexRecord*>(file_.data() + header->recordsOffset);
+    for (uint64_t i = 0; i < header->count; ++i) {
+        if (static_cast<uint64_t>(records[i].filePathOffset) + records[i].filePathLength > header->stringsSize ||
+            static_cast<uint64_t>(records[i].signatureOffset) + records[i].signatureLength > header->stringsSize) {
+            return false;
+        }
+    }
+
+    header_ = header;
+    strings_ = file_.data() + header->stringsOffset;
+    records_ = records;
+    covered_ = covered;
+    scales_ = header->scalesOffset ? reinterpret_cast<const float*>(file_.data() + header->scalesOffset) : nullptr;
+    embeddings_ = reinterpret_cast<const unsigned char*>(file_.data() + header->embeddingsOffset);
+    rowBytes_ = rowBytes;
+    return true;
+}
+
+std::string_view IndexSegment::filePath(size_t i) const {
+    return {strings_ + records_[i].filePathOffset, records_[i].filePathLength};
+}
+
+std::string_view IndexSegment::coveredFile(size_t i) const {
+    return {strings_ + covered_[i].offset, covered_[i].length};
+}
+
+std::string_view IndexSegment::signature(size_t i) const {
+    return {strings_ + records_[i].signatureOffset, records_[i].signatureLength};
+}
+
+const void* IndexSegment::rawEmbedding(size_t i) const {
+    return embeddings_ + i * rowBytes_;
+}
+
+const float* IndexSegment::embeddingFp32(size_t i) const {
+    return embeddingType() == EmbeddingType::Fp32 ? reinterpret_cast<const float*>(rawEmbedding(i)) : nullptr;
+}
+
+/**
+ * @brief Decodes a row to fp32.
+ * @param i The row index.
+ * @param out Receives dimension() floats.
+ */
+void IndexSegment::decodeEmbedding(size_t i, float* out) const {
+    switch (embeddingType()) {
+        case EmbeddingType::Fp16:
+            fp16ToFp32(reinterpret_cast<const uint16_t*>(rawEmbedding(i)), out, dimension());
+            break;
+        case EmbeddingType::Int8:
+            dequantizeInt8(reinterpret_cast<const int8_t*>(rawEmbedding(i)), scales_[i], out, dimension());
+            break;
+        case EmbeddingType::Fp32:
+        default:
+            std::memcpy(out, rawEmbedding(i), rowBytes_);
+            break;
+    }
+}
+
+/**
+ * @brief Opens an index directory, creating it if needed, and maps all of its segments.
+ * @param directory The index directory.
+ * @return True on success.
+ */
+bool EmbeddingIndex::open(const fs::path& directory) {
+    directory_ = directory;
+    std::error_code ec;
+    fs::create_directories(directory_, ec);
+    if (!fs::is_directory(directory_)) {
+        std::cerr << "Not an index directory: " << directory_ << std::endl;
+        return false;
+    }
+    return reload();
+}
+
+/**
+ * @brief Maps every segment in the directory, oldest first, and indexes the files each one contains.
+ */
+bool EmbeddingIndex::reload() {
+    segments_.clear();
+    segmentFiles_.clear();
+    nextSegmentNumber_ = 0;
+
+    std::vector<std::pair<unsigned, fs::path>> paths;
+    for (const auto& entry : fs::directory_iterator(directory_)) {
+        unsigned number = 0;
+        const std::string name = entry.path().filename().string();
+        char suffix[8] = {0};
+        if (std::sscanf(name.c_str(), "seg-%u.%7s", &number, suffix) == 2 && std::string(suffix) == "ccix") {
+            paths.emplace_back(number, entry.path());
+            nextSegmentNumber_ = std::max(nextSegmentNumber_, number + 1);
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    for (const auto& [number, path] : paths) {
+        IndexSegment segment;
+        if (!segment.open(path)) {
+            std::cerr << "Skipping invalid index segment: " << path << std::endl;
+            continue;
+        }
+
+        std::vector<std::string_view> files;
+        for (size_t i = 0; i < segment.size(); ++i) {
+            files.push_back(segment.filePath(i));
+        }
+        for (size_t i = 0; i < segment.coveredCount(); ++i) {
+            files.push_back(segment.coveredFile(i));
+        }
+        std::sort(files.begin(), files.end());
+        files.erase(std::unique(files.begin(), files.end()), files.end());
+
+        segments_.push_back(std::move(segment));
+        segmentFiles_.push_back(std::move(files));
+    }
+    return true;
+}
+
+fs::path EmbeddingIndex::nextSegmentPath() const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "seg-%06u.ccix", nextSegmentNumber_);
+    return directory_ / name;
+}
+
+/**
+ * @brief Appends a new segment holding the given functions.
+ *
+ * A file that was deleted, or lost its last function, never appears among the records of a newer segment, so
+ * the covered files are what retire its old records.
+ *
+ * @return True on success.
+ */
+bool EmbeddingIndex::append(const FunctionTable& functions, const float* embeddings, size_t dimension,
+                            EmbeddingType type, const std::vector<std::string>& coveredFiles,
+                            const std::string& root) {
+    TRACE_SCOPE("index_write");
+    std::vector<std::string> covered = coveredFiles;
+    if (!root.empty()) {
+        // Files of the new records are not removed either, e.g. headers that are not input files themselves.
+        std::vector<std::string_view> inputs(coveredFiles.begin(), coveredFiles.end());
+        for (size_t i = 0; i < functions.size(); ++i) {
+            inputs.push_back(functions.filePath(i));
+        }
+        std::sort(inputs.begin(), inputs.end());
+        const std::string prefix = root.back() == '/' ? root : root + '/';
+
+        std::vector<std::string_view> removed;
+        for (const auto& [segment, i] : liveRecords()) {
+            const std::string_view file = segments_[segment].filePath(i);
+            if ((file == root || file.substr(0, prefix.size()) == prefix) &&
+                !std::binary_search(inputs.begin(), inputs.end(), file)) {
+                removed.push_back(file);
+            }
+        }
+        std::sort(removed.begin(), removed.end());
+        removed.erase(std::unique(removed.begin(), removed.end()), removed.end());
+        covered.insert(covered.end(), removed.begin(), removed.end());
+    }
+
+    if (!writeIndexSegment(nextSegmentPath(), functions, embeddings, dimension, type, covered)) {
+        return false;
+    }
+    invalidateAnn();
+    return reload();
+}
+
+/**
+ * @brief Whether a record is live, i.e. no newer segment contains or covers the same file.
+ */
+bool EmbeddingIndex::isLive(size_t segment, size_t i) const {
+    const std::string_view file = segments_[segment].filePath(i);
+    for (size_t newer = segment + 1; newer < segments_.size(); ++newer) {
+        if (std::binary_search(segmentFiles_[newer].begin(), segmentFiles_[newer].end(), file)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Returns the number of live records.
+ */
+size_t EmbeddingIndex::liveCount() const {
+    size_t count = 0;
+    for (size_t s = 0; s < segments_.size(); ++s) {
+        for (size_t i = 0; i < segments_[s].size(); ++i) {
+            count += isLive(s, i) ? 1 : 0;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Returns the (segment, record) position of every live record, in segment order.
+ */
+std::vector<std::pair<uint32_t, uint32_t>> EmbeddingIndex::liveRecords() const {
+    std::vector<std::pair<uint32_t, uint32_t>> live;
+    for (size_t s = 0; s < segments_.size(); ++s) {
+        for (size_t i = 0; i < segments_[s].size(); ++i) {
+            if (isLive(s, i)) {
+                live.emplace_back(static_cast<uint32_t>(s), static_cast<uint32_t>(i));
+            }
+        }
+    }
+    return live;
+}
+
+/**
+ * @brief Decodes the embeddings of the live records into one fp32 matrix, in liveRecords() order.
+ *
+ * Records of segments written without embeddings, or with another dimension, get a zero row.
+ *
+ * @param dimension Receives the embedding dimension, 0 if the index has no embeddings.
+ */
+std::vector<float> EmbeddingIndex::liveEmbeddings(size_t& dimension) const {
+    dimension = 0;
+    for (const IndexSegment& segment : segments_) {
+        dimension = std::max(dimension, segment.dimension());
+    }
+
+    const auto live = liveRecords();
+    std::vector<float> matrix(live.size() * dimension, 0.0f);
+    for (size_t row = 0; row < live.size() && dimension > 0; ++row) {
+        const IndexSegment& segment = segments_[live[row].first];
+        if (segment.dimension() == dimension) {
+            segment.decodeEmbedding(live[row].second, matrix.data() + row * dimension);
+        }
+    }
+    return matrix;
+}
+
+/**
+ * @brief Deletes the nearest-neighbor graph, whose node ids no longer match the live records.
+ */
+void EmbeddingIndex::invalidateAnn() const {
+    std::error_code ec;
+    fs::remove(annPath(), ec);
+}
+
+/**
+ * @brief Merges the live records of all segments into one new segment and deletes the old ones.
+ *
+ * The new segment is written before anything is deleted, and it supersedes every file of the older
+ * segments, so a reader that opens the directory during compaction still sees a consistent index.
+ *
+ * @param type The storage type of the compacted embeddings.
+ * @return True on success.
+ */
+bool EmbeddingIndex::compact(EmbeddingType type) {
+    if (segments_.size() <= 1) {
+        return true;
+    }
+
+    size_t dimension = 0;
+    for (const IndexSegment& segment : segments_) {
+        dimension = std::max(dimension, segment.dimension());
+    }
+
+    FunctionTable functions;
+    FunctionInfo info;
+    std::vector<float> embeddings;
+    for (size_t s = 0; s < segments_.size(); ++s) {
+        const IndexSegment& segment = segments_[s];
+        for (size_t i = 0; i < segment.size(); ++i) {
+            if (!isLive(s, i)) {
+                continue;
+            }
+            const IndexRecord& record = segment.record(i);
+            info.filePath.assign(segment.filePath(i));
+            info.signature.assign(segment.signature(i));
+            info.startLine = record.startLine;
+            info.endLine = record.endLine;
+            info.tokenCount = record.tokenCount;
+            info.startOffset = record.startOffset;
+            info.endOffset = record.endOffset;
+            info.fileHash = record.fileHash;
+            info.extentHash = record.extentHash;
+            info.parentHash = record.parentHash;
+            info.fragment = static_cast<int>(record.fragment) - 1;
+            functions.append(info);
+
+            const size_t row = embeddings.size();
+            embeddings.resize(row + dimension, 0.0f);
+            if (segment.dimension() == dimension && dimension > 0) {
+                segment.decodeEmbedding(i, embeddings.data() + row);
+            }
+        }
+    }
+
+    std::vector<fs::path> oldPaths;
+    for (const IndexSegment& segment : segments_) {
+        oldPaths.push_back(segment.path());
+    }
+
+    if (!writeIndexSegment(nextSegmentPath(), functions, dimension ? embeddings.data() : nullptr, dimension, type)) {
+        return false;
+    }
+
+    invalidateAnn();
+    segments_.clear();
+    segmentFiles_.clear();
+    std::error_code ec;
+    for (const fs::path& path : oldPaths) {
+        fs::remove(path, ec);
+    }
+    return reload();
+}
@@ -0,0 +1,242 @@
+/**
+ * @file EmbeddingIndex.h
+ * @brief This file contains the declarations of the binary, memory-mappable embedding index.
+ *
+ * An index is a directory of append-only segment files named seg-NNNNNN.ccix. Each segment is laid out so
+ * that it can be used directly from an mmap:
+ *
+ * - IndexHeader: magic, version, embedding type, dimension, record count and section offsets.
+ * - String table: interned, NUL-terminated file paths and signatures.
+ * - Records: one fixed-size IndexRecord per function, referencing the string table.
+ * - Scales: one float per row, present only for int8 embeddings.
+ * - Embeddings: a contiguous row-major matrix of fp32, fp16 or int8 values.
+ * - Covered files: string table references to the files the run looked at, including files that now have no
+ *   functions and files that no longer exist.
+ *
+ * Every section starts on a 64-byte boundary. A newer segment supersedes all records of the files it
+ * contains or covers, so re-indexing a set of files is an append, a covered file without records acts as a
+ * tombstone, and compaction merges the live records of all segments into one. An optional approximate
+ * nearest-neighbor graph over the live records is stored next to the segments as ann.hnsw; its node ids are the
+ * positions of the live records in segment order.
+ */
+
+#pragma once
+#include "FunctionTable.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Storage type of the embedding matrix.
+ */
+enum class EmbeddingType : uint32_t {
+    Fp32 = 0,
+    Fp16 = 1,
+    Int8 = 2,
+};
+
+/**
+ * @brief Header at the start of every segment file.
+ */
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t embeddingType;
+    uint32_t dimension;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+    uint64_t recordsOffset;
+    uint64_t scalesOffset;
+    uint64_t embeddingsOffset;
+    uint64_t coveredOffset;
+    uint64_t coveredCount;
+    uint64_t fileSize;
+};
+
+/**
+ * @brief Reference to a file path in the string table.
+ */
+struct IndexFileRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+/**
+ * @brief Fixed-size metadata of one function in a segment.
+ */
+struct IndexRecord {
+    uint32_t filePathOffset;
+    uint32_t filePathLength;
+    uint32_t signatureOffset;
+    uint32_t signatureLength;
+    int32_t startLine;
+    int32_t endLine;
+    int32_t tokenCount;
+    uint32_t startOffset;
+    uint32_t endOffset;
+    uint32_t fragment; ///< 0 for a whole function, otherwise the 1-based position among its parent's fragments.
+    uint64_t fileHash;
+    uint64_t extentHash;
+    uint64_t parentHash; ///< extentHash of the function this is a fragment of, 0 for a whole function.
+};
+
+static_assert(sizeof(IndexRecord) == 64, "IndexRecord is part of the on-disk format");
+
+/**
+ * @brief Parses an embedding type name.
+ * @param name One of "fp32", "fp16", "int8".
+ * @param type Receives the parsed type.
+ * @return True if the name was recognized.
+ */
+bool parseEmbeddingType(const std::string& name, EmbeddingType& type);
+
+/**
+ * @brief Writes one segment file.
+ * @param path The segment path. The file is written under a temporary name and renamed into place.
+ * @param functions The function metadata.
+ * @param embeddings A row-major matrix with one row per function, or nullptr if dimension is 0.
+ * @param dimension The number of embedding dimensions, 0 for a metadata-only segment.
+ * @param type The storage type of the embeddings.
+ * @param coveredFiles Files whose older records the segment supersedes in addition to those of its records.
+ * @return True on success.
+ */
+bool writeIndexSegment(const std::filesystem::path& path, const FunctionTable& functions,
+                       const float* embeddings, size_t dimension, EmbeddingType type,
+                       const std::vector<std::string>& coveredFiles = {});
+
+/**
+ * @brief A read-only, memory-mapped segment.
+ *
+ * Records, strings and embedding rows are returned as views into the mapping; nothing is copied on open.
+ */
+class IndexSegment {
+public:
+    /**
+     * @brief Maps a segment file and validates its header and string references.
+     * @param path The segment path.
+     * @return True if the file is a valid segment.
+     */
+    bool open(const std::filesystem::path& path);
+
+    size_t size() const { return header_ ? header_->count : 0; }
+    size_t dimension() const { return header_ ? header_->dimension : 0; }
+    EmbeddingType embeddingType() const { return static_cast<EmbeddingType>(header_->embeddingType); }
+    const std::filesystem::path& path() const { return path_; }
+
+    const IndexRecord& record(size_t i) const { return records_[i]; }
+    std::string_view filePath(size_t i) const;
+    std::string_view signature(size_t i) const;
+
+    size_t coveredCount() const { return header_ ? header_->coveredCount : 0; }
+    std::string_view coveredFile(size_t i) const;
+
+    /**
+     * @brief Returns the raw storage of an embedding row.
+     */
+    const void* rawEmbedding(size_t i) const;
+
+    /**
+     * @brief Returns a row as fp32 without copying, or nullptr if the segment is not fp32.
+     */
+    const float* embeddingFp32(size_t i) const;
+
+    /**
+     * @brief Decodes a row to fp32.
+     * @param i The row index.
+     * @param out Receives dimension() floats.
+     */
+    void decodeEmbedding(size_t i, float* out) const;
+
+private:
+    MappedFile file_;
+    std::filesystem::path path_;
+    const IndexHeader* header_ = nullptr;
+    const IndexRecord* records_ = nullptr;
+    const IndexFileRef* covered_ = nullptr;
+    const char* strings_ = nullptr;
+    const float* scales_ = nullptr;
+    const unsigned char* embeddings_ = nullptr;
+    size_t rowBytes_ = 0;
+};
+
+/**
+ * @brief A directory of segments.
+ */
+class EmbeddingIndex {
+public:
+    /**
+     * @brief Opens an index directory, creating it if needed, and maps all of its segments.
+     * @param directory The index directory.
+     * @return True on success.
+     */
+    bool open(const std::filesystem::path& directory);
+
+    /**
+     * @brief Appends a new segment holding the given functions.
+     * @param functions The function metadata.
+     * @param embeddings A row-major matrix with one row per function, or nullptr if dimension is 0.
+     * @param dimension The number of embedding dimensions.
+     * @param type The storage type of the embeddings.
+     * @param coveredFiles Every input file of the run, including those without functions. Their older records
+     *                     are superseded even if the new segment has none for them.
+     * @param root The input path of the run, or empty. Live files under it that are not covered no longer exist
+     *             and are covered as tombstones.
+     * @return True on success.
+     */
+    bool append(const FunctionTable& functions, const float* embeddings, size_t dimension, EmbeddingType type,
+                const std::vector<std::string>& coveredFiles = {}, const std::string& root = {});
+
+    /**
+     * @brief Merges the live records of all segments into one new segment and deletes the old ones.
+     * @param type The storage type of the compacted embeddings.
+     * @return True on success.
+     */
+    bool compact(EmbeddingType type);
+
+    /**
+     * @brief Whether a record is live, i.e. no newer segment contains or covers the same file.
+     * @param segment The segment index.
+     * @param i The record index within the segment.
+     */
+    bool isLive(size_t segment, size_t i) const;
+
+    const std::vector<IndexSegment>& segments() const { return segments_; }
+
+    /**
+     * @brief Returns the number of live records.
+     */
+    size_t liveCount() const;
+
+    /**
+     * @brief Returns the (segment, record) position of every live record, in segment order.
+     */
+    std::vector<std::pair<uint32_t, uint32_t>> liveRecords() const;
+
+    /**
+     * @brief Decodes the embeddings of the live records into one fp32 matrix, in liveRecords() order.
+     * @param dimension Receives the embedding dimension, 0 if the index has no embeddings.
+     */
+    std::vector<float> liveEmbeddings(size_t& dimension) const;
+
+    /**
+     * @brief Path of the nearest-neighbor graph over the live records.
+     *
+     * append() and compact() change the live record set and therefore delete this file.
+     */
+    std::filesystem::path annPath() const { return directory_ / "ann.hnsw"; }
+
+private:
+    bool reload();
+    void invalidateAnn() const;
+    std::filesystem::path nextSegmentPath() const;
+
+    std::filesystem::path directory_;
+    std::vector<IndexSegment> segments_;
+    std::vector<std::vector<std::string_view>> segmentFiles_; ///< Sorted files contained in or covered by each segment.
+    unsigned nextSegmentNumber_ = 0;
+};
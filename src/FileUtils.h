@@ -4,23 +4,28 @@
  */
 
 #pragma once
+#include "Crawler.h"
 #include <string>
 #include <vector>
 #include <filesystem>
 
 /**
- * @brief Reads a source file and returns its content as a vector of strings.
- * @param filename The name of the file to read.
- * @return A vector of strings, where each string is a line from the file.
+ * @brief Checks whether a path has a source file extension.
+ * @param path The path to check.
+ * @param options The crawl options whose extensions apply.
+ * @return True if the path has one of the source extensions (case-insensitive).
+ *
+ * Only the extension is checked. Use CrawlFilter to apply the exclude rules and the other filters of a crawl.
  */
-std::vector<std::string> readSourceFile(const char* filename);
+bool isSourceFile(const std::filesystem::path& path, const CrawlOptions& options = {});
 
 /**
- * @brief Reads source files from a directory or a single file.
- * @param path The path to the directory or file to read.
- * @return A vector of strings, where each string is a line from the files.
+ * @brief Collects the source files under a directory or a single file.
+ * @param path The path to the directory or file.
+ * @param options The extensions and filters, see crawlSourceFiles().
+ * @return The sorted list of source files found.
  *
- * This function reads all .cpp files in the given directory (recursively) or the single .cpp file.
- * It returns the content of the files as a vector of strings, where each string is a line from the files.
+ * Directories are walked recursively. The list is sorted so that repeated runs visit files in the same order.
  */
-std::vector<std::string> readSourceFiles(const std::filesystem::path& path);
\ No newline at end of file
+std::vector<std::filesystem::path> collectSourceFiles(const std::filesystem::path& path,
+                                                      const CrawlOptions& options = {});
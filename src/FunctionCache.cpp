@@ -0,0 +1,143 @@
+/**
+ * @file FunctionCache.cpp
+ * @brief This file contains the implementation of the on-disk, content-hashed function cache.
+ */
+
+#include "FunctionCache.h"
+#include "Hash.h"
+#include "Trace.h"
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint32_t kCacheMagic = 0x43464343; // "CCFC"
+constexpr uint32_t kCacheVersion = 1;
+
+/**
+ * @brief Fixed-size header at the start of every entry file.
+ */
+struct EntryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t fileHash;
+    uint64_t extentHash;
+    uint64_t modelFingerprint;
+    int32_t tokenCount;
+    uint32_t embeddingSize;
+};
+
+} // namespace
+
+/**
+ * @brief Opens a cache directory, creating it if needed.
+ * @param directory The cache directory.
+ * @param modelFingerprint Fingerprint of the tokenizer and embedding models.
+ */
+FunctionCache::FunctionCache(fs::path directory, uint64_t modelFingerprint)
+    : directory_(std::move(directory)), modelFingerprint_(modelFingerprint) {
+    std::error_code ec;
+    fs::create_directories(directory_, ec);
+}
+
+/**
+ * @brief Builds the path of an entry file.
+ *
+ * Entries are spread over 256 subdirectories by the first byte of the name to keep directories small.
+ *
+ * @param key The function key.
+ * @return The entry path.
+ */
+fs::path FunctionCache::entryPath(const CacheKey& key) const {
+    uint64_t name = hashCombine(hashCombine(key.fileHash, key.extentHash), modelFingerprint_);
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016" PRIx64, name);
+    return directory_ / std::string(hex, 2) / hex;
+}
+
+/**
+ * @brief Looks up a function.
+ *
+ * The full key is stored in the entry and compared on read, so a collision of the file name hash is
+ * reported as a miss instead of returning another function's data.
+ *
+ * @param key The function key.
+ * @param entry Receives the cached data on a hit.
+ * @return True on a hit.
+ */
+bool FunctionCache::lookup(const CacheKey& key, CacheEntry& entry) const {
+    TRACE_SCOPE("cache_lookup");
+    std::ifstream in(entryPath(key), std::ios::binary);
+    EntryHeader header{};
+    bool hit = in && in.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+               header.magic == kCacheMagic && header.version == kCacheVersion &&
+               header.fileHash == key.fileHash && header.extentHash == key.extentHash &&
+               header.modelFingerprint == modelFingerprint_;
+
+    if (hit) {
+        entry.tokenCount = header.tokenCount;
+        entry.embedding.resize(header.embeddingSize);
+        hit = static_cast<bool>(in.read(reinterpret_cast<char*>(entry.embedding.data()),
+                                        static_cast<std::streamsize>(header.embeddingSize * sizeof(float))));
+    }
+
+    (hit ? hits_ : misses_).fetch_add(1, std::memory_order_relaxed);
+    traceCount(hit ? TraceCounter::CacheHits : TraceCounter::CacheMisses);
+    return hit;
+}
+
+/**
+ * @brief Stores or replaces a function entry.
+ *
+ * The entry is written to a temporary file unique to this process and thread and then renamed over the
+ * final name, so concurrent readers and writers only ever see complete entries.
+ *
+ * @param key The function key.
+ * @param entry The data to store.
+ * @return True if the entry was written.
+ */
+bool FunctionCache::store(const CacheKey& key, const CacheEntry& entry) const {
+    static std::atomic<uint64_t> tempCounter{0};
+
+    const fs::path path = entryPath(key);
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+
+    fs::path tempPath = path;
+    tempPath += ".tmp." + std::to_string(getpid()) + "." +
+                std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + "." +
+                std::to_string(tempCounter++);
+
+    EntryHeader header{kCacheMagic,
+                       kCacheVersion,
+                       key.fileHash,
+                       key.extentHash,
+                       modelFingerprint_,
+                       entry.tokenCount,
+                       static_cast<uint32_t>(entry.embedding.size())};
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(entry.embedding.data()),
+                  static_cast<std::streamsize>(entry.embedding.size() * sizeof(float)));
+        if (!out) {
+            out.close();
+            fs::remove(tempPath, ec);
+            return false;
+        }
+    }
+
+    fs::rename(tempPath, path, ec);
+    if (ec) {
+        fs::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file FunctionCache.h
+ * @brief This file contains the declaration of the on-disk, content-hashed function cache.
+ *
+ * The cache stores the token count and the embedding of each function under a key derived from the content
+ * hash of its file, the hash of its extent, and a fingerprint of the models. Functions whose key is found are
+ * not tokenized or embedded again. Every entry is its own file, written to a temporary name and renamed into
+ * place, so several processes can share one cache directory without locking.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+/**
+ * @brief Key identifying one function in the cache.
+ */
+struct CacheKey {
+    uint64_t fileHash;   ///< Hash of the whole content of the file containing the function.
+    uint64_t extentHash; ///< Hash of the function's byte range and text.
+};
+
+/**
+ * @brief Token count of an entry that only holds an embedding, stored when the count was only estimated.
+ */
+constexpr int kNoTokenCount = -1;
+
+/**
+ * @brief Cached data of one function.
+ */
+struct CacheEntry {
+    int tokenCount = 0;           ///< Exact token count, or kNoTokenCount if it is not known.
+    std::vector<float> embedding; ///< Empty if the function has not been embedded yet.
+};
+
+/**
+ * @brief Directory-backed cache of token counts and embeddings.
+ */
+class FunctionCache {
+public:
+    /**
+     * @brief Opens a cache directory, creating it if needed.
+     * @param directory The cache directory.
+     * @param modelFingerprint Fingerprint of the tokenizer and embedding models; entries written with a
+     *                         different fingerprint are never returned.
+     */
+    FunctionCache(std::filesystem::path directory, uint64_t modelFingerprint);
+
+    /**
+     * @brief Looks up a function.
+     * @param key The function key.
+     * @param entry Receives the cached data on a hit.
+     * @return True on a hit.
+     */
+    bool lookup(const CacheKey& key, CacheEntry& entry) const;
+
+    /**
+     * @brief Stores or replaces a function entry.
+     * @param key The function key.
+     * @param entry The data to store.
+     * @return True if the entry was written.
+     */
+    bool store(const CacheKey& key, const CacheEntry& entry) const;
+
+    uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+private:
+    std::filesystem::path entryPath(const CacheKey& key) const;
+
+    std::filesystem::path directory_;
+    uint64_t modelFingerprint_;
+    mutable std::atomic<uint64_t> hits_{0};
+    mutable std::atomic<uint64_t> misses_{0};
+};
@@ -1,46 +1,208 @@
 #include "FunctionExtractor.h"
-#include "ModelLoader.h"
-#include "common/common.h"
+#include "DefinitionSet.h"
+#include "FunctionCache.h"
+#include "FunctionSplitter.h"
+#include "Hash.h"
+#include "Trace.h"
+
+/**
+ * @brief Returns a mapped header, opening it on first use.
+ * @param path The path of the header.
+ * @param fileHash Receives the content hash of the header.
+ * @return The header, or nullptr if it could not be opened.
+ */
+const SourceBuffer* HeaderSources::get(const std::string& path, uint64_t& fileHash) {
+    std::unique_ptr<Entry>& entry = entries_[path];
+    if (!entry) {
+        entry = std::make_unique<Entry>();
+        entry->valid = entry->source.open(path);
+        if (entry->valid) {
+            entry->hash = hashString(entry->source.text());
+        }
+    }
+    fileHash = entry->hash;
+    return entry->valid ? &entry->source : nullptr;
+}
+
+/**
+ * @brief Records a function and counts its tokens.
+ *
+ * The function text is a view into the mapped source buffer, so nothing is copied. When a cache is given, the
+ * token count is taken from it if the function is unchanged, and stored in it otherwise. Without a tokenizer
+ * the token count is left at 0 for a later stage to fill in.
+ *
+ * @param filePath The path of the file the function is defined in.
+ * @param signature The spelling of the function name.
+ * @param startLine The 1-based line of the first character of the function.
+ * @param endLine The 1-based line of the last character of the function.
+ * @param startOffset The byte offset of the first character of the function.
+ * @param endOffset The byte offset one past the last character of the function.
+ * @param source The mapped source file the offsets refer to.
+ * @param tokenizer The tokenizer used to count the function tokens, or nullptr to skip counting.
+ * @param functionsInfo The vector to store the function information.
+ * @param cache The cache of token counts, or nullptr.
+ * @param fileHash The content hash of the file, used in the cache key.
+ */
+void appendFunctionInfo(std::string filePath, std::string signature, int startLine, int endLine, unsigned startOffset,
+                        unsigned endOffset, const SourceBuffer& source, const Tokenizer* tokenizer,
+                        std::vector<FunctionInfo>& functionsInfo, const FunctionCache* cache, uint64_t fileHash) {
+    std::string_view functionText = source.slice(startOffset, endOffset);
+
+    const uint64_t extentHash = hashCombine(hashCombine(hashString(functionText), startOffset), endOffset);
+    const CacheKey key{fileHash, extentHash};
+
+    CacheEntry entry;
+    if (tokenizer && (!cache || !cache->lookup(key, entry) || entry.tokenCount == kNoTokenCount)) {
+        entry.tokenCount = tokenizer->count(functionText);
+        if (cache) {
+            cache->store(key, entry);
+        }
+    }
+    functionsInfo.push_back({std::move(filePath), std::move(signature), startLine, endLine, entry.tokenCount,
+                             startOffset, endOffset, fileHash, extentHash});
+    traceCount(TraceCounter::Functions);
+}
 
 /**
  * @brief Extracts and tokenizes the text of a function.
  *
- * This function extracts the text of a function from the source code based on the provided range.
- * It then tokenizes the function text using the provided model and stores the function information
- * in the provided vector.
+ * This function resolves the byte offsets and lines of the cursor extent and records the function with
+ * appendFunctionInfo().
  *
  * @param cursor The cursor representing the function.
  * @param range The source range of the function.
- * @param sourceLines The vector containing the source code lines.
- * @param model The model used for tokenization.
+ * @param source The mapped source file the range refers to.
+ * @param tokenizer The tokenizer used to count the function tokens, or nullptr to skip counting.
  * @param functionsInfo The vector to store the function information.
+ * @param cache The cache of token counts, or nullptr.
+ * @param fileHash The content hash of the file, used in the cache key.
  */
-void extractAndTokenizeFunctionText(CXCursor cursor, const CXSourceRange& range, const std::vector<std::string>& sourceLines, llama_model* model, std::vector<FunctionInfo>& functionsInfo){
+void extractAndTokenizeFunctionText(CXCursor cursor, const CXSourceRange& range, const SourceBuffer& source, const Tokenizer* tokenizer, std::vector<FunctionInfo>& functionsInfo, const FunctionCache* cache, uint64_t fileHash){
     CXSourceLocation startLoc = clang_getRangeStart(range);
     CXSourceLocation endLoc = clang_getRangeEnd(range);
-    unsigned startLine, startColumn, endLine, endColumn;
-    clang_getSpellingLocation(startLoc, nullptr, &startLine, &startColumn, nullptr);
-    clang_getSpellingLocation(endLoc, nullptr, &endLine, &endColumn, nullptr);
+    CXFile file;
+    unsigned startLine, startColumn, startOffset, endLine, endColumn, endOffset;
+    clang_getFileLocation(startLoc, &file, &startLine, &startColumn, &startOffset);
+    clang_getFileLocation(endLoc, nullptr, &endLine, &endColumn, &endOffset);
 
-    std::string functionText;
-    for (unsigned i = startLine; i <= endLine; ++i) {
-        functionText += (i == startLine ? sourceLines[i - 1].substr(startColumn - 1) : sourceLines[i - 1]) + "\n";
-    }
-
-    int tokenCount = tokenize(model, functionText).size();
     CXString cursorSpelling = clang_getCursorSpelling(cursor);
     std::string functionSignature = clang_getCString(cursorSpelling);
-    functionsInfo.push_back({functionSignature, static_cast<int>(startLine), static_cast<int>(endLine), tokenCount});
+    CXString fileName = clang_getFileName(file);
+    std::string filePath = clang_getCString(fileName) ? clang_getCString(fileName) : "";
+    appendFunctionInfo(std::move(filePath), std::move(functionSignature), static_cast<int>(startLine),
+                       static_cast<int>(endLine), startOffset, endOffset, source, tokenizer, functionsInfo, cache,
+                       fileHash);
 
+    clang_disposeString(fileName);
     clang_disposeString(cursorSpelling);
 }
 
+/**
+ * @brief State of the statement boundary search in one function.
+ */
+struct CutData {
+    unsigned begin;             ///< First byte of the function.
+    unsigned end;               ///< One past the last byte of the function.
+    unsigned maxBytes;          ///< Statements longer than this are searched for nested boundaries.
+    std::vector<unsigned> cuts; ///< Byte offsets where a statement starts.
+};
+
+/**
+ * @brief Visitor that records where the statements of a function body start.
+ *
+ * Every child of a compound statement is a boundary. Only statements that could exceed the split limit are
+ * entered, which reaches the blocks nested in large if, loop and switch statements while leaving expressions alone.
+ */
+static CXChildVisitResult cutVisitor(CXCursor cursor, CXCursor parent, CXClientData client_data) {
+    CutData* data = reinterpret_cast<CutData*>(client_data);
+    const bool inBlock = parent.kind == CXCursor_CompoundStmt;
+    if (!inBlock && !clang_isStatement(cursor.kind)) {
+        return CXChildVisit_Continue;
+    }
+
+    CXSourceRange range = clang_getCursorExtent(cursor);
+    unsigned begin, end;
+    clang_getFileLocation(clang_getRangeStart(range), nullptr, nullptr, nullptr, &begin);
+    clang_getFileLocation(clang_getRangeEnd(range), nullptr, nullptr, nullptr, &end);
+    if (begin <= data->begin || end > data->end || end <= begin) {
+        return CXChildVisit_Continue;
+    }
+    if (inBlock) {
+        data->cuts.push_back(begin);
+    }
+    return end - begin > data->maxBytes ? CXChildVisit_Recurse : CXChildVisit_Continue;
+}
+
+/**
+ * @brief Replaces the function just recorded with its fragments if it exceeds the split limit.
+ * @param cursor The cursor of the function.
+ * @param data The visitor state.
+ */
+static void splitIfOversized(CXCursor cursor, VisitorData& data, const SourceBuffer& source,
+                             std::vector<FunctionInfo>& functionsInfo) {
+    const FunctionInfo& info = functionsInfo.back();
+    if (!data.splitter->oversized(info, source)) {
+        return;
+    }
+    CutData cuts{info.startOffset, info.endOffset, static_cast<unsigned>(data.splitter->maxTokens()), {}};
+    clang_visitChildren(cursor, cutVisitor, &cuts);
+    data.splitter->split(std::move(cuts.cuts), source, data.tokenizer, data.cache, functionsInfo);
+}
+
+/**
+ * @brief Records a function defined in a header, unless another translation unit has already claimed it.
+ *
+ * Headers are identified by their real path, so one reached through different include paths is still claimed
+ * once. Only definitions are recorded; a declaration in a header has no body to chunk.
+ *
+ * @param cursor The cursor of the function.
+ * @param range The extent of the function.
+ * @param data The visitor state.
+ */
+static void extractHeaderFunction(CXCursor cursor, const CXSourceRange& range, VisitorData& data) {
+    if (!clang_isCursorDefinition(cursor)) {
+        return;
+    }
+    CXFile file;
+    unsigned startOffset;
+    clang_getFileLocation(clang_getRangeStart(range), &file, nullptr, nullptr, &startOffset);
+    CXString realPath = clang_File_tryGetRealPathName(file);
+    CXString fileName = clang_getFileName(file);
+    const char* realPathText = clang_getCString(realPath);
+    const char* fileNameText = clang_getCString(fileName);
+    const std::string filePath = realPathText && *realPathText ? realPathText : fileNameText ? fileNameText : "";
+    clang_disposeString(fileName);
+    clang_disposeString(realPath);
+
+    // Open the header before claiming, so a header this unit cannot read is left for another unit to claim
+    uint64_t fileHash = 0;
+    const SourceBuffer* source = data.headers->get(filePath, fileHash);
+    if (!source) {
+        return;
+    }
+
+    CXString usr = clang_getCursorUSR(cursor);
+    const char* usrText = clang_getCString(usr);
+    const bool claimed = data.definitions->claim(usrText ? usrText : "", filePath, startOffset);
+    clang_disposeString(usr);
+    if (!claimed) {
+        return;
+    }
+    extractAndTokenizeFunctionText(cursor, range, *source, data.tokenizer, *data.headerFunctionsInfo, data.cache,
+                                   fileHash);
+    data.headerFunctionsInfo->back().filePath = filePath;
+    if (data.splitter) {
+        splitIfOversized(cursor, data, *source, *data.headerFunctionsInfo);
+    }
+}
+
 /**
  * @brief The visitor function called by the Clang AST traversal.
  *
  * This function is called for each cursor in the AST traversal. It checks if the cursor is from the
  * main file and if it represents a function or method declaration. If so, it extracts and tokenizes
- * the function text.
+ * the function text. When a DefinitionSet is given, definitions in non-system headers are claimed and
+ * recorded separately, so each is extracted by only one translation unit.
  *
  * @param cursor The current cursor being visited.
  * @param parent The parent cursor of the current cursor.
@@ -49,14 +211,24 @@ void extractAndTokenizeFunctionText(CXCursor cursor, const CXSourceRange& range,
  */
 CXChildVisitResult visitor(CXCursor cursor, CXCursor parent, CXClientData client_data) {
     VisitorData* data = reinterpret_cast<VisitorData*>(client_data);
-    if (clang_Location_isFromMainFile(clang_getCursorLocation(cursor)) == 0)
+    CXSourceLocation location = clang_getCursorLocation(cursor);
+    const bool mainFile = clang_Location_isFromMainFile(location) != 0;
+    if (!mainFile && (data->definitions == nullptr || clang_Location_isInSystemHeader(location)))
         return CXChildVisit_Continue;
 
     CXSourceRange range = clang_getCursorExtent(cursor);
     switch (cursor.kind) {
         case CXCursor_FunctionDecl:
         case CXCursor_CXXMethod: {
-            extractAndTokenizeFunctionText(cursor, range, *(data->sourceLines), data->model, *(data->functionsInfo));
+            if (!mainFile) {
+                extractHeaderFunction(cursor, range, *data);
+                break;
+            }
+            extractAndTokenizeFunctionText(cursor, range, *(data->source), data->tokenizer, *(data->functionsInfo),
+                                           data->cache, data->fileHash);
+            if (data->splitter) {
+                splitIfOversized(cursor, *data, *data->source, *data->functionsInfo);
+            }
             break;
         }
         default:
@@ -5,22 +5,70 @@
 
 #pragma once
 #include "FunctionalInfo.h"
+#include "SourceBuffer.h"
+#include "Tokenizer.h"
 #include <clang-c/Index.h>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 #include <string>
-#include "common/common.h"
 
 /**
- * @brief Extracts and tokenizes the function text using the provided cursor, range, source lines, llama model, and functions information.
+ * @brief The headers mapped while visiting one translation unit, each opened and hashed once.
+ */
+class HeaderSources {
+public:
+    /**
+     * @brief Returns a mapped header, opening it on first use.
+     * @param path The path of the header.
+     * @param fileHash Receives the content hash of the header.
+     * @return The header, or nullptr if it could not be opened.
+     */
+    const SourceBuffer* get(const std::string& path, uint64_t& fileHash);
+
+private:
+    struct Entry {
+        SourceBuffer source;
+        uint64_t hash = 0;
+        bool valid = false;
+    };
+
+    std::unordered_map<std::string, std::unique_ptr<Entry>> entries_;
+};
+
+/**
+ * @brief Records a function found in a source file and counts its tokens.
+ * @param filePath The path of the file the function is defined in.
+ * @param signature The spelling of the function name.
+ * @param startLine The 1-based line of the first character of the function.
+ * @param endLine The 1-based line of the last character of the function.
+ * @param startOffset The byte offset of the first character of the function.
+ * @param endOffset The byte offset one past the last character of the function.
+ * @param source The mapped source file the offsets refer to.
+ * @param tokenizer The tokenizer used to count the function tokens, or nullptr to leave the count at 0.
+ * @param functionsInfo The vector of FunctionInfo structures.
+ * @param cache The cache of token counts, or nullptr to always tokenize.
+ * @param fileHash The content hash of the file, used in the cache key.
+ *
+ * This is shared by the AST visitor and the lexical extractor so that both produce identical records.
+ */
+void appendFunctionInfo(std::string filePath, std::string signature, int startLine, int endLine, unsigned startOffset,
+                        unsigned endOffset, const SourceBuffer& source, const Tokenizer* tokenizer,
+                        std::vector<FunctionInfo>& functionsInfo, const FunctionCache* cache, uint64_t fileHash);
+
+/**
+ * @brief Extracts and tokenizes the function text using the provided cursor, range, source buffer, tokenizer, and functions information.
  * @param cursor The Clang cursor representing the function.
  * @param range The source range of the function.
- * @param sourceLines The vector of source lines.
- * @param model The llama model.
+ * @param source The mapped source file the range refers to.
+ * @param tokenizer The tokenizer used to count the function tokens, or nullptr to leave the count at 0.
  * @param functionsInfo The vector of FunctionInfo structures.
+ * @param cache The cache of token counts, or nullptr to always tokenize.
+ * @param fileHash The content hash of the file, used in the cache key.
  *
  * This function is used to extract the function text from the given cursor and range, tokenize it, and store the information in the provided vectors.
  */
-void extractAndTokenizeFunctionText(CXCursor cursor, const CXSourceRange& range, const std::vector<std::string>& sourceLines, llama_model* model, std::vector<FunctionInfo>& functionsInfo);
+void extractAndTokenizeFunctionText(CXCursor cursor, const CXSourceRange& range, const SourceBuffer& source, const Tokenizer* tokenizer, std::vector<FunctionInfo>& functionsInfo, const FunctionCache* cache = nullptr, uint64_t fileHash = 0);
 
 /**
  * @brief The visitor function that is called by the Clang library during the traversal of the AST.
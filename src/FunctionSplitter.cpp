@@ -0,0 +1,139 @@
+/**
+ * @file FunctionSplitter.cpp
+ * @brief This file contains the implementation of the FunctionSplitter.
+ */
+
+#include "FunctionSplitter.h"
+#include "FunctionExtractor.h"
+#include "SourceBuffer.h"
+#include "Tokenizer.h"
+#include "Trace.h"
+#include <algorithm>
+
+namespace {
+
+/**
+ * @brief A run of the function text between two consecutive cuts.
+ */
+struct Segment {
+    unsigned begin;
+    unsigned end;
+    int tokens;
+};
+
+/**
+ * @brief Moves a cut back over the indentation in front of it, so that fragments start at the beginning of a line.
+ */
+unsigned snapToLineStart(std::string_view text, unsigned offset, unsigned floor) {
+    unsigned begin = offset;
+    while (begin > floor && (text[begin - 1] == ' ' || text[begin - 1] == '\t')) {
+        --begin;
+    }
+    return begin > floor && text[begin - 1] == '\n' ? begin : offset;
+}
+
+} // namespace
+
+/**
+ * @brief Returns whether a function must be split.
+ *
+ * A function with no more bytes than the limit cannot have more tokens, so it is accepted without tokenizing.
+ *
+ * @param info The function, whose token count is used if it was already counted.
+ * @param source The mapped source file of the function.
+ */
+bool FunctionSplitter::oversized(const FunctionInfo& info, const SourceBuffer& source) const {
+    if (!enabled() || info.endOffset - info.startOffset <= static_cast<unsigned>(params_.maxTokens)) {
+        return false;
+    }
+    if (info.tokenCount > 0) {
+        return info.tokenCount > params_.maxTokens;
+    }
+    return tokenizer_.count(source.slice(info.startOffset, info.endOffset)) > params_.maxTokens;
+}
+
+/**
+ * @brief Replaces the last function of a list with its fragments.
+ *
+ * The text between consecutive cuts forms the segments. Segments above the limit are cut again at every line,
+ * then fragments are filled with whole segments up to the limit. Each fragment after the first starts with the
+ * trailing segments of its predecessor that fit in the overlap, as long as the new segment still fits.
+ *
+ * @param cuts Byte offsets inside the function where a fragment may start, in any order.
+ * @param source The mapped source file of the function.
+ * @param tokenizer The tokenizer used to count the fragment tokens, or nullptr to leave the counts at 0.
+ * @param cache The cache of token counts, or nullptr.
+ * @param functionsInfo The list whose last element is split.
+ */
+void FunctionSplitter::split(std::vector<unsigned> cuts, const SourceBuffer& source, const Tokenizer* tokenizer,
+                             const FunctionCache* cache, std::vector<FunctionInfo>& functionsInfo) const {
+    TRACE_SCOPE("split");
+    const FunctionInfo whole = std::move(functionsInfo.back());
+    functionsInfo.pop_back();
+
+    const std::string_view text = source.text();
+    for (unsigned& cut : cuts) {
+        cut = snapToLineStart(text, cut, whole.startOffset);
+    }
+    cuts.push_back(whole.startOffset);
+    cuts.erase(std::remove_if(cuts.begin(), cuts.end(),
+                              [&](unsigned cut) { return cut < whole.startOffset || cut >= whole.endOffset; }),
+               cuts.end());
+    std::sort(cuts.begin(), cuts.end());
+    cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+
+    auto count = [&](unsigned begin, unsigned end) { return tokenizer_.count(source.slice(begin, end)); };
+
+    std::vector<Segment> segments;
+    for (size_t i = 0; i < cuts.size(); ++i) {
+        const unsigned begin = cuts[i];
+        const unsigned end = i + 1 < cuts.size() ? cuts[i + 1] : whole.endOffset;
+        const int segmentTokens = count(begin, end);
+        if (segmentTokens <= params_.maxTokens) {
+            segments.push_back({begin, end, segmentTokens});
+            continue;
+        }
+        // No statement boundary inside, e.g. a large initializer table: fall back to lines
+        unsigned lineBegin = begin;
+        for (unsigned p = begin; p < end; ++p) {
+            if (text[p] == '\n' && p + 1 < end) {
+                segments.push_back({lineBegin, p + 1, count(lineBegin, p + 1)});
+                lineBegin = p + 1;
+            }
+        }
+        segments.push_back({lineBegin, end, count(lineBegin, end)});
+    }
+    if (segments.size() == 1) {
+        functionsInfo.push_back(whole);
+        return;
+    }
+
+    const int overlap = std::min(params_.overlapTokens, params_.maxTokens / 2);
+    int fragment = 0;
+    for (size_t first = 0; first < segments.size();) {
+        size_t last = first;
+        int total = 0;
+        while (last < segments.size() && (last == first || total + segments[last].tokens <= params_.maxTokens)) {
+            total += segments[last++].tokens;
+        }
+
+        const unsigned begin = segments[first].begin;
+        const unsigned end = segments[last - 1].end;
+        appendFunctionInfo(whole.filePath, whole.signature, static_cast<int>(source.lineOf(begin)),
+                           static_cast<int>(source.lineOf(end - 1)), begin, end, source, tokenizer, functionsInfo,
+                           cache, whole.fileHash);
+        functionsInfo.back().parentHash = whole.extentHash;
+        functionsInfo.back().fragment = fragment++;
+
+        if (last == segments.size()) {
+            break;
+        }
+        size_t next = last;
+        int shared = 0;
+        while (next > first + 1 && shared + segments[next - 1].tokens <= overlap &&
+               shared + segments[next - 1].tokens + segments[last].tokens <= params_.maxTokens) {
+            shared += segments[--next].tokens;
+        }
+        first = next;
+    }
+}
@@ -0,0 +1,71 @@
+/**
+ * @file FunctionSplitter.h
+ * @brief This file contains the declaration of the FunctionSplitter, which breaks oversized functions into fragments.
+ *
+ * A function whose token count exceeds the limit is cut at statement boundaries, supplied by the caller from the
+ * libclang cursors of the function body, and the resulting segments are grouped greedily into fragments of at most
+ * the limit. Consecutive fragments share a configurable number of overlap tokens so that a statement split from its
+ * context still carries some of it. A segment that is still too large is cut at line boundaries instead.
+ *
+ * Every fragment is an ordinary FunctionInfo with its own extent, so the packer, the cache and the index handle
+ * it like any other function; parentHash and fragment link it back to the function it came from.
+ */
+
+#pragma once
+#include "FunctionalInfo.h"
+#include <vector>
+
+/**
+ * @brief Parameters of the FunctionSplitter.
+ */
+struct SplitParams {
+    int maxTokens = 0;     ///< Largest function kept whole, 0 disables splitting.
+    int overlapTokens = 0; ///< Tokens repeated at the start of each fragment after the first.
+};
+
+/**
+ * @brief Splits functions larger than a token limit into linked fragments.
+ *
+ * The splitter only reads the shared tokenizer, so one instance can be used by every extraction thread.
+ */
+class FunctionSplitter {
+public:
+    /**
+     * @brief Creates a splitter.
+     * @param tokenizer The tokenizer used to measure functions and their segments.
+     * @param params The size limit and overlap of the fragments.
+     */
+    FunctionSplitter(const Tokenizer& tokenizer, const SplitParams& params) : tokenizer_(tokenizer), params_(params) {}
+
+    /**
+     * @brief Returns whether splitting is enabled.
+     */
+    bool enabled() const { return params_.maxTokens > 0; }
+
+    /**
+     * @brief Returns the largest function kept whole.
+     */
+    int maxTokens() const { return params_.maxTokens; }
+
+    /**
+     * @brief Returns whether a function must be split.
+     * @param info The function, whose token count is used if it was already counted.
+     * @param source The mapped source file of the function.
+     */
+    bool oversized(const FunctionInfo& info, const SourceBuffer& source) const;
+
+    /**
+     * @brief Replaces the last function of a list with its fragments.
+     * @param cuts Byte offsets inside the function where a fragment may start, in any order.
+     * @param source The mapped source file of the function.
+     * @param tokenizer The tokenizer used to count the fragment tokens, or nullptr to leave the counts at 0.
+     * @param cache The cache of token counts, or nullptr.
+     * @param functionsInfo The list whose last element is split.
+     */
+    void split(std::vector<unsigned> cuts, const SourceBuffer& source, const Tokenizer* tokenizer,
+               const FunctionCache* cache, std::vector<FunctionInfo>& functionsInfo) const;
+
+private:
+    const Tokenizer& tokenizer_;
+    SplitParams params_;
+};
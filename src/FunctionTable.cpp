@@ -0,0 +1,141 @@
+/**
+ * @file FunctionTable.cpp
+ * @brief This file contains the implementation of the FunctionTable and its StringArena.
+ */
+
+#include "FunctionTable.h"
+#include <cstring>
+#include <numeric>
+
+/**
+ * @brief Returns the id of a string, copying it into the arena the first time it is seen.
+ *
+ * Strings are packed back to back in 1 MiB blocks; a string larger than a block gets a block of its own. The
+ * lookup map is keyed by views into the blocks, which never move.
+ *
+ * @param text The string.
+ * @return The id of the string.
+ */
+uint32_t StringArena::intern(std::string_view text) {
+    auto it = ids_.find(text);
+    if (it != ids_.end()) {
+        return it->second;
+    }
+
+    // The empty string needs no storage, and may be interned before any block exists
+    const char* storage = "";
+    if (text.size() > kBlockSize) {
+        blocks_.push_back(std::make_unique<char[]>(text.size()));
+        std::memcpy(blocks_.back().get(), text.data(), text.size());
+        storage = blocks_.back().get();
+        blockUsed_ = kBlockSize;
+    } else if (!text.empty()) {
+        if (blocks_.empty() || blockUsed_ + text.size() > kBlockSize) {
+            blocks_.push_back(std::make_unique<char[]>(kBlockSize));
+            blockUsed_ = 0;
+        }
+        char* block = blocks_.back().get() + blockUsed_;
+        std::memcpy(block, text.data(), text.size());
+        storage = block;
+        blockUsed_ += text.size();
+    }
+
+    const auto id = static_cast<uint32_t>(strings_.size());
+    strings_.emplace_back(storage, text.size());
+    ids_.emplace(strings_.back(), id);
+    return id;
+}
+
+/**
+ * @brief Frees every string.
+ */
+void StringArena::clear() {
+    ids_.clear();
+    strings_.clear();
+    blocks_.clear();
+    blockUsed_ = kBlockSize;
+}
+
+/**
+ * @brief Reserves room for a number of rows in every column.
+ * @param rows The number of rows.
+ */
+void FunctionTable::reserve(size_t rows) {
+    filePaths_.reserve(rows);
+    signatures_.reserve(rows);
+    startLines_.reserve(rows);
+    endLines_.reserve(rows);
+    tokenCounts_.reserve(rows);
+    startOffsets_.reserve(rows);
+    endOffsets_.reserve(rows);
+    fileHashes_.reserve(rows);
+    extentHashes_.reserve(rows);
+    parentHashes_.reserve(rows);
+    fragments_.reserve(rows);
+}
+
+/**
+ * @brief Appends one record.
+ * @param info The record; its strings are interned, nothing else is kept.
+ */
+void FunctionTable::append(const FunctionInfo& info) {
+    filePaths_.push_back(strings_.intern(info.filePath));
+    signatures_.push_back(strings_.intern(info.signature));
+    startLines_.push_back(info.startLine);
+    endLines_.push_back(info.endLine);
+    tokenCounts_.push_back(info.tokenCount);
+    startOffsets_.push_back(info.startOffset);
+    endOffsets_.push_back(info.endOffset);
+    fileHashes_.push_back(info.fileHash);
+    extentHashes_.push_back(info.extentHash);
+    parentHashes_.push_back(info.parentHash);
+    fragments_.push_back(info.fragment);
+}
+
+/**
+ * @brief Appends a list of records, in order.
+ * @param infos The records.
+ */
+void FunctionTable::append(const std::vector<FunctionInfo>& infos) {
+    for (const FunctionInfo& info : infos) {
+        append(info);
+    }
+}
+
+/**
+ * @brief Removes every row and string.
+ */
+void FunctionTable::clear() {
+    strings_.clear();
+    filePaths_.clear();
+    signatures_.clear();
+    startLines_.clear();
+    endLines_.clear();
+    tokenCounts_.clear();
+    startOffsets_.clear();
+    endOffsets_.clear();
+    fileHashes_.clear();
+    extentHashes_.clear();
+    parentHashes_.clear();
+    fragments_.clear();
+}
+
+/**
+ * @brief Materializes one row as a FunctionInfo.
+ * @param i The row index.
+ * @return A copy of the row.
+ */
+FunctionInfo FunctionTable::row(size_t i) const {
+    FunctionInfo info{std::string(filePath(i)), std::string(signature(i)), startLines_[i], endLines_[i],
+                      tokenCounts_[i], startOffsets_[i], endOffsets_[i], fileHashes_[i], extentHashes_[i]};
+    info.parentHash = parentHashes_[i];
+    info.fragment = fragments_[i];
+    return info;
+}
+
+/**
+ * @brief Returns the sum of the token count column.
+ */
+int64_t FunctionTable::totalTokens() const {
+    return std::accumulate(tokenCounts_.begin(), tokenCounts_.end(), int64_t{0});
+}
@@ -0,0 +1,142 @@
+/**
+ * @file FunctionTable.h
+ * @brief This file contains the declaration of the FunctionTable, the columnar store of all extracted functions.
+ *
+ * FunctionInfo is the per-file record produced while a file is being visited. Once a file is done its records are
+ * appended to a FunctionTable, which keeps every field in its own contiguous column and stores file paths and
+ * signatures once each in a StringArena. A row costs a fixed 56 bytes with no allocation of its own, and passes
+ * that only need one field, such as packing over token counts, stream through a single array.
+ */
+
+#pragma once
+#include "FunctionalInfo.h"
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Interns strings into large append-only blocks and hands out dense 32-bit ids.
+ */
+class StringArena {
+public:
+    StringArena() = default;
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+    StringArena(StringArena&&) = default;
+    StringArena& operator=(StringArena&&) = default;
+
+    /**
+     * @brief Returns the id of a string, copying it into the arena the first time it is seen.
+     * @param text The string.
+     * @return The id, in first-seen order starting at 0.
+     */
+    uint32_t intern(std::string_view text);
+
+    /**
+     * @brief Returns the string of an id. The view stays valid for the lifetime of the arena.
+     * @param id An id returned by intern().
+     */
+    std::string_view get(uint32_t id) const { return strings_[id]; }
+
+    /**
+     * @brief Returns the number of distinct strings.
+     */
+    size_t size() const { return strings_.size(); }
+
+    /**
+     * @brief Frees every string.
+     */
+    void clear();
+
+private:
+    static constexpr size_t kBlockSize = 1 << 20;
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    size_t blockUsed_ = kBlockSize;
+    std::vector<std::string_view> strings_;
+    std::unordered_map<std::string_view, uint32_t> ids_;
+};
+
+/**
+ * @brief Columnar, arena-backed store of function records.
+ *
+ * Rows are addressed by their index in append order. Individual fields are read through the accessors; row()
+ * materializes a FunctionInfo for the rare caller that needs the whole record.
+ */
+class FunctionTable {
+public:
+    FunctionTable() = default;
+    FunctionTable(const FunctionTable&) = delete;
+    FunctionTable& operator=(const FunctionTable&) = delete;
+    FunctionTable(FunctionTable&&) = default;
+    FunctionTable& operator=(FunctionTable&&) = default;
+
+    /**
+     * @brief Reserves room for a number of rows in every column.
+     */
+    void reserve(size_t rows);
+
+    /**
+     * @brief Appends one record.
+     */
+    void append(const FunctionInfo& info);
+
+    /**
+     * @brief Appends a list of records, in order.
+     */
+    void append(const std::vector<FunctionInfo>& infos);
+
+    /**
+     * @brief Removes every row and string.
+     */
+    void clear();
+
+    size_t size() const { return tokenCounts_.size(); }
+    bool empty() const { return tokenCounts_.empty(); }
+
+    /**
+     * @brief Materializes one row as a FunctionInfo.
+     */
+    FunctionInfo row(size_t i) const;
+
+    std::string_view filePath(size_t i) const { return strings_.get(filePaths_[i]); }
+    std::string_view signature(size_t i) const { return strings_.get(signatures_[i]); }
+    uint32_t fileId(size_t i) const { return filePaths_[i]; } ///< Equal for rows of the same file.
+    int startLine(size_t i) const { return startLines_[i]; }
+    int endLine(size_t i) const { return endLines_[i]; }
+    int tokenCount(size_t i) const { return tokenCounts_[i]; }
+    unsigned startOffset(size_t i) const { return startOffsets_[i]; }
+    unsigned endOffset(size_t i) const { return endOffsets_[i]; }
+    uint64_t fileHash(size_t i) const { return fileHashes_[i]; }
+    uint64_t extentHash(size_t i) const { return extentHashes_[i]; }
+    uint64_t parentHash(size_t i) const { return parentHashes_[i]; }
+    int fragment(size_t i) const { return fragments_[i]; }
+
+    void setTokenCount(size_t i, int tokens) { tokenCounts_[i] = tokens; }
+
+    /**
+     * @brief Returns the token count column.
+     */
+    const std::vector<int>& tokenCounts() const { return tokenCounts_; }
+
+    /**
+     * @brief Returns the sum of the token count column.
+     */
+    int64_t totalTokens() const;
+
+private:
+    StringArena strings_;
+    std::vector<uint32_t> filePaths_;
+    std::vector<uint32_t> signatures_;
+    std::vector<int> startLines_;
+    std::vector<int> endLines_;
+    std::vector<int> tokenCounts_;
+    std::vector<unsigned> startOffsets_;
+    std::vector<unsigned> endOffsets_;
+    std::vector<uint64_t> fileHashes_;
+    std::vector<uint64_t> extentHashes_;
+    std::vector<uint64_t> parentHashes_;
+    std::vector<int> fragments_;
+};
@@ -4,7 +4,7 @@
  */
 
 #pragma once
-#include "llama.h"
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -12,17 +12,37 @@
  * @brief Structure to hold information about a function.
  */
 struct FunctionInfo {
+    std::string filePath;
     std::string signature;
     int startLine;
     int endLine;
     int tokenCount;
+    unsigned startOffset; ///< Byte offset of the first character of the function in its file.
+    unsigned endOffset;   ///< Byte offset one past the last character of the function.
+    uint64_t fileHash;    ///< Content hash of the file, part of the cache key.
+    uint64_t extentHash;  ///< Hash of the function extent and text, part of the cache key.
+    uint64_t parentHash = 0; ///< extentHash of the function this is a fragment of, 0 for a whole function.
+    int fragment = -1;       ///< 0-based position among the fragments of the parent, -1 for a whole function.
 };
 
+class DefinitionSet;
+class FunctionCache;
+class FunctionSplitter;
+class HeaderSources;
+class SourceBuffer;
+class Tokenizer;
+
 /**
  * @brief Structure to hold data used by the visitor during the parsing process.
  */
 struct VisitorData {
-    llama_model *model;
-    std::vector<std::string> *sourceLines;
+    const Tokenizer *tokenizer;
+    const SourceBuffer *source;
     std::vector<FunctionInfo> *functionsInfo;
+    const FunctionCache *cache; ///< Optional, nullptr disables caching.
+    uint64_t fileHash;          ///< Content hash of the file being visited.
+    const FunctionSplitter *splitter; ///< Optional, nullptr keeps oversized functions whole.
+    DefinitionSet *definitions = nullptr; ///< Optional; when set, definitions in non-system headers are recorded too.
+    std::vector<FunctionInfo> *headerFunctionsInfo = nullptr; ///< Receives the header functions this unit claimed.
+    HeaderSources *headers = nullptr; ///< The headers mapped while visiting this unit.
 };
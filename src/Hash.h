@@ -0,0 +1,73 @@
+/**
+ * @file Hash.h
+ * @brief This file contains small, stable 64-bit hashing helpers.
+ *
+ * The hashes are used as on-disk cache keys and shard assignments, so they must give the same result on
+ * every run and every machine. They are not cryptographic.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+/**
+ * @brief Final avalanche step of MurmurHash3, used to mix a 64-bit state.
+ * @param h The value to mix.
+ * @return The mixed value.
+ */
+inline uint64_t hashMix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * @brief Hashes a byte range, eight bytes at a time.
+ * @param data The bytes to hash.
+ * @param size The number of bytes.
+ * @param seed The seed, which selects an independent hash function.
+ * @return The 64-bit hash.
+ */
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0) {
+    const auto* p = static_cast<const unsigned char*>(data);
+    uint64_t h = hashMix(seed ^ (size * 0x9e3779b97f4a7c15ULL));
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, p + i, 8);
+        h = (h ^ hashMix(word)) * 0x9e3779b97f4a7c15ULL;
+    }
+
+    uint64_t tail = 0;
+    for (size_t shift = 0; i < size; ++i, shift += 8) {
+        tail |= static_cast<uint64_t>(p[i]) << shift;
+    }
+    h = (h ^ hashMix(tail)) * 0x9e3779b97f4a7c15ULL;
+    return hashMix(h);
+}
+
+/**
+ * @brief Hashes a string.
+ * @param text The string to hash.
+ * @param seed The seed, which selects an independent hash function.
+ * @return The 64-bit hash.
+ */
+inline uint64_t hashString(std::string_view text, uint64_t seed = 0) {
+    return hashBytes(text.data(), text.size(), seed);
+}
+
+/**
+ * @brief Combines a value into a running hash.
+ * @param seed The running hash.
+ * @param value The value to combine.
+ * @return The combined hash.
+ */
+inline uint64_t hashCombine(uint64_t seed, uint64_t value) {
+    return hashMix(seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+}
@@ -0,0 +1,502 @@
+/**
+ * @file HnswIndex.cpp
+ * @brief This file contains the implementation of the HNSW approximate nearest-neighbor index.
+ */
+
+#include "HnswIndex.h"
+#include "Hash.h"
+#include "Trace.h"
+#include "VectorKernels.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <queue>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char kHnswMagic[8] = {'C', 'C', 'H', 'N', 'S', 'W', '0', '1'};
+constexpr int kMaxLevel = 16;
+constexpr size_t kMaxLockStripes = 1 << 16;
+
+struct WorstFirst {
+    bool operator()(const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) const {
+        return a.first > b.first;
+    }
+};
+
+/**
+ * @brief Per-thread visited set that is cleared in O(1) by bumping an epoch.
+ */
+class VisitedSet {
+public:
+    void reset(size_t size) {
+        if (tags_.size() < size) {
+            tags_.assign(size, 0);
+            epoch_ = 0;
+        }
+        if (++epoch_ == 0) {
+            std::fill(tags_.begin(), tags_.end(), 0);
+            epoch_ = 1;
+        }
+    }
+
+    bool insert(uint32_t id) {
+        if (tags_[id] == epoch_) {
+            return false;
+        }
+        tags_[id] = epoch_;
+        return true;
+    }
+
+private:
+    std::vector<uint32_t> tags_;
+    uint32_t epoch_ = 0;
+};
+
+unsigned resolveThreads(unsigned numThreads, size_t work) {
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(numThreads, work)));
+}
+
+template <typename Fn>
+void parallelFor(size_t begin, size_t end, unsigned numThreads, Fn fn) {
+    std::atomic<size_t> next{begin};
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&]() {
+            for (size_t i = next++; i < end; i = next++) {
+                fn(i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Creates an empty index.
+ * @param dimension The number of dimensions of every vector.
+ * @param params The graph parameters.
+ */
+HnswIndex::HnswIndex(size_t dimension, const HnswParams& params)
+    : dimension_(dimension), params_(params), locks_(1) {
+    params_.M = std::max<size_t>(params_.M, 2);
+}
+
+float HnswIndex::similarity(const float* query, uint32_t id) const {
+    return dotProduct(query, vector(id), dimension_);
+}
+
+/**
+ * @brief Draws the top layer of a node from an exponential distribution, deterministically from its id.
+ */
+int HnswIndex::randomLevel(uint32_t id) const {
+    const double mL = 1.0 / std::log(static_cast<double>(params_.M));
+    const double u = (static_cast<double>(hashMix(params_.seed ^ (id + 1)) >> 11) + 1.0) * 0x1.0p-53;
+    return std::min(kMaxLevel, static_cast<int>(-std::log(u) * mL));
+}
+
+uint32_t* HnswIndex::neighbors(uint32_t id, int level) {
+    if (level == 0) {
+        return level0_.data() + static_cast<size_t>(id) * (2 * params_.M + 1);
+    }
+    return upperLevels_[id].data() + static_cast<size_t>(level - 1) * (params_.M + 1);
+}
+
+const uint32_t* HnswIndex::neighbors(uint32_t id, int level) const {
+    return const_cast<HnswIndex*>(this)->neighbors(id, level);
+}
+
+/**
+ * @brief Walks greedily towards the query on the layers fromLevel down to toLevel.
+ * @return The closest node found on toLevel.
+ */
+uint32_t HnswIndex::greedyClosest(const float* query, uint32_t entry, int fromLevel, int toLevel, bool locked) const {
+    uint32_t current = entry;
+    float currentSimilarity = similarity(query, current);
+    std::vector<uint32_t> list;
+
+    for (int level = fromLevel; level >= toLevel; --level) {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            {
+                std::unique_lock<std::mutex> lock(nodeLock(current), std::defer_lock);
+                if (locked) {
+                    lock.lock();
+                }
+                const uint32_t* adjacency = neighbors(current, level);
+                list.assign(adjacency + 1, adjacency + 1 + adjacency[0]);
+            }
+            for (uint32_t candidate : list) {
+                const float s = similarity(query, candidate);
+                if (s > currentSimilarity) {
+                    currentSimilarity = s;
+                    current = candidate;
+                    changed = true;
+                }
+            }
+        }
+    }
+    return current;
+}
+
+/**
+ * @brief Best-first search on one layer.
+ * @return Up to ef candidates, most similar first.
+ */
+std::vector<HnswIndex::Candidate> HnswIndex::searchLayer(const float* query, uint32_t entry, size_t ef, int level,
+                                                          bool locked) const {
+    thread_local VisitedSet visited;
+    visited.reset(count_);
+
+    std::priority_queue<Candidate> frontier; // best first
+    std::priority_queue<Candidate, std::vector<Candidate>, WorstFirst> results;
+
+    const float entrySimilarity = similarity(query, entry);
+    visited.insert(entry);
+    frontier.push({entrySimilarity, entry});
+    results.push({entrySimilarity, entry});
+
+    std::vector<uint32_t> list;
+    while (!frontier.empty()) {
+        const Candidate current = frontier.top();
+        if (results.size() >= ef && current.first < results.top().first) {
+            break;
+        }
+        frontier.pop();
+
+        {
+            std::unique_lock<std::mutex> lock(nodeLock(current.second), std::defer_lock);
+            if (locked) {
+                lock.lock();
+            }
+            const uint32_t* adjacency = neighbors(current.second, level);
+            list.assign(adjacency + 1, adjacency + 1 + adjacency[0]);
+        }
+
+        for (uint32_t neighbor : list) {
+            if (!visited.insert(neighbor)) {
+                continue;
+            }
+            const float s = similarity(query, neighbor);
+            if (results.size() < ef || s > results.top().first) {
+                frontier.push({s, neighbor});
+                results.push({s, neighbor});
+                if (results.size() > ef) {
+                    results.pop();
+                }
+            }
+        }
+    }
+
+    std::vector<Candidate> sorted(results.size());
+    for (size_t i = sorted.size(); i-- > 0;) {
+        sorted[i] = results.top();
+        results.pop();
+    }
+    return sorted;
+}
+
+/**
+ * @brief Neighbor selection heuristic: keep a candidate only if it is more similar to the base node than to
+ * every neighbor already kept, which spreads the edges over different directions.
+ */
+std::vector<uint32_t> HnswIndex::selectNeighbors(std::vector<Candidate> candidates, size_t limit) const {
+    std::sort(candidates.begin(), candidates.end(), std::greater<>());
+
+    std::vector<uint32_t> selected;
+    for (const Candidate& candidate : candidates) {
+        if (selected.size() >= limit) {
+            break;
+        }
+        bool keep = true;
+        for (uint32_t kept : selected) {
+            if (dotProduct(vector(candidate.second), vector(kept), dimension_) > candidate.first) {
+                keep = false;
+                break;
+            }
+        }
+        if (keep) {
+            selected.push_back(candidate.second);
+        }
+    }
+    return selected;
+}
+
+/**
+ * @brief Adds a reverse edge from neighbor to id, pruning neighbor's list if it is full.
+ */
+void HnswIndex::connect(uint32_t neighbor, uint32_t id, int level) {
+    std::lock_guard<std::mutex> lock(nodeLock(neighbor));
+    uint32_t* adjacency = neighbors(neighbor, level);
+    const size_t limit = maxNeighbors(level);
+
+    if (adjacency[0] < limit) {
+        adjacency[1 + adjacency[0]++] = id;
+        return;
+    }
+
+    std::vector<Candidate> candidates;
+    candidates.reserve(limit + 1);
+    const float* base = vector(neighbor);
+    for (uint32_t i = 0; i < adjacency[0]; ++i) {
+        candidates.push_back({similarity(base, adjacency[1 + i]), adjacency[1 + i]});
+    }
+    candidates.push_back({similarity(base, id), id});
+
+    std::vector<uint32_t> selected = selectNeighbors(std::move(candidates), limit);
+    adjacency[0] = static_cast<uint32_t>(selected.size());
+    std::copy(selected.begin(), selected.end(), adjacency + 1);
+}
+
+/**
+ * @brief Inserts one node whose storage has already been allocated.
+ */
+void HnswIndex::insert(uint32_t id) {
+    const int level = levels_[id];
+    const float* query = vector(id);
+
+    uint32_t entry;
+    int topLevel;
+    {
+        std::lock_guard<std::mutex> lock(entryMutex_);
+        if (maxLevel_ < 0) {
+            entryPoint_ = id;
+            maxLevel_ = level;
+            return;
+        }
+        entry = entryPoint_;
+        topLevel = maxLevel_;
+    }
+
+    if (topLevel > level) {
+        entry = greedyClosest(query, entry, topLevel, level + 1, true);
+    }
+
+    for (int l = std::min(level, topLevel); l >= 0; --l) {
+        std::vector<Candidate> candidates = searchLayer(query, entry, params_.efConstruction, l, true);
+        entry = candidates.front().second;
+
+        std::vector<uint32_t> selected = selectNeighbors(candidates, params_.M);
+        {
+            std::lock_guard<std::mutex> lock(nodeLock(id));
+            uint32_t* adjacency = neighbors(id, l);
+            adjacency[0] = static_cast<uint32_t>(selected.size());
+            std::copy(selected.begin(), selected.end(), adjacency + 1);
+        }
+        for (uint32_t neighbor : selected) {
+            connect(neighbor, id, l);
+        }
+    }
+
+    if (level > topLevel) {
+        std::lock_guard<std::mutex> lock(entryMutex_);
+        if (level > maxLevel_) {
+            entryPoint_ = id;
+            maxLevel_ = level;
+        }
+    }
+}
+
+/**
+ * @brief Builds the graph over a matrix of vectors.
+ *
+ * All adjacency storage is allocated up front so that concurrent insertions only take per-node locks. Node
+ * locks are striped over at most 65536 mutexes; a thread never holds two of them at once.
+ *
+ * @param vectors Row-major matrix of count x dimension normalized floats.
+ * @param count The number of vectors.
+ * @param numThreads The number of insertion threads.
+ */
+void HnswIndex::build(const float* vectors, size_t count, unsigned numThreads) {
+    TRACE_SCOPE("ann_build");
+    vectors_ = vectors;
+    count_ = count;
+    entryPoint_ = 0;
+    maxLevel_ = -1;
+
+    levels_.resize(count);
+    level0_.assign(count * (2 * params_.M + 1), 0);
+    upperLevels_.assign(count, {});
+    for (size_t id = 0; id < count; ++id) {
+        levels_[id] = randomLevel(static_cast<uint32_t>(id));
+        upperLevels_[id].assign(static_cast<size_t>(levels_[id]) * (params_.M + 1), 0);
+    }
+    locks_ = std::vector<std::mutex>(std::max<size_t>(1, std::min(count, kMaxLockStripes)));
+
+    if (count == 0) {
+        return;
+    }
+
+    insert(0);
+    parallelFor(1, count, resolveThreads(numThreads, count), [this](size_t id) { insert(static_cast<uint32_t>(id)); });
+}
+
+/**
+ * @brief Finds the approximate k most similar vectors to a query.
+ * @param query The normalized query vector.
+ * @param k The number of results.
+ * @param ef The candidate list size, 0 uses params().efSearch.
+ * @return Up to k results, most similar first.
+ */
+std::vector<SearchResult> HnswIndex::search(const float* query, size_t k, size_t ef) const {
+    std::vector<SearchResult> hits;
+    if (count_ == 0 || maxLevel_ < 0 || k == 0) {
+        return hits;
+    }
+
+    ef = std::max(ef ? ef : params_.efSearch, k);
+    const uint32_t entry = greedyClosest(query, entryPoint_, maxLevel_, 1, false);
+    std::vector<Candidate> candidates = searchLayer(query, entry, ef, 0, false);
+
+    const size_t n = std::min(k, candidates.size());
+    hits.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        hits.push_back({candidates[i].first, candidates[i].second});
+    }
+    return hits;
+}
+
+/**
+ * @brief Runs many queries in parallel.
+ */
+void HnswIndex::searchBatch(const float* queries, size_t count, size_t k, std::vector<std::vector<SearchResult>>& results,
+                            unsigned numThreads, size_t ef) const {
+    results.resize(count);
+    parallelFor(0, count, resolveThreads(numThreads, count),
+                [&](size_t i) { results[i] = search(queries + i * dimension_, k, ef); });
+}
+
+/**
+ * @brief Writes the graph to a file. The vectors are not written.
+ * @param path The output path.
+ * @return True on success.
+ */
+bool HnswIndex::save(const fs::path& path) const {
+    fs::path tempPath = path;
+    tempPath += ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+
+    const uint64_t fields[] = {dimension_, count_, params_.M, params_.efConstruction, params_.efSearch, params_.seed,
+                               entryPoint_, static_cast<uint64_t>(static_cast<int64_t>(maxLevel_))};
+    out.write(kHnswMagic, sizeof(kHnswMagic));
+    out.write(reinterpret_cast<const char*>(fields), sizeof(fields));
+    out.write(reinterpret_cast<const char*>(levels_.data()), static_cast<std::streamsize>(levels_.size() * sizeof(int)));
+    out.write(reinterpret_cast<const char*>(level0_.data()),
+              static_cast<std::streamsize>(level0_.size() * sizeof(uint32_t)));
+    for (const auto& upper : upperLevels_) {
+        out.write(reinterpret_cast<const char*>(upper.data()), static_cast<std::streamsize>(upper.size() * sizeof(uint32_t)));
+    }
+    out.close();
+
+    std::error_code ec;
+    if (!out) {
+        fs::remove(tempPath, ec);
+        return false;
+    }
+    fs::rename(tempPath, path, ec);
+    return !ec;
+}
+
+/**
+ * @brief Reads a graph written by save() and attaches it to a matrix of vectors.
+ * @param path The input path.
+ * @param vectors The same matrix the graph was built over.
+ * @param count The number of vectors, which must match the saved graph.
+ * @return True on success. A file that is truncated or references nodes, levels or list sizes outside the graph
+ *         is rejected and leaves the index empty.
+ */
+bool HnswIndex::load(const fs::path& path, const float* vectors, size_t count) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(kHnswMagic)];
+    uint64_t fields[8];
+    std::error_code ec;
+    const uint64_t fileSize = fs::file_size(path, ec);
+    if (ec || !in.read(magic, sizeof(magic)) || std::memcmp(magic, kHnswMagic, sizeof(magic)) != 0 ||
+        !in.read(reinterpret_cast<char*>(fields), sizeof(fields)) || fields[0] != dimension_ || fields[1] != count ||
+        fields[2] < 2 || fields[2] > fileSize || count * (2 * fields[2] + 1) * sizeof(uint32_t) > fileSize) {
+        return false;
+    }
+
+    params_.M = fields[2];
+    params_.efConstruction = fields[3];
+    params_.efSearch = fields[4];
+    params_.seed = fields[5];
+    entryPoint_ = static_cast<uint32_t>(fields[6]);
+    maxLevel_ = static_cast<int>(static_cast<int64_t>(fields[7]));
+    vectors_ = vectors;
+    count_ = count;
+
+    levels_.resize(count);
+    level0_.resize(count * (2 * params_.M + 1));
+    in.read(reinterpret_cast<char*>(levels_.data()), static_cast<std::streamsize>(levels_.size() * sizeof(int)));
+    in.read(reinterpret_cast<char*>(level0_.data()), static_cast<std::streamsize>(level0_.size() * sizeof(uint32_t)));
+    upperLevels_.assign(count, {});
+    for (size_t id = 0; id < count && in; ++id) {
+        if (levels_[id] < 0 || levels_[id] > kMaxLevel) {
+            in.setstate(std::ios::failbit);
+            break;
+        }
+        upperLevels_[id].resize(static_cast<size_t>(levels_[id]) * (params_.M + 1));
+        in.read(reinterpret_cast<char*>(upperLevels_[id].data()),
+                static_cast<std::streamsize>(upperLevels_[id].size() * sizeof(uint32_t)));
+    }
+    locks_ = std::vector<std::mutex>(std::max<size_t>(1, std::min(count, kMaxLockStripes)));
+    if (!in || !validate()) {
+        count_ = 0;
+        maxLevel_ = -1;
+        level0_.clear();
+        upperLevels_.clear();
+        levels_.clear();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Checks that a loaded graph only references nodes and levels that exist.
+ *
+ * Searches follow the stored lists without bounds checks, so the entry point must exist on the top level, every
+ * list must fit its slots, and every neighbor id must be a node.
+ *
+ * @return True if the graph is consistent.
+ */
+bool HnswIndex::validate() const {
+    if (count_ == 0) {
+        return maxLevel_ == -1;
+    }
+    if (entryPoint_ >= count_ || maxLevel_ < 0 || maxLevel_ > kMaxLevel || levels_[entryPoint_] != maxLevel_) {
+        return false;
+    }
+    for (uint32_t id = 0; id < count_; ++id) {
+        if (levels_[id] < 0 || levels_[id] > maxLevel_) {
+            return false;
+        }
+        for (int level = 0; level <= levels_[id]; ++level) {
+            const uint32_t* list = neighbors(id, level);
+            if (list[0] > maxNeighbors(level)) {
+                return false;
+            }
+            for (uint32_t k = 1; k <= list[0]; ++k) {
+                if (list[k] >= count_) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
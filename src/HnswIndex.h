@@ -0,0 +1,132 @@
+/**
+ * @file HnswIndex.h
+ * @brief This file contains the declaration of the HNSW approximate nearest-neighbor index.
+ *
+ * The index implements Hierarchical Navigable Small World graphs (Malkov and Yashunin) over normalized
+ * embeddings, using the inner product as similarity. The vectors themselves are not copied: the index
+ * references a caller-owned row-major matrix, which may live in a memory-mapped index segment.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Tunable parameters of the HNSW graph.
+ */
+struct HnswParams {
+    size_t M = 16;               ///< Neighbors per node on the upper layers; layer 0 keeps 2 * M.
+    size_t efConstruction = 200; ///< Candidate list size while inserting; higher builds a better graph.
+    size_t efSearch = 64;        ///< Candidate list size while searching; higher trades latency for recall.
+    uint64_t seed = 42;          ///< Seed of the level assignment.
+};
+
+/**
+ * @brief One search hit.
+ */
+struct SearchResult {
+    float similarity;
+    uint32_t id;
+};
+
+/**
+ * @brief HNSW graph over a caller-owned matrix of normalized vectors.
+ */
+class HnswIndex {
+public:
+    /**
+     * @brief Creates an empty index.
+     * @param dimension The number of dimensions of every vector.
+     * @param params The graph parameters.
+     */
+    explicit HnswIndex(size_t dimension, const HnswParams& params = {});
+
+    /**
+     * @brief Builds the graph over a matrix of vectors.
+     * @param vectors Row-major matrix of count x dimension normalized floats. It must outlive the index.
+     * @param count The number of vectors.
+     * @param numThreads The number of insertion threads, 0 selects the hardware concurrency.
+     */
+    void build(const float* vectors, size_t count, unsigned numThreads = 0);
+
+    /**
+     * @brief Finds the approximate k most similar vectors to a query.
+     * @param query The normalized query vector.
+     * @param k The number of results.
+     * @param ef The candidate list size, 0 uses params().efSearch. Values below k are raised to k.
+     * @return Up to k results, most similar first.
+     */
+    std::vector<SearchResult> search(const float* query, size_t k, size_t ef = 0) const;
+
+    /**
+     * @brief Runs many queries in parallel.
+     * @param queries Row-major matrix of count x dimension normalized queries.
+     * @param count The number of queries.
+     * @param k The number of results per query.
+     * @param results Receives one result list per query.
+     * @param numThreads The number of query threads, 0 selects the hardware concurrency.
+     * @param ef The candidate list size, 0 uses params().efSearch.
+     */
+    void searchBatch(const float* queries, size_t count, size_t k, std::vector<std::vector<SearchResult>>& results,
+                     unsigned numThreads = 0, size_t ef = 0) const;
+
+    /**
+     * @brief Writes the graph to a file. The vectors are not written.
+     * @param path The output path.
+     * @return True on success.
+     */
+    bool save(const std::filesystem::path& path) const;
+
+    /**
+     * @brief Reads a graph written by save() and attaches it to a matrix of vectors.
+     * @param path The input path.
+     * @param vectors The same matrix the graph was built over.
+     * @param count The number of vectors, which must match the saved graph.
+     * @return True on success. A corrupt file is rejected and leaves the index empty.
+     */
+    bool load(const std::filesystem::path& path, const float* vectors, size_t count);
+
+    void setEfSearch(size_t ef) { params_.efSearch = ef; }
+    const HnswParams& params() const { return params_; }
+    size_t size() const { return count_; }
+    size_t dimension() const { return dimension_; }
+
+private:
+    using Candidate = std::pair<float, uint32_t>; ///< (similarity, id)
+
+    const float* vector(uint32_t id) const { return vectors_ + static_cast<size_t>(id) * dimension_; }
+    float similarity(const float* query, uint32_t id) const;
+    int randomLevel(uint32_t id) const;
+    size_t maxNeighbors(int level) const { return level == 0 ? 2 * params_.M : params_.M; }
+
+    bool validate() const;
+
+    uint32_t* neighbors(uint32_t id, int level);
+    const uint32_t* neighbors(uint32_t id, int level) const;
+    std::mutex& nodeLock(uint32_t id) const { return locks_[id % locks_.size()]; }
+
+    uint32_t greedyClosest(const float* query, uint32_t entry, int fromLevel, int toLevel, bool locked) const;
+    std::vector<Candidate> searchLayer(const float* query, uint32_t entry, size_t ef, int level, bool locked) const;
+    std::vector<uint32_t> selectNeighbors(std::vector<Candidate> candidates, size_t limit) const;
+    void insert(uint32_t id);
+    void connect(uint32_t id, uint32_t neighbor, int level);
+
+    size_t dimension_;
+    HnswParams params_;
+    const float* vectors_ = nullptr;
+    size_t count_ = 0;
+
+    /// Adjacency lists, one per node and level. Slot 0 holds the list size, followed by the neighbor ids.
+    std::vector<uint32_t> level0_;
+    std::vector<std::vector<uint32_t>> upperLevels_;
+    std::vector<int> levels_;
+
+    uint32_t entryPoint_ = 0;
+    int maxLevel_ = -1;
+    mutable std::mutex entryMutex_;
+    mutable std::vector<std::mutex> locks_;
+};
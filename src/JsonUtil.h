@@ -0,0 +1,156 @@
+/**
+ * @file JsonUtil.h
+ * @brief This file contains helpers for reading and writing JSON strings.
+ */
+
+#pragma once
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Writes a string as a quoted, escaped JSON string.
+ * @param out The output stream.
+ * @param text The string to write.
+ */
+inline void writeJsonString(std::ostream& out, std::string_view text) {
+    out << '"';
+    for (char c : text) {
+        switch (c) {
+            case '"':
+                out << "\\\"";
+                break;
+            case '\\':
+                out << "\\\\";
+                break;
+            case '\n':
+                out << "\\n";
+                break;
+            case '\r':
+                out << "\\r";
+                break;
+            case '\t':
+                out << "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+                    out << escaped;
+                } else {
+                    out << c;
+                }
+                break;
+        }
+    }
+    out << '"';
+}
+
+/**
+ * @brief Reads a quoted JSON string from the front of a text.
+ * @param text The text, starting at the opening quote. On success it is advanced past the closing quote.
+ * @param value Receives the unescaped string.
+ * @return False if the text does not start with a complete, valid JSON string.
+ *
+ * \u escapes are decoded to UTF-8; surrogate pairs are combined.
+ */
+inline bool readJsonString(std::string_view& text, std::string& value) {
+    auto hex4 = [&](size_t at, unsigned& code) {
+        if (at + 4 > text.size()) {
+            return false;
+        }
+        code = 0;
+        for (size_t k = at; k < at + 4; ++k) {
+            const char c = text[k];
+            code <<= 4;
+            if (c >= '0' && c <= '9') {
+                code |= static_cast<unsigned>(c - '0');
+            } else if (c >= 'a' && c <= 'f') {
+                code |= static_cast<unsigned>(c - 'a' + 10);
+            } else if (c >= 'A' && c <= 'F') {
+                code |= static_cast<unsigned>(c - 'A' + 10);
+            } else {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if (text.empty() || text[0] != '"') {
+        return false;
+    }
+    value.clear();
+    for (size_t i = 1; i < text.size(); ++i) {
+        const char c = text[i];
+        if (c == '"') {
+            text.remove_prefix(i + 1);
+            return true;
+        }
+        if (c != '\\') {
+            value += c;
+            continue;
+        }
+        if (++i == text.size()) {
+            return false;
+        }
+        switch (text[i]) {
+            case '"':
+                value += '"';
+                break;
+            case '\\':
+                value += '\\';
+                break;
+            case '/':
+                value += '/';
+                break;
+            case 'b':
+                value += '\b';
+                break;
+            case 'f':
+                value += '\f';
+                break;
+            case 'n':
+                value += '\n';
+                break;
+            case 'r':
+                value += '\r';
+                break;
+            case 't':
+                value += '\t';
+                break;
+            case 'u': {
+                unsigned code = 0;
+                if (!hex4(i + 1, code)) {
+                    return false;
+                }
+                i += 4;
+                unsigned low = 0;
+                if (code >= 0xD800 && code < 0xDC00 && i + 2 < text.size() && text[i + 1] == '\\' &&
+                    text[i + 2] == 'u' && hex4(i + 3, low) && low >= 0xDC00 && low < 0xE000) {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    i += 6;
+                }
+                if (code < 0x80) {
+                    value += static_cast<char>(code);
+                } else if (code < 0x800) {
+                    value += static_cast<char>(0xC0 | (code >> 6));
+                    value += static_cast<char>(0x80 | (code & 0x3F));
+                } else if (code < 0x10000) {
+                    value += static_cast<char>(0xE0 | (code >> 12));
+                    value += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    value += static_cast<char>(0x80 | (code & 0x3F));
+                } else {
+                    value += static_cast<char>(0xF0 | (code >> 18));
+                    value += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                    value += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    value += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return false;
+}
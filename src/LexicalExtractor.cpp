@@ -0,0 +1,688 @@
+/**
+ * @file LexicalExtractor.cpp
+ * @brief This file contains the implementation of the lexical function extractor.
+ */
+
+#include "LexicalExtractor.h"
+#include "FunctionExtractor.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_set>
+
+namespace {
+
+enum class TokenKind { Identifier, Literal, Punct };
+
+struct LexToken {
+    TokenKind kind;
+    std::string_view text;
+    unsigned begin; ///< Byte offset of the first character.
+    unsigned end;   ///< Byte offset one past the last character.
+    int line;
+};
+
+bool isIdentStart(char c) {
+    return std::isalpha(static_cast<unsigned char>(c)) || c == '_' || c == '$';
+}
+
+bool isIdentChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$';
+}
+
+/**
+ * @brief Minimal C++ lexer that skips comments and preprocessor directives.
+ *
+ * Literals are returned as single tokens so that braces inside them are never counted. Only the first branch
+ * of each #if/#elif/#else chain is kept, except that #if 0 branches are skipped.
+ */
+class Lexer {
+public:
+    explicit Lexer(std::string_view text) : text_(text) {}
+
+    bool next(LexToken& token) {
+        while (pos_ < text_.size()) {
+            const char c = text_[pos_];
+            if (c == '\n') {
+                ++line_;
+                ++pos_;
+                lineStart_ = true;
+            } else if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') {
+                ++pos_;
+            } else if (c == '\\' && peek(1) == '\n') {
+                ++line_;
+                pos_ += 2;
+            } else if (c == '/' && peek(1) == '/') {
+                while (pos_ < text_.size() && text_[pos_] != '\n') {
+                    ++pos_;
+                }
+            } else if (c == '/' && peek(1) == '*') {
+                skipBlockComment();
+            } else if (c == '#' && lineStart_) {
+                directive();
+            } else {
+                lineStart_ = false;
+                lexToken(token);
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    char peek(size_t ahead) const { return pos_ + ahead < text_.size() ? text_[pos_ + ahead] : '\0'; }
+
+    void skipBlockComment() {
+        const size_t end = text_.find("*/", pos_ + 2);
+        const size_t stop = end == std::string_view::npos ? text_.size() : end + 2;
+        line_ += static_cast<int>(std::count(text_.begin() + pos_, text_.begin() + stop, '\n'));
+        pos_ = stop;
+    }
+
+    /**
+     * @brief Consumes the rest of a logical line, following backslash continuations.
+     * @return The text of the line.
+     */
+    std::string_view restOfLine() {
+        const size_t begin = pos_;
+        while (pos_ < text_.size() && text_[pos_] != '\n') {
+            if (text_[pos_] == '\\' && peek(1) == '\n') {
+                ++line_;
+                ++pos_;
+            } else if (text_[pos_] == '/' && peek(1) == '*') {
+                skipBlockComment();
+                continue;
+            }
+            ++pos_;
+        }
+        return text_.substr(begin, pos_ - begin);
+    }
+
+    static std::string_view directiveName(std::string_view line, std::string_view& rest) {
+        size_t i = line.find_first_not_of(" \t#");
+        if (i == std::string_view::npos) {
+            rest = {};
+            return {};
+        }
+        size_t end = i;
+        while (end < line.size() && isIdentChar(line[end])) {
+            ++end;
+        }
+        rest = line.substr(end);
+        return line.substr(i, end - i);
+    }
+
+    void directive() {
+        std::string_view rest;
+        const std::string_view name = directiveName(restOfLine(), rest);
+        if (name == "if") {
+            const size_t value = rest.find_first_not_of(" \t");
+            if (value != std::string_view::npos && rest[value] == '0' &&
+                rest.find_first_not_of(" \t\r", value + 1) == std::string_view::npos) {
+                skipBranch(true);
+            }
+        } else if (name == "else" || name == "elif" || name == "elifdef" || name == "elifndef") {
+            // The branch before this one was scanned; keeping a second one would duplicate braces.
+            skipBranch(false);
+        }
+    }
+
+    /**
+     * @brief Skips lines until the end of the current conditional branch.
+     * @param stopAtElse Whether an #else or #elif at the same level resumes scanning.
+     */
+    void skipBranch(bool stopAtElse) {
+        int depth = 0;
+        while (pos_ < text_.size()) {
+            std::string_view line = restOfLine();
+            if (pos_ < text_.size()) {
+                ++pos_;
+                ++line_;
+            }
+            const size_t hash = line.find_first_not_of(" \t");
+            if (hash == std::string_view::npos || line[hash] != '#') {
+                continue;
+            }
+            std::string_view rest;
+            const std::string_view name = directiveName(line.substr(hash), rest);
+            if (name == "if" || name == "ifdef" || name == "ifndef") {
+                ++depth;
+            } else if (name == "endif") {
+                if (depth-- == 0) {
+                    break;
+                }
+            } else if (depth == 0 && stopAtElse && (name == "else" || name.rfind("elif", 0) == 0)) {
+                break;
+            }
+        }
+        lineStart_ = true;
+    }
+
+    void lexQuoted(char quote) {
+        ++pos_;
+        while (pos_ < text_.size() && text_[pos_] != quote && text_[pos_] != '\n') {
+            pos_ += text_[pos_] == '\\' ? 2 : 1;
+        }
+        pos_ = std::min(pos_ + 1, text_.size());
+    }
+
+    void lexRawString() {
+        const size_t open = text_.find('(', pos_);
+        if (open == std::string_view::npos) {
+            pos_ = text_.size();
+            return;
+        }
+        const std::string close = ")" + std::string(text_.substr(pos_ + 1, open - pos_ - 1)) + "\"";
+        const size_t end = text_.find(close, open);
+        const size_t stop = end == std::string_view::npos ? text_.size() : end + close.size();
+        line_ += static_cast<int>(std::count(text_.begin() + pos_, text_.begin() + stop, '\n'));
+        pos_ = stop;
+    }
+
+    void lexToken(LexToken& token) {
+        const size_t begin = pos_;
+        token.line = line_;
+        token.kind = TokenKind::Punct;
+        const char c = text_[pos_];
+
+        if (isIdentStart(c)) {
+            while (pos_ < text_.size() && isIdentChar(text_[pos_])) {
+                ++pos_;
+            }
+            const std::string_view ident = text_.substr(begin, pos_ - begin);
+            const bool prefix = ident == "L" || ident == "u" || ident == "U" || ident == "u8";
+            const bool rawPrefix = ident == "R" || ident == "LR" || ident == "uR" || ident == "UR" || ident == "u8R";
+            if (pos_ < text_.size() && text_[pos_] == '"' && (prefix || rawPrefix)) {
+                token.kind = TokenKind::Literal;
+                rawPrefix ? lexRawString() : lexQuoted('"');
+            } else if (pos_ < text_.size() && text_[pos_] == '\'' && prefix) {
+                token.kind = TokenKind::Literal;
+                lexQuoted('\'');
+            } else {
+                token.kind = TokenKind::Identifier;
+            }
+        } else if (std::isdigit(static_cast<unsigned char>(c)) ||
+                   (c == '.' && std::isdigit(static_cast<unsigned char>(peek(1))))) {
+            token.kind = TokenKind::Literal;
+            while (pos_ < text_.size()) {
+                const char d = text_[pos_];
+                if ((d == '+' || d == '-') && std::strchr("eEpP", text_[pos_ - 1])) {
+                    ++pos_;
+                } else if (isIdentChar(d) || d == '.' || (d == '\'' && isIdentChar(peek(1)))) {
+                    ++pos_;
+                } else {
+                    break;
+                }
+            }
+        } else if (c == '"' || c == '\'') {
+            token.kind = TokenKind::Literal;
+            lexQuoted(c);
+        } else if ((c == ':' && peek(1) == ':') || (c == '-' && peek(1) == '>') || (c == '&' && peek(1) == '&')) {
+            pos_ += 2;
+        } else if (c == '.' && peek(1) == '.' && peek(2) == '.') {
+            pos_ += 3;
+        } else {
+            ++pos_;
+        }
+
+        token.begin = static_cast<unsigned>(begin);
+        token.end = static_cast<unsigned>(pos_);
+        token.text = text_.substr(begin, pos_ - begin);
+    }
+
+    std::string_view text_;
+    size_t pos_ = 0;
+    int line_ = 1;
+    bool lineStart_ = true;
+};
+
+/**
+ * @brief Keywords that can precede a parenthesis without naming a function.
+ */
+bool isNonNameKeyword(std::string_view word) {
+    static const std::unordered_set<std::string_view> keywords = {
+        "decltype", "alignas", "alignof", "sizeof", "noexcept", "throw", "__attribute__", "__declspec",
+        "static_assert", "requires", "if", "while", "for", "switch", "return", "typeof", "__typeof__", "asm",
+        "__asm__", "void", "int", "char", "bool", "short", "long", "float", "double", "unsigned", "signed",
+        "auto", "const", "volatile", "wchar_t", "char8_t", "char16_t", "char32_t", "typename", "new", "delete"};
+    return keywords.count(word) != 0;
+}
+
+bool is(const LexToken& token, std::string_view text) {
+    return token.text == text;
+}
+
+/**
+ * @brief Returns the index of the token that closes the group opened at index open.
+ */
+size_t matchingClose(const std::vector<LexToken>& tokens, size_t open) {
+    int depth = 0;
+    for (size_t i = open; i < tokens.size(); ++i) {
+        const std::string_view t = tokens[i].text;
+        if (t == "(" || t == "[" || t == "{") {
+            ++depth;
+        } else if ((t == ")" || t == "]" || t == "}") && --depth == 0) {
+            return i;
+        }
+    }
+    return tokens.size();
+}
+
+/**
+ * @brief The function declarator found in a declaration.
+ */
+struct Declarator {
+    size_t start = 0;      ///< First token of the declaration, after macro calls and attributes.
+    size_t name = 0;       ///< First token of the unqualified name.
+    size_t paren = 0;      ///< The opening parenthesis of the parameter list.
+    size_t closeParen = 0; ///< The closing parenthesis of the parameter list.
+    std::string spelling;  ///< The function name as libclang spells it.
+    bool special = false;  ///< Constructors, destructors and conversion operators.
+};
+
+/**
+ * @brief Finds the function declarator of a declaration.
+ * @param decl The tokens of the declaration, up to the terminating ';' or '{'.
+ * @param className The name of the enclosing class, empty at namespace scope.
+ * @param result Receives the declarator.
+ * @return False if the declaration does not declare a function.
+ *
+ * A parenthesised group preceded by an identifier with nothing before it is taken as a macro invocation, and
+ * the search restarts after it.
+ */
+bool findDeclarator(const std::vector<LexToken>& decl, std::string_view className, Declarator& result) {
+    size_t start = 0;
+    for (size_t i = 0; i < decl.size(); ++i) {
+        const LexToken& t = decl[i];
+        if (i == start && is(t, "[") && i + 1 < decl.size() && is(decl[i + 1], "[")) {
+            start = i = matchingClose(decl, i);
+            ++start;
+            continue;
+        }
+        if (i == start && is(t, "extern") && i + 1 < decl.size() && decl[i + 1].kind == TokenKind::Literal) {
+            start = ++i + 1;
+            continue;
+        }
+        if (is(t, "=") || is(t, "{")) {
+            return false;
+        }
+
+        size_t name = i;
+        size_t paren = decl.size();
+        std::string spelling;
+        bool special = false;
+        if (is(t, "operator")) {
+            spelling = "operator";
+            size_t j = i + 1;
+            if (j + 1 < decl.size() && ((is(decl[j], "(") && is(decl[j + 1], ")")) ||
+                                        (is(decl[j], "[") && is(decl[j + 1], "]")))) {
+                spelling.append(decl[j].text).append(decl[j + 1].text);
+                j += 2;
+            }
+            for (; j < decl.size() && !is(decl[j], "("); ++j) {
+                if (decl[j].kind == TokenKind::Identifier) {
+                    special = special || (decl[j].text != "new" && decl[j].text != "delete");
+                    spelling.append(" ");
+                }
+                spelling.append(decl[j].text);
+            }
+            paren = j;
+        } else if (is(t, "(") && i > start && decl[i - 1].kind == TokenKind::Identifier &&
+                   !isNonNameKeyword(decl[i - 1].text)) {
+            name = i - 1;
+            paren = i;
+            spelling = std::string(decl[name].text);
+        } else if (is(t, "(") || is(t, "[")) {
+            i = matchingClose(decl, i);
+            continue;
+        } else {
+            continue;
+        }
+        if (paren >= decl.size()) {
+            return false;
+        }
+
+        // Walk back over the qualifier chain, e.g. Outer::Inner::name or ~name.
+        size_t first = name;
+        if (first > start && is(decl[first - 1], "~")) {
+            special = true;
+            --first;
+        }
+        std::string_view qualifier = className;
+        bool qualified = false;
+        while (first >= start + 2 && is(decl[first - 1], "::") && decl[first - 2].kind == TokenKind::Identifier) {
+            if (!qualified) {
+                qualifier = decl[first - 2].text;
+                qualified = true;
+            }
+            first -= 2;
+        }
+        if (first > start && is(decl[first - 1], "::")) {
+            --first;
+        }
+        if (first == start && !special && spelling.rfind("operator", 0) != 0) {
+            // Nothing before the name: a constructor or a macro invocation such as EXPORT(...).
+            if (!qualifier.empty() && decl[name].text == qualifier) {
+                special = true;
+            } else {
+                start = i = matchingClose(decl, paren);
+                ++start;
+                continue;
+            }
+        }
+        if (!qualifier.empty() && decl[name].text == qualifier) {
+            special = true;
+        }
+
+        result.start = start;
+        result.name = name;
+        result.paren = paren;
+        result.closeParen = matchingClose(decl, paren);
+        result.spelling = std::move(spelling);
+        result.special = special;
+        return result.closeParen < decl.size();
+    }
+    return false;
+}
+
+/**
+ * @brief Returns whether the parameter list of a ';'-terminated declarator looks like parameters rather than
+ *        the constructor arguments of a variable.
+ */
+bool looksLikeParameters(const std::vector<LexToken>& decl, const Declarator& declarator) {
+    bool atParameterStart = true;
+    bool inDefault = false;
+    int depth = 0;
+    for (size_t i = declarator.paren + 1; i < declarator.closeParen; ++i) {
+        const LexToken& t = decl[i];
+        if (is(t, "(") || is(t, "[") || is(t, "{") || is(t, "<")) {
+            ++depth;
+        } else if (is(t, ")") || is(t, "]") || is(t, "}") || is(t, ">")) {
+            --depth;
+        } else if (depth == 0 && is(t, ",")) {
+            atParameterStart = true;
+            inDefault = false;
+            continue;
+        } else if (depth == 0 && is(t, "=")) {
+            inDefault = true;
+        }
+        if (inDefault) {
+            continue;
+        }
+        if (t.kind == TokenKind::Literal) {
+            return false;
+        }
+        if (atParameterStart && t.kind != TokenKind::Identifier && !is(t, "...") && !is(t, "::")) {
+            return false;
+        }
+        atParameterStart = false;
+    }
+    return true;
+}
+
+enum class ScopeKind { Namespace, Class, Skip };
+
+struct PendingFunction {
+    std::string spelling;
+    unsigned startOffset = 0;
+    int startLine = 0;
+};
+
+struct Scope {
+    explicit Scope(ScopeKind kind, std::string_view name = {}) : kind(kind), name(name) {}
+
+    ScopeKind kind;
+    std::string_view name;        ///< Class name for Class scopes.
+    bool hasFunction = false;     ///< Whether this Skip scope is the body of a recorded function.
+    PendingFunction function;
+};
+
+/**
+ * @brief Walks the token stream and collects function extents.
+ */
+class LexicalScanner {
+public:
+    explicit LexicalScanner(std::string_view text) : lexer_(text) {}
+
+    template <typename Emit>
+    void run(Emit emit) {
+        std::vector<Scope> scopes{Scope(ScopeKind::Namespace)};
+        std::vector<LexToken> decl;
+        int depth = 0;
+        bool inInitializerList = false;
+        LexToken t;
+
+        while (lexer_.next(t)) {
+            Scope& scope = scopes.back();
+            if (scope.kind == ScopeKind::Skip) {
+                if (is(t, "{")) {
+                    scopes.emplace_back(ScopeKind::Skip);
+                } else if (is(t, "}")) {
+                    if (scope.hasFunction) {
+                        emit(scope.function, t.end, t.line);
+                    }
+                    scopes.pop_back();
+                }
+                continue;
+            }
+
+            if (depth == 0 && is(t, "{") && !(inInitializerList && !decl.empty() &&
+                                             (decl.back().kind == TokenKind::Identifier || is(decl.back(), ">")))) {
+                scopes.push_back(openScope(decl, scope));
+                decl.clear();
+                inInitializerList = false;
+                continue;
+            }
+            if (depth == 0 && is(t, "}")) {
+                if (scopes.size() > 1) {
+                    scopes.pop_back();
+                }
+                decl.clear();
+                inInitializerList = false;
+                continue;
+            }
+            if (depth == 0 && is(t, ";")) {
+                declaration(decl, scope, emit);
+                decl.clear();
+                inInitializerList = false;
+                continue;
+            }
+            if (depth == 0 && is(t, ":") && !decl.empty()) {
+                const std::string_view last = decl.back().text;
+                if (scope.kind == ScopeKind::Class &&
+                    (last == "public" || last == "private" || last == "protected" || last == "slots" ||
+                     last == "signals" || last == "Q_SLOTS" || last == "Q_SIGNALS")) {
+                    decl.clear();
+                    continue;
+                }
+                inInitializerList = inInitializerList || is(decl.back(), ")");
+            }
+
+            if (is(t, "(") || is(t, "[") || is(t, "{")) {
+                ++depth;
+            } else if ((is(t, ")") || is(t, "]") || is(t, "}")) && depth > 0) {
+                --depth;
+            }
+            decl.push_back(t);
+        }
+    }
+
+private:
+    static bool isTemplate(const std::vector<LexToken>& decl) {
+        return !decl.empty() && is(decl[0], "template");
+    }
+
+    /**
+     * @brief Returns the index of the first token after the template parameter lists of a declaration.
+     */
+    static size_t skipTemplateHeaders(const std::vector<LexToken>& decl) {
+        size_t i = 0;
+        while (i + 1 < decl.size() && is(decl[i], "template") && is(decl[i + 1], "<")) {
+            int depth = 0;
+            for (i = i + 1; i < decl.size(); ++i) {
+                if (is(decl[i], "<")) {
+                    ++depth;
+                } else if (is(decl[i], ">") && --depth == 0) {
+                    break;
+                }
+            }
+            ++i;
+        }
+        return i;
+    }
+
+    Scope openScope(const std::vector<LexToken>& decl, const Scope& parent) {
+        if (decl.empty()) {
+            return Scope(ScopeKind::Skip);
+        }
+        if (is(decl[0], "namespace") || (is(decl[0], "inline") && decl.size() > 1 && is(decl[1], "namespace")) ||
+            (decl.size() == 2 && is(decl[0], "extern") && decl[1].kind == TokenKind::Literal)) {
+            return Scope(ScopeKind::Namespace);
+        }
+
+        for (size_t i = skipTemplateHeaders(decl); i < decl.size(); ++i) {
+            if (is(decl[i], "=") || is(decl[i], "(")) {
+                break;
+            }
+            if (is(decl[i], "enum")) {
+                return Scope(ScopeKind::Skip);
+            }
+            if (is(decl[i], "class") || is(decl[i], "struct") || is(decl[i], "union")) {
+                std::string_view name;
+                for (size_t j = i + 1; j < decl.size() && !is(decl[j], ":") && !is(decl[j], "<"); ++j) {
+                    if (is(decl[j], "[")) {
+                        j = matchingClose(decl, j);
+                    } else if (decl[j].kind == TokenKind::Identifier && decl[j].text != "final") {
+                        name = decl[j].text;
+                    }
+                }
+                return Scope(ScopeKind::Class, name);
+            }
+        }
+
+        Scope body(ScopeKind::Skip);
+        Declarator declarator;
+        if (!isTemplate(decl) && findDeclarator(decl, parent.name, declarator) && !declarator.special) {
+            body.hasFunction = true;
+            body.function.spelling = declarator.spelling;
+            body.function.startOffset = decl[declarator.start].begin;
+            body.function.startLine = decl[declarator.start].line;
+        }
+        return body;
+    }
+
+    template <typename Emit>
+    void declaration(const std::vector<LexToken>& decl, const Scope& scope, Emit& emit) {
+        if (decl.empty() || isTemplate(decl) || is(decl[0], "typedef") || is(decl[0], "using")) {
+            return;
+        }
+        Declarator declarator;
+        if (!findDeclarator(decl, scope.name, declarator) || declarator.special ||
+            !looksLikeParameters(decl, declarator)) {
+            return;
+        }
+        PendingFunction function{declarator.spelling, decl[declarator.start].begin, decl[declarator.start].line};
+        emit(function, decl.back().end, decl.back().line);
+    }
+
+    Lexer lexer_;
+};
+
+} // namespace
+
+/**
+ * @brief Extracts the functions of one file with a lexical scan.
+ * @param file The source file, used as the file path of the records.
+ * @param source The mapped content of the file.
+ * @param tokenizer The tokenizer used to count tokens, or nullptr to leave the counts at 0.
+ * @param cache The cache of token counts, or nullptr.
+ * @param fileHash The content hash of the file, used in the cache key.
+ * @param functionsInfo Receives the functions of the file.
+ * @param splitter Splits functions above its token limit, or nullptr to keep them whole.
+ */
+void extractFileFunctionsLexical(const std::filesystem::path& file, const SourceBuffer& source,
+                                 const Tokenizer* tokenizer, const FunctionCache* cache, uint64_t fileHash,
+                                 std::vector<FunctionInfo>& functionsInfo, const FunctionSplitter* splitter) {
+    TRACE_SCOPE("lexical_scan");
+    const std::string filePath = file.string();
+    LexicalScanner scanner(source.text());
+    scanner.run([&](const PendingFunction& function, unsigned endOffset, int endLine) {
+        appendFunctionInfo(filePath, function.spelling, function.startLine, endLine, function.startOffset, endOffset,
+                           source, tokenizer, functionsInfo, cache, fileHash);
+        if (splitter && splitter->oversized(functionsInfo.back(), source)) {
+            splitter->split({}, source, tokenizer, cache, functionsInfo);
+        }
+    });
+}
+
+/**
+ * @brief Compares the output of the AST and lexical extractors.
+ * @param ast The functions found by the AST path.
+ * @param lexical The functions found by the lexical path.
+ * @param out The stream that receives the report.
+ * @return The number of differences.
+ */
+size_t compareExtractions(const FunctionTable& ast, const FunctionTable& lexical, std::ostream& out) {
+    using Key = std::tuple<std::string_view, std::string_view, int>;
+    auto keyOf = [](const FunctionTable& table, size_t i) {
+        return Key{table.filePath(i), table.signature(i), table.startLine(i)};
+    };
+    auto describe = [](const FunctionTable& table, size_t i) {
+        return std::string(table.filePath(i)) + ":" + std::to_string(table.startLine(i)) + " " +
+               std::string(table.signature(i));
+    };
+
+    std::multimap<Key, size_t> lexicalByKey;
+    for (size_t i = 0; i < lexical.size(); ++i) {
+        lexicalByKey.emplace(keyOf(lexical, i), i);
+    }
+
+    constexpr size_t kMaxListed = 20;
+    std::vector<std::string> missed, extents;
+    size_t matched = 0;
+    for (size_t i = 0; i < ast.size(); ++i) {
+        auto it = lexicalByKey.find(keyOf(ast, i));
+        if (it == lexicalByKey.end()) {
+            missed.push_back(describe(ast, i));
+            continue;
+        }
+        const size_t other = it->second;
+        if (lexical.startOffset(other) != ast.startOffset(i) || lexical.endOffset(other) != ast.endOffset(i)) {
+            extents.push_back(describe(ast, i) + " (AST lines " + std::to_string(ast.startLine(i)) + "-" +
+                              std::to_string(ast.endLine(i)) + ", lexical " + std::to_string(lexical.startLine(other)) +
+                              "-" + std::to_string(lexical.endLine(other)) + ")");
+        } else {
+            ++matched;
+        }
+        lexicalByKey.erase(it);
+    }
+
+    std::vector<std::string> extra;
+    for (const auto& entry : lexicalByKey) {
+        extra.push_back(describe(lexical, entry.second));
+    }
+
+    out << "Lexical verification: " << ast.size() << " AST functions, " << lexical.size() << " lexical functions, "
+        << matched << " identical\n";
+    auto list = [&](const char* label, const std::vector<std::string>& items) {
+        if (items.empty()) {
+            return;
+        }
+        out << "  " << label << ": " << items.size() << "\n";
+        for (size_t i = 0; i < std::min(items.size(), kMaxListed); ++i) {
+            out << "    " << items[i] << "\n";
+        }
+        if (items.size() > kMaxListed) {
+            out << "    ... and " << items.size() - kMaxListed << " more\n";
+        }
+    };
+    list("missed by the lexical scan", missed);
+    list("not in the AST", extra);
+    list("different extent", extents);
+    return missed.size() + extra.size() + extents.size();
+}
@@ -0,0 +1,48 @@
+/**
+ * @file LexicalExtractor.h
+ * @brief This file contains the declarations of the lexical function extractor.
+ *
+ * The lexical extractor finds function definitions and declarations with a brace-matching scan of the source
+ * text instead of a libclang parse. Headers are never opened and nothing is type-checked, so it is much faster
+ * than the AST path. The price is accuracy when macros hide declarations or braces. It produces the same
+ * FunctionInfo records as the AST visitor, and compareExtractions() reports where the two disagree.
+ */
+
+#pragma once
+#include "FunctionalInfo.h"
+#include "FunctionSplitter.h"
+#include "FunctionTable.h"
+#include "SourceBuffer.h"
+#include <filesystem>
+#include <ostream>
+#include <vector>
+
+/**
+ * @brief Extracts the functions of one file with a lexical scan.
+ * @param file The source file, used as the file path of the records.
+ * @param source The mapped content of the file.
+ * @param tokenizer The tokenizer used to count tokens, or nullptr to leave the counts at 0.
+ * @param cache The cache of token counts, or nullptr.
+ * @param fileHash The content hash of the file, used in the cache key.
+ * @param functionsInfo Receives the functions of the file.
+ * @param splitter Splits functions above its token limit, or nullptr to keep them whole. Without an AST the
+ *                 fragments are cut at line boundaries only.
+ *
+ * Like the AST visitor, it reports free functions and methods, both definitions and declarations, and skips
+ * constructors, destructors, conversion operators and templates. Only the first branch of each #if chain is
+ * scanned, and #if 0 blocks are skipped.
+ */
+void extractFileFunctionsLexical(const std::filesystem::path& file, const SourceBuffer& source,
+                                 const Tokenizer* tokenizer, const FunctionCache* cache, uint64_t fileHash,
+                                 std::vector<FunctionInfo>& functionsInfo, const FunctionSplitter* splitter = nullptr);
+
+/**
+ * @brief Compares the output of the AST and lexical extractors.
+ * @param ast The functions found by the AST path.
+ * @param lexical The functions found by the lexical path.
+ * @param out The stream that receives the report.
+ * @return The number of differences: missed and extra functions, and functions with different extents.
+ *
+ * Functions are matched by file, name and start line.
+ */
+size_t compareExtractions(const FunctionTable& ast, const FunctionTable& lexical, std::ostream& out);
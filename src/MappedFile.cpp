@@ -0,0 +1,82 @@
+/**
+ * @file MappedFile.cpp
+ * @brief This file contains the implementation of the read-only memory-mapped file.
+ */
+
+#include "MappedFile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(MappedFile&& other) noexcept : data_(other.data_), size_(other.size_), open_(other.open_) {
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.open_ = false;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        data_ = other.data_;
+        size_ = other.size_;
+        open_ = other.open_;
+        other.data_ = nullptr;
+        other.size_ = 0;
+        other.open_ = false;
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+/**
+ * @brief Maps a file into memory, replacing any previous mapping.
+ * @param path The file to map.
+ * @return True on success, false if the file could not be opened or mapped.
+ */
+bool MappedFile::open(const std::filesystem::path& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size > 0) {
+        void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            ::close(fd);
+            return false;
+        }
+        // Sources are read front to back when building the line index
+        madvise(addr, size, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(addr);
+    }
+    ::close(fd);
+
+    size_ = size;
+    open_ = true;
+    return true;
+}
+
+/**
+ * @brief Unmaps the file.
+ */
+void MappedFile::close() {
+    if (data_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    open_ = false;
+}
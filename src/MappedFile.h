@@ -0,0 +1,46 @@
+/**
+ * @file MappedFile.h
+ * @brief This file contains the declaration of a read-only memory-mapped file.
+ */
+
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+/**
+ * @brief RAII wrapper around a read-only, private mmap of a whole file.
+ *
+ * Empty files are represented by an empty view without a mapping, since mmap rejects zero-length maps.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    /**
+     * @brief Maps a file into memory, replacing any previous mapping.
+     * @param path The file to map.
+     * @return True on success, false if the file could not be opened or mapped.
+     */
+    bool open(const std::filesystem::path& path);
+
+    /**
+     * @brief Unmaps the file.
+     */
+    void close();
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    std::string_view view() const { return {data_, size_}; }
+    bool isOpen() const { return open_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool open_ = false;
+};
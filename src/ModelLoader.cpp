@@ -1,6 +1,11 @@
 #include "ModelLoader.h"
+#include "Hash.h"
+#include "Trace.h"
+#include "VectorKernels.h"
 #include "common/common.h"
 #include "llama.h"
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 /**
@@ -13,7 +18,7 @@
  * @param tokens The vector of tokens to add.
  * @param seq_id The sequence ID for the tokens.
  */
-static void batch_add_seq(llama_batch & batch, const std::vector<int32_t> & tokens, int seq_id) {
+void batch_add_seq(llama_batch & batch, const std::vector<int32_t> & tokens, int seq_id) {
     for (size_t i = 0; i < tokens.size(); i++) {
         llama_batch_add(batch, tokens[i], i, { seq_id }, i == tokens.size() - 1);
     }
@@ -23,25 +28,33 @@ static void batch_add_seq(llama_batch & batch, const std::vector<int32_t> & toke
  * @brief Decodes a batch of tokens and generates embeddings.
  *
  * This function runs the model on the provided batch to generate embeddings. It also handles clearing the
- * previous kv_cache values and normalizing the embeddings.
+ * previous kv_cache values and normalizing the embeddings. Rows are zeroed first, so a row that could not be
+ * computed never carries the embedding of an earlier batch.
  *
  * @param ctx The context associated with the model.
  * @param batch The batch of tokens to decode.
- * @param output The output array for the embeddings.
+ * @param output The output array for the embeddings, one row of n_embd floats per sequence id.
  * @param n_seq The number of sequences in the batch.
  * @param n_embd The number of embedding dimensions.
+ * @return False if decoding failed or an embedding could not be read; the rows not filled are zero.
  */
-static void batch_decode(llama_context * ctx, llama_batch & batch, float * output, int n_seq, int n_embd) {
+bool batch_decode(llama_context * ctx, llama_batch & batch, float * output, int n_seq, int n_embd) {
+    TRACE_SCOPE("decode");
+    traceCount(TraceCounter::Decodes);
+    traceCount(TraceCounter::DecodedTokens, batch.n_tokens);
+    std::fill(output, output + static_cast<size_t>(n_seq) * n_embd, 0.0f);
+
     // clear previous kv_cache values (irrelevant for embeddings)
     llama_kv_cache_clear(ctx);
 
     // run model
-    fprintf(stderr, "%s: n_tokens = %d, n_seq = %d\n", __func__, batch.n_tokens, n_seq);
     if (llama_decode(ctx, batch) < 0) {
         fprintf(stderr, "%s : failed to decode\n", __func__);
+        return false;
     }
 
     // normalize on copy
+    bool ok = true;
     for (int i = 0; i < batch.n_tokens; i++) {
         if (!batch.logits[i]) {
             continue;
@@ -53,6 +66,7 @@ static void batch_decode(llama_context * ctx, llama_batch & batch, float * outpu
             embd = llama_get_embeddings_ith(ctx, i);
             if (embd == NULL) {
                 fprintf(stderr, "%s: failed to get embeddings for token %d\n", __func__, i);
+                ok = false;
                 continue;
             }
         }
@@ -60,80 +74,102 @@ static void batch_decode(llama_context * ctx, llama_batch & batch, float * outpu
         float * out = output + batch.seq_id[i][0] * n_embd;
         normalize(embd, out, n_embd);
     }
+    return ok;
 }
 
 /**
  * @brief Normalizes a vector and stores the result in another vector.
  *
  * This function calculates the L2 norm of the input vector and then divides each element by the norm to
- * normalize the vector. The result is stored in the output vector.
+ * normalize the vector. The result is stored in the output vector. The work is done by the SIMD kernels
+ * selected for the CPU.
  *
  * @param vec The input vector to normalize.
  * @param out The output vector where the normalized values are stored.
  * @param n The size of the vectors.
  */
-static void normalize(const float * vec, float * out, int n) {
-    float norm = 0;
-    for (int i = 0; i < n; i++) {
-        norm += vec[i] * vec[i];
-    }
-    norm = sqrt(norm);
-    for (int i = 0; i < n; i++) {
-        out[i] = vec[i] / norm;
-    }
+void normalize(const float * vec, float * out, int n) {
+    normalizeVector(vec, out, static_cast<size_t>(n));
 }
 
 /**
  * @brief Loads a language model from a file.
  *
  * This function initializes the backend and loads a language model from a file using the specified model path.
- * It sets the model parameters to load only the vocabulary.
+ * By default only the vocabulary is loaded, which is all tokenization needs. Models used to compute
+ * embeddings must be loaded with their weights.
  *
  * @param model_path The path to the model file.
+ * @param vocab_only Whether to load only the vocabulary.
  * @return A pointer to the loaded model, or nullptr if the model could not be loaded.
  */
-llama_model* load_model(const char* model_path) {
+llama_model* load_model(const char* model_path, bool vocab_only) {
     llama_backend_init();
     llama_model_params model_params = llama_model_default_params();
-    model_params.vocab_only = true;
+    model_params.vocab_only = vocab_only;
 
     return llama_load_model_from_file(model_path, model_params);
 }
 
+/**
+ * @brief Computes a fingerprint that identifies a model's tokenizer and weights.
+ *
+ * The fingerprint combines the model description, its size, parameter and embedding dimensions, and the text
+ * of every vocabulary entry. Two models with the same fingerprint produce the same tokens and embeddings, so
+ * the fingerprint is used to key cached results.
+ *
+ * @param model The model to fingerprint.
+ * @return The 64-bit fingerprint.
+ */
+uint64_t model_fingerprint(const llama_model* model) {
+    char desc[256] = {0};
+    llama_model_desc(model, desc, sizeof(desc));
+
+    uint64_t h = hashString(desc);
+    h = hashCombine(h, llama_model_size(model));
+    h = hashCombine(h, llama_model_n_params(model));
+    h = hashCombine(h, static_cast<uint64_t>(llama_n_embd(model)));
+
+    const int32_t n_vocab = llama_n_vocab(model);
+    h = hashCombine(h, static_cast<uint64_t>(n_vocab));
+    for (llama_token id = 0; id < n_vocab; ++id) {
+        const char* text = llama_token_get_text(model, id);
+        h = hashCombine(h, hashString(text ? text : ""));
+    }
+    return h;
+}
+
 /**
  * @brief Tokenizes an input string using the provided model.
  *
  * This function tokenizes an input string using the specified model. It determines whether to add a Beginning
- * of Sentence (BOS) token based on the model's configuration.
+ * of Sentence (BOS) token based on the model's configuration. Only the vocabulary is used, so no context is
+ * created. Callers that tokenize many strings should use the Tokenizer service, which reuses token buffers.
  *
  * @param model The model to use for tokenization.
  * @param input The input string to tokenize.
  * @return A vector of tokens.
  */
 std::vector<llama_token> tokenize(llama_model* model, const std::string& input) {
-    llama_context_params ctx_params = llama_context_default_params();
-    llama_context* ctx = llama_new_context_with_model(model, ctx_params);
     const bool add_bos = llama_should_add_bos_token(model);
-    std::vector<llama_token> tokens = ::llama_tokenize(model, input.c_str(), add_bos, true);
-
-    return tokens;
+    return ::llama_tokenize(model, input, add_bos, true);
 }
 
 /**
  * @brief Generates embeddings for a sequence of tokens.
  *
  * This function generates embeddings for a sequence of tokens using the provided context. It initializes
- * a batch, adds the tokens to the batch, and then decodes the batch to obtain the embeddings.
+ * a batch, adds the tokens to the batch, and then decodes the batch to obtain the embeddings. Use the
+ * EmbeddingEngine to embed many sequences, since it packs them into shared batches.
  *
  * @param ctx The context associated with the model.
  * @param tokens The vector of tokens for which to generate embeddings.
- * @return A vector of embeddings.
+ * @return The normalized embedding of the sequence, or an empty vector if it could not be computed.
  */
 std::vector<float> generate_embeddings(llama_context* ctx, const std::vector<int32_t>& tokens) {
-    // Ensure the batch size is set to accommodate the number of tokens
-    const int n_seq = 1; // Assuming a single sequence for simplicity
+    const int n_seq = 1;
     const int n_embd = llama_n_embd(llama_get_model(ctx)); // Get embedding dimensions from model associated with the context
-    std::vector<float> embeddings(n_embd, 0); // Initialize embeddings vector
+    std::vector<float> embeddings(n_embd, 0);
 
     // Initialize batch for tokens
     llama_batch batch = llama_batch_init(tokens.size(), 0, n_seq);
@@ -141,11 +177,11 @@ std::vector<float> generate_embeddings(llama_context* ctx, const std::vector<int
     // Add tokens to the batch
     batch_add_seq(batch, tokens, 0); // Using sequence ID 0
 
-    // Allocate output array for embeddings
-    std::vector<float> output(tokens.size() * n_embd, 0);
-
     // Generate embeddings by decoding the batch
-    batch_decode(ctx, batch, output.data(), n_seq, n_embd);
+    if (!batch_decode(ctx, batch, embeddings.data(), n_seq, n_embd)) {
+        embeddings.clear();
+    }
+    llama_batch_free(batch);
 
     return embeddings;
 }
@@ -7,7 +7,8 @@
  * tokenized sequences and to normalize vectors.
  *
  * The following functions are declared in this header:
- * - load_model: Loads a language model from a file.
+ * - load_model: Loads a language model, or only its vocabulary, from a file.
+ * - model_fingerprint: Computes a fingerprint that identifies a model's tokenizer and weights.
  * - tokenize: Tokenizes an input string using the provided model.
  * - generate_embeddings: Generates embeddings for a sequence of tokens.
  * - batch_add_seq: Adds a sequence of tokens to a batch.
@@ -20,12 +21,14 @@
 
 #pragma once
 #include "llama.h"
+#include <cstdint>
 #include <string>
 #include <vector>
 
-static void batch_add_seq(llama_batch & batch, const std::vector<int32_t> & tokens, int seq_id);
-static void batch_decode(llama_context * ctx, llama_batch & batch, float * output, int n_seq, int n_embd);
-static void normalize(const float * vec, float * out, int n);
-llama_model* load_model(const char* model_path);
+void batch_add_seq(llama_batch & batch, const std::vector<int32_t> & tokens, int seq_id);
+bool batch_decode(llama_context * ctx, llama_batch & batch, float * output, int n_seq, int n_embd);
+void normalize(const float * vec, float * out, int n);
+llama_model* load_model(const char* model_path, bool vocab_only = true);
+uint64_t model_fingerprint(const llama_model* model);
 std::vector<llama_token> tokenize(llama_model* model, const std::string& input);
-std::vector<float> generate_embeddings(llama_model* model, const std::string& input);
\ No newline at end of file
+std::vector<float> generate_embeddings(llama_context* ctx, const std::vector<int32_t>& tokens);
\ No newline at end of file
@@ -0,0 +1,231 @@
+/**
+ * @file NearDuplicates.cpp
+ * @brief This file contains the implementation of the near-duplicate detector.
+ */
+
+#include "NearDuplicates.h"
+#include "Hash.h"
+#include "SourceBuffer.h"
+#include "Trace.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <limits>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+constexpr size_t kShingleTokens = 5;
+constexpr size_t kBands = 16;
+constexpr size_t kRows = 4;
+constexpr size_t kSignatureSize = kBands * kRows;
+
+using Signature = std::array<uint32_t, kSignatureSize>;
+
+/**
+ * @brief Words kept as they are when normalizing; every other identifier becomes a placeholder.
+ */
+bool isKeyword(std::string_view word) {
+    static const std::unordered_set<std::string_view> keywords = {
+        "auto", "bool", "break", "case", "catch", "char", "class", "const", "constexpr", "continue", "default",
+        "delete", "do", "double", "else", "enum", "explicit", "false", "float", "for", "goto", "if", "inline",
+        "int", "long", "new", "noexcept", "nullptr", "operator", "private", "protected", "public", "return",
+        "short", "signed", "sizeof", "static", "static_cast", "reinterpret_cast", "const_cast", "dynamic_cast",
+        "struct", "switch", "template", "this", "throw", "true", "try", "typename", "unsigned", "using", "virtual",
+        "void", "volatile", "while"};
+    return keywords.count(word) != 0;
+}
+
+/**
+ * @brief Hashes the normalized tokens of a function body, skipping whitespace and comments.
+ */
+void normalizedTokens(std::string_view text, std::vector<uint64_t>& tokens) {
+    static const uint64_t kIdentifier = hashString("$id");
+    static const uint64_t kNumber = hashString("$num");
+    static const uint64_t kString = hashString("$str");
+
+    tokens.clear();
+    size_t i = 0;
+    while (i < text.size()) {
+        const unsigned char c = static_cast<unsigned char>(text[i]);
+        if (std::isspace(c)) {
+            ++i;
+        } else if (text.compare(i, 2, "//") == 0) {
+            const size_t end = text.find('\n', i);
+            i = end == std::string_view::npos ? text.size() : end;
+        } else if (text.compare(i, 2, "/*") == 0) {
+            const size_t end = text.find("*/", i + 2);
+            i = end == std::string_view::npos ? text.size() : end + 2;
+        } else if (std::isalpha(c) || c == '_') {
+            size_t end = i + 1;
+            while (end < text.size() && (std::isalnum(static_cast<unsigned char>(text[end])) || text[end] == '_')) {
+                ++end;
+            }
+            const std::string_view word = text.substr(i, end - i);
+            tokens.push_back(isKeyword(word) ? hashString(word) : kIdentifier);
+            i = end;
+        } else if (std::isdigit(c)) {
+            while (i < text.size() && (std::isalnum(static_cast<unsigned char>(text[i])) || text[i] == '.' ||
+                                       text[i] == '\'')) {
+                ++i;
+            }
+            tokens.push_back(kNumber);
+        } else if (c == '"' || c == '\'') {
+            size_t end = i + 1;
+            while (end < text.size() && text[end] != static_cast<char>(c)) {
+                end += text[end] == '\\' ? 2 : 1;
+            }
+            i = std::min(end + 1, text.size());
+            tokens.push_back(kString);
+        } else {
+            tokens.push_back(c);
+            ++i;
+        }
+    }
+}
+
+/**
+ * @brief Computes the MinHash signature of a function's shingles.
+ * @return The number of shingles; the signature is only meaningful if it is not 0.
+ *
+ * The k hash functions are h_k(x) = a_k * x + b_k over a well-mixed shingle hash, with fixed odd multipliers, and
+ * each keeps the high 32 bits of its minimum.
+ */
+size_t minHash(const std::vector<uint64_t>& tokens, Signature& signature) {
+    static const auto coefficients = [] {
+        std::array<std::pair<uint64_t, uint64_t>, kSignatureSize> values{};
+        for (size_t k = 0; k < kSignatureSize; ++k) {
+            values[k] = {hashMix(2 * k + 1) | 1, hashMix(2 * k + 2)};
+        }
+        return values;
+    }();
+
+    std::array<uint64_t, kSignatureSize> minimum;
+    minimum.fill(std::numeric_limits<uint64_t>::max());
+    if (tokens.size() < kShingleTokens) {
+        return 0;
+    }
+    const size_t shingles = tokens.size() - kShingleTokens + 1;
+    for (size_t s = 0; s < shingles; ++s) {
+        uint64_t shingle = 0;
+        for (size_t t = 0; t < kShingleTokens; ++t) {
+            shingle = hashCombine(shingle, tokens[s + t]);
+        }
+        for (size_t k = 0; k < kSignatureSize; ++k) {
+            minimum[k] = std::min(minimum[k], coefficients[k].first * shingle + coefficients[k].second);
+        }
+    }
+    for (size_t k = 0; k < kSignatureSize; ++k) {
+        signature[k] = static_cast<uint32_t>(minimum[k] >> 32);
+    }
+    return shingles;
+}
+
+double similarity(const Signature& a, const Signature& b) {
+    size_t equal = 0;
+    for (size_t k = 0; k < kSignatureSize; ++k) {
+        equal += a[k] == b[k];
+    }
+    return static_cast<double>(equal) / kSignatureSize;
+}
+
+} // namespace
+
+/**
+ * @brief Groups near-identical functions.
+ *
+ * With 16 bands of 4 rows, two functions become candidates with probability 1 - (1 - s^4)^16, which is above 99%
+ * for a similarity s of 0.8 and below 10% for 0.3, so few candidates are checked below any useful threshold.
+ *
+ * @param functions The functions.
+ * @param params The similarity threshold and minimum size.
+ * @param numThreads The number of worker threads, 0 selects the hardware concurrency.
+ * @return For every function, the index of its representative.
+ */
+std::vector<uint32_t> findNearDuplicates(const FunctionTable& functions, const NearDuplicateParams& params,
+                                         unsigned numThreads) {
+    TRACE_SCOPE("near_duplicates");
+    const size_t count = functions.size();
+    std::vector<Signature> signatures(count);
+    std::vector<uint8_t> eligible(count, 0);
+
+    // [begin, end) ranges of functions sharing a file, so each file is mapped once
+    std::vector<std::pair<size_t, size_t>> files;
+    for (size_t i = 0; i < count; ++i) {
+        if (files.empty() || functions.fileId(files.back().first) != functions.fileId(i)) {
+            files.emplace_back(i, i);
+        }
+        files.back().second = i + 1;
+    }
+
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    numThreads = std::min<unsigned>(numThreads, std::max<size_t>(files.size(), 1));
+
+    std::atomic<size_t> nextFile{0};
+    auto worker = [&]() {
+        SourceBuffer source;
+        std::vector<uint64_t> tokens;
+        for (size_t f = nextFile++; f < files.size(); f = nextFile++) {
+            if (!source.open(functions.filePath(files[f].first))) {
+                continue;
+            }
+            for (size_t i = files[f].first; i < files[f].second; ++i) {
+                normalizedTokens(source.slice(functions.startOffset(i), functions.endOffset(i)), tokens);
+                eligible[i] = minHash(tokens, signatures[i]) >= std::max<size_t>(params.minShingles, 1);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(numThreads);
+    for (unsigned t = 0; t < numThreads; ++t) {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Band hash -> representatives with that band, one table per band
+    std::vector<std::unordered_map<uint64_t, std::vector<uint32_t>>> buckets(kBands);
+    std::vector<uint32_t> representatives(count);
+    for (size_t i = 0; i < count; ++i) {
+        representatives[i] = static_cast<uint32_t>(i);
+        if (!eligible[i]) {
+            continue;
+        }
+
+        std::array<uint64_t, kBands> bandHashes;
+        for (size_t b = 0; b < kBands; ++b) {
+            bandHashes[b] = hashBytes(signatures[i].data() + b * kRows, kRows * sizeof(uint32_t), b);
+        }
+
+        uint32_t match = static_cast<uint32_t>(i);
+        for (size_t b = 0; b < kBands && match == i; ++b) {
+            auto it = buckets[b].find(bandHashes[b]);
+            if (it == buckets[b].end()) {
+                continue;
+            }
+            for (uint32_t candidate : it->second) {
+                if (similarity(signatures[i], signatures[candidate]) >= params.threshold) {
+                    match = candidate;
+                    break;
+                }
+            }
+        }
+
+        if (match != i) {
+            representatives[i] = match;
+            continue;
+        }
+        for (size_t b = 0; b < kBands; ++b) {
+            buckets[b][bandHashes[b]].push_back(static_cast<uint32_t>(i));
+        }
+    }
+    return representatives;
+}
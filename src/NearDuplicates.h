@@ -0,0 +1,39 @@
+/**
+ * @file NearDuplicates.h
+ * @brief This file contains the declaration of the near-duplicate detector used to skip redundant embeddings.
+ *
+ * Copy-pasted and generated functions often differ only in their identifiers and literals. Each function is reduced
+ * to a normalized token stream, in which identifiers other than keywords, numbers and string literals are replaced by
+ * placeholders, and the stream's 5-token shingles are summarized by a MinHash signature. Locality-sensitive hashing
+ * over bands of the signature proposes candidates, and a candidate joins a group only if the signatures estimate a
+ * Jaccard similarity of at least the threshold. Each group is embedded once, through its representative.
+ */
+
+#pragma once
+#include "FunctionTable.h"
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Parameters of near-duplicate detection.
+ */
+struct NearDuplicateParams {
+    double threshold = 0.9;  ///< Minimum estimated Jaccard similarity of the shingle sets to share an embedding.
+    size_t minShingles = 16; ///< Functions with fewer shingles are never grouped; short bodies say too little.
+};
+
+/**
+ * @brief Groups near-identical functions.
+ * @param functions The functions. Their text is read back from their files.
+ * @param params The similarity threshold and minimum size.
+ * @param numThreads The number of worker threads for the signatures, 0 selects the hardware concurrency.
+ * @return For every function, the index of the representative whose embedding it shares, which is its own index
+ *         for a representative. A representative always precedes the functions it stands for.
+ *
+ * Groups are formed greedily in table order: a function joins an earlier representative it shares a band with
+ * and is similar enough to, or becomes a representative itself. Comparing only against representatives keeps
+ * groups from drifting through chains of pairwise similar functions, and makes the result independent of thread
+ * scheduling.
+ */
+std::vector<uint32_t> findNearDuplicates(const FunctionTable& functions, const NearDuplicateParams& params,
+                                         unsigned numThreads);
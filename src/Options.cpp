@@ -0,0 +1,407 @@
+/**
+ * @file Options.cpp
+ * @brief This file contains the implementation of the command-line option parser.
+ */
+
+#include "Options.h"
+#include "ShardFile.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Prints the usage message to stderr.
+ * @param program The name of the program, usually argv[0].
+ */
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " <model_path> <embedding_model_path> <path> [options]\n"
+              << "       " << program << " merge <shard_file>... [options]\n"
+              << "       " << program << " query <embedding_model_path> <text> --index DIR [--top K]\n"
+              << "Options:\n"
+              << "  --threads N      Number of parser threads (default: hardware concurrency)\n"
+              << "  --cache-dir DIR  Reuse token counts and embeddings of unchanged functions from DIR\n"
+              << "  --embed          Compute an embedding for every function\n"
+              << "  --dedup T        Embed near-duplicate functions (MinHash similarity >= T, e.g. 0.9) only once\n"
+              << "  --chunk-size N   Token budget per chunk (default: smallest power of two that fits)\n"
+              << "  --split N        Split functions above N tokens at statement boundaries, 0 to disable\n"
+              << "                   (default: the chunk size, or the model context when none is given)\n"
+              << "  --split-overlap N  Tokens repeated between consecutive fragments (default: 64)\n"
+              << "  --estimate-tokens  Estimate token counts with a per-model calibrated fit, tokenizing exactly\n"
+              << "                   only functions whose error bounds straddle the chunk size\n"
+              << "  --packing NAME   Chunk packing: first-fit, best-fit-decreasing or locality (default: first-fit)\n"
+              << "  --index DIR      Append the functions and embeddings to the binary index in DIR\n"
+              << "  --index-type T   Embedding storage in the index: fp32, fp16 or int8 (default: fp32)\n"
+              << "  --compact        Compact the index into a single segment after appending\n"
+              << "  --ann            Build the HNSW nearest-neighbor graph over the index\n"
+              << "  --ann-m N        Graph neighbors per node (default: 16)\n"
+              << "  --ann-ef N       Candidate list size while building the graph (default: 200)\n"
+              << "  --ann-ef-search N  Candidate list size of 'query' graph searches; higher trades latency\n"
+              << "                   for recall (default: the value stored with the graph, 64)\n"
+              << "  --top K          Number of functions 'query' returns (default: 10)\n"
+              << "  --stream         Stream functions through parse, tokenize, pack, embed and emit stages\n"
+              << "  --stage-threads E,T,M  Extract, tokenize and embed threads when streaming (default: N,1,1)\n"
+              << "  --queue-depth N  Capacity of each streaming queue (default: 256)\n"
+              << "  --output PATH    Write streamed chunks as JSON lines to PATH (default: stdout)\n"
+              << "  --extensions L   Comma-separated source extensions to collect (default: cpp,cc,cxx)\n"
+              << "  --exclude PAT    Skip files and directories matching a .gitignore-style pattern (repeatable)\n"
+              << "  --gitignore      Also apply the .gitignore files found in the tree\n"
+              << "  --max-file-size N  Skip source files larger than N bytes\n"
+              << "  --skip-generated Skip files whose first lines carry a generated-code marker\n"
+              << "  --read-threads N Read files into the page cache ahead of the parsers with N threads\n"
+              << "  -p DIR           Read per-file compiler flags from DIR/compile_commands.json\n"
+              << "  --pch DIR        Precompile the headers most files include into DIR and reuse them\n"
+              << "  --lexical        Find functions with a fast lexical scan instead of a full libclang parse\n"
+              << "  --headers        Also extract functions defined in project headers, each only once\n"
+              << "  --verify-lexical Run both extractors, report where they differ and exit\n"
+              << "  --stats          Print per-stage timings and counters to stderr at exit\n"
+              << "  --trace FILE     Write a Chrome trace-event JSON file of every timed stage\n"
+              << "  --daemon SOCKET  Stay resident, watch <path> for changes and answer requests on a Unix socket\n"
+              << "  --warm-units N   Translation units the daemon keeps alive for fast reparsing (default: 64)\n"
+              << "  --shard I/N      Process only shard I of N of the files and write it to the --output file;\n"
+              << "                   'merge' combines all N shard files, then packs chunks and updates the index\n";
+}
+
+/**
+ * @brief Parses an unsigned integer option value.
+ * @param text The text to parse.
+ * @param value The parsed value.
+ * @return True if the text was a valid unsigned integer.
+ */
+static bool parseUnsigned(const char* text, unsigned& value) {
+    char* end = nullptr;
+    unsigned long parsed = std::strtoul(text, &end, 10);
+    if (end == text || *end != '\0') {
+        return false;
+    }
+    value = static_cast<unsigned>(parsed);
+    return true;
+}
+
+/**
+ * @brief Parses a 64-bit unsigned integer option value.
+ * @param text The text to parse.
+ * @param value The parsed value.
+ * @return True if the text was a valid unsigned integer.
+ */
+static bool parseUnsigned64(const char* text, uint64_t& value) {
+    char* end = nullptr;
+    unsigned long long parsed = std::strtoull(text, &end, 10);
+    if (end == text || *end != '\0') {
+        return false;
+    }
+    value = static_cast<uint64_t>(parsed);
+    return true;
+}
+
+/**
+ * @brief Parses a fraction option value.
+ * @param text The text to parse.
+ * @param value The parsed value.
+ * @return True if the text was a number in (0, 1].
+ */
+static bool parseFraction(const char* text, double& value) {
+    char* end = nullptr;
+    const double parsed = std::strtod(text, &end);
+    if (end == text || *end != '\0' || !(parsed > 0.0 && parsed <= 1.0)) {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+/**
+ * @brief Parses a comma-separated list of three thread counts.
+ * @param text The text to parse, e.g. "8,2,1".
+ * @param values The parsed counts.
+ * @return True if the text held exactly three unsigned integers.
+ */
+static bool parseStageThreads(const char* text, unsigned (&values)[3]) {
+    const std::string list = text;
+    size_t begin = 0;
+    for (int i = 0; i < 3; ++i) {
+        const size_t end = i < 2 ? list.find(',', begin) : list.size();
+        if (end == std::string::npos || !parseUnsigned(list.substr(begin, end - begin).c_str(), values[i])) {
+            return false;
+        }
+        begin = end + 1;
+    }
+    return true;
+}
+
+/**
+ * @brief Parses the command-line arguments.
+ * @param argc The number of command-line arguments.
+ * @param argv The array of command-line arguments.
+ * @param options The structure that receives the parsed options.
+ * @return True if the arguments were valid, false otherwise.
+ */
+bool parseOptions(int argc, char** argv, Options& options) {
+    std::vector<std::string> positional;
+
+    int first = 1;
+    if (argc > 1 && std::string(argv[1]) == "merge") {
+        options.merge = true;
+        first = 2;
+    } else if (argc > 1 && std::string(argv[1]) == "query") {
+        options.query = true;
+        first = 2;
+    }
+
+    for (int i = first; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--threads") {
+            if (i + 1 >= argc || !parseUnsigned(argv[++i], options.threads)) {
+                std::cerr << "Invalid value for --threads" << std::endl;
+                return false;
+            }
+        } else if (arg == "--cache-dir") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for --cache-dir" << std::endl;
+                return false;
+            }
+            options.cacheDir = argv[++i];
+        } else if (arg == "--chunk-size") {
+            unsigned chunkSize = 0;
+            if (i + 1 >= argc || !parseUnsigned(argv[++i], chunkSize) || chunkSize == 0) {
+                std::cerr << "Invalid value for --chunk-size" << std::endl;
+                return false;
+            }
+            options.chunkSize = static_cast<int>(chunkSize);
+        } else if (arg == "--split" || arg == "--split-overlap") {
+            unsigned value = 0;
+            if (i + 1 >= argc || !parseUnsigned(argv[++i], value)) {
+                std::cerr << "Invalid value for " << arg << std::endl;
+                return false;
+            }
+            (arg == "--split" ? options.splitTokens : options.splitOverlap) = static_cast<int>(value);
+        } else if (arg == "--estimate-tokens") {
+            options.estimateTokens = true;
+        } else if (arg == "--packing") {
+            if (i + 1 >= argc || !parsePackingStrategy(argv[++i], options.packing)) {
+                std::cerr << "Invalid value for --packing" << std::endl;
+                return false;
+            }
+        } else if (arg == "--index") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for --index" << std::endl;
+                return false;
+            }
+            options.indexDir = argv[++i];
+        } else if (arg == "--index-type") {
+            if (i + 1 >= argc || !parseEmbeddingType(argv[++i], options.indexType)) {
+                std::cerr << "Invalid value for --index-type" << std::endl;
+                return false;
+            }
+        } else if (arg == "--compact") {
+            options.compactIndex = true;
+        } else if (arg == "--ann") {
+            options.buildAnn = true;
+        } else if (arg == "--ann-m" || arg == "--ann-ef") {
+            unsigned value = 0;
+            if (i + 1 >= argc || !parseUnsigned(argv[++i], value) || value < 2) {
+                std::cerr << "Invalid value for " << arg << std::endl;
+                return false;
+            }
+            (arg == "--ann-m" ? options.annParams.M : options.annParams.efConstruction) = value;
+        } else if (arg == "--ann-ef-search") {
+            if (i + 1 >= argc || !parseUnsigned(argv[++i], options.annEfSearch) || options.annEfSearch == 0) {
+                std::cerr << "Invalid value for --ann-ef-search" << std::endl;
+                return false;
+            }
+        } else if (arg == "--top") {
+            if (i + 1 >= argc || !parseUnsigned(argv[++i], options.topK) || options.topK == 0) {
+                std::cerr << "Invalid value for --top" << std::endl;
+                return false;
+            }
+        } else if (arg == "--stream") {
+            options.stream = true;
+        } else if (arg == "--stage-threads") {
+            if (i + 1 >= argc || !parseStageThreads(argv[++i], options.stageThreads)) {
+                std::cerr << "Invalid value for --stage-threads" << std::endl;
+                return false;
+            }
+        } else if (arg == "--queue-depth") {
+            unsigned depth = 0;
+            if (i + 1 >= argc || !parseUnsigned(argv[++i], depth) || depth == 0) {
+                std::cerr << "Invalid value for --queue-depth" << std::endl;
+                return false;
+            }
+            options.queueDepth = depth;
+        } else if (arg == "--output") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for --output" << std::endl;
+                return false;
+            }
+            options.outputPath = argv[++i];
+        } else if (arg == "-p" || arg == "--compile-commands") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                return false;
+            }
+            options.compileCommandsDir = argv[++i];
+        } else if (arg == "--pch") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for --pch" << std::endl;
+                return false;
+            }
+            options.pchDir = argv[++i];
+        } else if (arg == "--lexical") {
+            options.lexical = true;
+        } else if (arg == "--headers") {
+            options.headers = true;
+        } else if (arg == "--verify-lexical") {
+            options.verifyLexical = true;
+        } else if (arg == "--stats") {
+            options.stats = true;
+        } else if (arg == "--trace") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for --trace" << std::endl;
+                return false;
+            }
+            options.tracePath = argv[++i];
+        } else if (arg == "--daemon") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for --daemon" << std::endl;
+                return false;
+            }
+            options.daemonSocket = argv[++i];
+        } else if (arg == "--warm-units") {
+            unsigned units = 0;
+            if (i + 1 >= argc || !parseUnsigned(argv[++i], units)) {
+                std::cerr << "Invalid value for --warm-units" << std::endl;
+                return false;
+            }
+            options.warmUnits = units;
+        } else if (arg == "--dedup") {
+            if (i + 1 >= argc || !parseFraction(argv[++i], options.dedupThreshold)) {
+                std::cerr << "Invalid value for --dedup" << std::endl;
+                return false;
+            }
+        } else if (arg == "--shard") {
+            if (i + 1 >= argc || !parseShardSpec(argv[++i], options.shard, options.shardCount)) {
+                std::cerr << "Invalid value for --shard" << std::endl;
+                return false;
+            }
+        } else if (arg == "--extensions") {
+            if (i + 1 >= argc || !parseExtensions(argv[++i], options.crawl.extensions)) {
+                std::cerr << "Invalid value for --extensions" << std::endl;
+                return false;
+            }
+        } else if (arg == "--exclude") {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for --exclude" << std::endl;
+                return false;
+            }
+            options.crawl.excludes.push_back(argv[++i]);
+        } else if (arg == "--gitignore") {
+            options.crawl.useGitignore = true;
+        } else if (arg == "--max-file-size") {
+            if (i + 1 >= argc || !parseUnsigned64(argv[++i], options.crawl.maxFileSize)) {
+                std::cerr << "Invalid value for --max-file-size" << std::endl;
+                return false;
+            }
+        } else if (arg == "--skip-generated") {
+            options.crawl.skipGenerated = true;
+        } else if (arg == "--read-threads") {
+            if (i + 1 >= argc || !parseUnsigned(argv[++i], options.readThreads)) {
+                std::cerr << "Invalid value for --read-threads" << std::endl;
+                return false;
+            }
+        } else if (arg == "--embed") {
+            options.embed = true;
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (options.merge) {
+        if (positional.empty()) {
+            return false;
+        }
+        if (options.embed || options.stream || options.shardCount || !options.daemonSocket.empty() ||
+            options.verifyLexical || options.estimateTokens || options.dedupThreshold > 0.0) {
+            std::cerr << "merge only packs chunks and updates the index; extraction options belong to the shards"
+                      << std::endl;
+            return false;
+        }
+        if (options.buildAnn && options.indexDir.empty()) {
+            std::cerr << "--ann requires --index" << std::endl;
+            return false;
+        }
+        options.shardFiles = positional;
+        return true;
+    }
+
+    if (options.query) {
+        if (positional.size() != 2) {
+            return false;
+        }
+        if (options.indexDir.empty()) {
+            std::cerr << "query requires --index" << std::endl;
+            return false;
+        }
+        if (options.stream || options.shardCount || !options.daemonSocket.empty() || options.compactIndex ||
+            options.buildAnn) {
+            std::cerr << "query only searches the index; it does not extract or update it" << std::endl;
+            return false;
+        }
+        options.embeddingModelPath = positional[0];
+        options.queryText = positional[1];
+        return true;
+    }
+
+    if (positional.size() != 3) {
+        return false;
+    }
+
+    if (options.shardCount > 0) {
+        if (options.outputPath.empty()) {
+            std::cerr << "--shard requires --output for the shard file" << std::endl;
+            return false;
+        }
+        if (options.stream || !options.daemonSocket.empty() || options.verifyLexical || options.estimateTokens ||
+            options.dedupThreshold > 0.0 || !options.indexDir.empty()) {
+            std::cerr << "--stream, --daemon, --verify-lexical, --estimate-tokens, --dedup and --index are not "
+                         "supported with --shard"
+                      << std::endl;
+            return false;
+        }
+    }
+
+    if (options.buildAnn && options.indexDir.empty()) {
+        std::cerr << "--ann requires --index" << std::endl;
+        return false;
+    }
+
+    if (options.stream && (options.compactIndex || options.buildAnn || options.estimateTokens)) {
+        std::cerr << "--compact, --ann and --estimate-tokens are not supported with --stream" << std::endl;
+        return false;
+    }
+
+    if (options.dedupThreshold > 0.0 && (!options.embed || options.stream || !options.daemonSocket.empty())) {
+        std::cerr << "--dedup requires --embed and is not supported with --stream or --daemon" << std::endl;
+        return false;
+    }
+
+    if (options.headers && (options.lexical || !options.daemonSocket.empty())) {
+        std::cerr << "--headers requires the libclang extractor and is not supported with --daemon" << std::endl;
+        return false;
+    }
+
+    if (!options.daemonSocket.empty() &&
+        (options.stream || options.verifyLexical || options.estimateTokens || !options.indexDir.empty())) {
+        std::cerr << "--stream, --verify-lexical, --estimate-tokens and --index are not supported with --daemon"
+                  << std::endl;
+        return false;
+    }
+
+    options.crawl.threads = options.threads;
+    options.modelPath = positional[0];
+    options.embeddingModelPath = positional[1];
+    options.inputPath = positional[2];
+    return true;
+}
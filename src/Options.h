@@ -0,0 +1,78 @@
+/**
+ * @file Options.h
+ * @brief This file contains the declarations of the command-line options of the program.
+ */
+
+#pragma once
+#include "ChunkPlanner.h"
+#include "Crawler.h"
+#include "EmbeddingIndex.h"
+#include "HnswIndex.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Structure to hold the parsed command-line options.
+ */
+struct Options {
+    std::string modelPath;
+    std::string embeddingModelPath;
+    std::string inputPath;
+    CrawlOptions crawl;    ///< Extensions and filters of the source files collected under the input path.
+    unsigned readThreads = 0; ///< Threads reading files ahead of the parsers, 0 to disable read-ahead.
+    std::string cacheDir;  ///< Directory of the token count and embedding cache, empty to disable it.
+    unsigned threads = 0; ///< Number of parser threads, 0 selects the hardware concurrency.
+    bool embed = false;   ///< Whether to compute function embeddings with the embedding model.
+    double dedupThreshold = 0.0; ///< Similarity at which near-duplicates share one embedding, 0 disables it.
+    int chunkSize = 0;    ///< Token budget per chunk, 0 derives a power of two from the functions.
+    PackingStrategy packing = PackingStrategy::FirstFit;
+    int splitTokens = -1;  ///< Functions above this many tokens are split, -1 uses the chunk budget, 0 disables it.
+    int splitOverlap = 64; ///< Tokens shared by consecutive fragments of a split function.
+    bool estimateTokens = false; ///< Whether to estimate token counts, tokenizing only near the chunk budget.
+    std::string indexDir; ///< Directory of the binary index to append a segment to, empty to skip it.
+    EmbeddingType indexType = EmbeddingType::Fp32;
+    bool compactIndex = false;
+    bool buildAnn = false;  ///< Whether to build the nearest-neighbor graph over the index.
+    HnswParams annParams;
+    bool stream = false;       ///< Whether to run the bounded-queue streaming pipeline instead of the phases.
+    unsigned stageThreads[3] = {0, 1, 1}; ///< Extract, tokenize and embed threads of the streaming pipeline.
+    size_t queueDepth = 256;   ///< Capacity of each streaming queue.
+    std::string outputPath;    ///< JSONL output of the streaming pipeline, empty for stdout, or the shard file.
+    std::string compileCommandsDir; ///< Directory holding compile_commands.json, empty to parse without flags.
+    std::string pchDir;        ///< Directory for the generated precompiled header, empty to disable it.
+    bool lexical = false;      ///< Whether to find functions with the lexical scan instead of libclang.
+    bool headers = false;      ///< Whether to also extract functions defined in non-system headers, once each.
+    bool verifyLexical = false; ///< Whether to run both extractors and report their differences.
+    bool stats = false;        ///< Whether to print per-stage timings and counters at exit.
+    std::string tracePath;     ///< Chrome trace-event file to write at exit, empty to skip it.
+    std::string daemonSocket;  ///< Unix socket to serve requests on as a resident daemon, empty to run once.
+    size_t warmUnits = 64;     ///< Translation units the daemon keeps alive for reparsing.
+    uint32_t shard = 0;        ///< This process's shard number, see ShardFile.h.
+    uint32_t shardCount = 0;   ///< Number of shards the file list is split into, 0 to process every file.
+    bool merge = false;        ///< Whether to merge shard files instead of processing a tree.
+    std::vector<std::string> shardFiles; ///< Shard files to merge.
+    bool query = false;        ///< Whether to search the index for the functions closest to a text.
+    std::string queryText;     ///< Text whose embedding is searched for.
+    unsigned topK = 10;        ///< Number of functions a query returns.
+    unsigned annEfSearch = 0;  ///< Candidate list size of graph searches, 0 uses the value stored with the graph.
+};
+
+/**
+ * @brief Prints the usage message to stderr.
+ * @param program The name of the program, usually argv[0].
+ */
+void printUsage(const char* program);
+
+/**
+ * @brief Parses the command-line arguments.
+ * @param argc The number of command-line arguments.
+ * @param argv The array of command-line arguments.
+ * @param options The structure that receives the parsed options.
+ * @return True if the arguments were valid, false otherwise.
+ *
+ * The three positional arguments are the model path, the embedding model path and the input path.
+ * Flags may appear anywhere on the command line. When the first argument is "merge", the positional arguments
+ * are the shard files to merge instead. When it is "query", they are the embedding model path and the query text.
+ */
+bool parseOptions(int argc, char** argv, Options& options);
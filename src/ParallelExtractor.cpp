@@ -0,0 +1,243 @@
+/**
+ * @file ParallelExtractor.cpp
+ * @brief This file contains the implementation of the multi-file, multi-threaded function extractor.
+ */
+
+#include "ParallelExtractor.h"
+#include "CompileFlags.h"
+#include "Crawler.h"
+#include "FunctionExtractor.h"
+#include "Hash.h"
+#include "LexicalExtractor.h"
+#include "SourceBuffer.h"
+#include "Trace.h"
+#include <clang-c/Index.h>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Parses a translation unit with the given compiler arguments.
+ * @return The translation unit, or nullptr if libclang could not parse it.
+ */
+static CXTranslationUnit parseTranslationUnit(CXIndex index, const std::string& filename,
+                                              const std::vector<std::string>& arguments) {
+    TRACE_SCOPE("parse");
+    std::vector<const char*> argv;
+    argv.reserve(arguments.size());
+    for (const std::string& arg : arguments) {
+        argv.push_back(arg.c_str());
+    }
+
+    CXTranslationUnit unit = nullptr;
+    if (clang_parseTranslationUnit2(index, filename.c_str(), argv.data(), static_cast<int>(argv.size()), nullptr, 0,
+                                    CXTranslationUnit_None, &unit) != CXError_Success) {
+        return nullptr;
+    }
+    return unit;
+}
+
+/**
+ * @brief Returns whether a translation unit reported a fatal error.
+ */
+static bool hasFatalDiagnostic(CXTranslationUnit unit) {
+    const unsigned count = clang_getNumDiagnostics(unit);
+    for (unsigned i = 0; i < count; ++i) {
+        CXDiagnostic diagnostic = clang_getDiagnostic(unit, i);
+        const bool fatal = clang_getDiagnosticSeverity(diagnostic) == CXDiagnostic_Fatal;
+        clang_disposeDiagnostic(diagnostic);
+        if (fatal) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Parses one file and extracts the functions defined in it.
+ *
+ * The content hash of the file is always computed, since it is part of every function's identity in the
+ * cache, the index and the shard partitioning.
+ *
+ * @param index The libclang index owned by the calling thread.
+ * @param file The source file to parse.
+ * @param source The mapped content of the file.
+ * @param flags The compiler arguments of the file, or nullptr to parse without any.
+ * @param tokenizer The tokenizer used to count tokens, or nullptr to leave the counts at 0.
+ * @param cache The cache of token counts, or nullptr.
+ * @param functionsInfo Receives the functions of the file.
+ * @param splitter Splits functions above its token limit at statement boundaries, or nullptr.
+ * @param definitions The definitions claimed by all units, or nullptr to skip functions defined in headers.
+ * @param headerFunctionsInfo Receives the header functions this unit claimed; required with definitions.
+ * @return False if the translation unit could not be parsed.
+ */
+bool extractFileFunctions(CXIndex index, const fs::path& file, const SourceBuffer& source, const CompileFlags* flags,
+                          const Tokenizer* tokenizer, const FunctionCache* cache,
+                          std::vector<FunctionInfo>& functionsInfo, const FunctionSplitter* splitter,
+                          DefinitionSet* definitions, std::vector<FunctionInfo>* headerFunctionsInfo) {
+    const std::string filename = file.string();
+    CXTranslationUnit unit = nullptr;
+    const std::vector<std::string>* pchArguments = flags ? flags->precompiledArgumentsFor(file) : nullptr;
+    if (pchArguments) {
+        unit = parseTranslationUnit(index, filename, *pchArguments);
+        // A PCH that does not match the file's configuration is a fatal error; parse the headers instead.
+        if (unit && hasFatalDiagnostic(unit)) {
+            clang_disposeTranslationUnit(unit);
+            unit = nullptr;
+        }
+    }
+    if (unit == nullptr) {
+        static const std::vector<std::string> noArguments;
+        unit = parseTranslationUnit(index, filename, flags ? flags->argumentsFor(file) : noArguments);
+    }
+
+    if (unit == nullptr) {
+        return false;
+    }
+
+    visitTranslationUnit(unit, source, tokenizer, cache, functionsInfo, splitter, definitions, headerFunctionsInfo);
+    clang_disposeTranslationUnit(unit);
+    return true;
+}
+
+/**
+ * @brief Extracts the functions defined in the main file of a parsed translation unit.
+ * @param unit The translation unit.
+ * @param source The mapped content of the unit's main file.
+ * @param tokenizer The tokenizer used to count tokens, or nullptr to leave the counts at 0.
+ * @param cache The cache of token counts, or nullptr.
+ * @param functionsInfo Receives the functions of the file.
+ * @param splitter Splits functions above its token limit at statement boundaries, or nullptr.
+ * @param definitions The definitions claimed by all units, or nullptr to skip functions defined in headers.
+ * @param headerFunctionsInfo Receives the header functions this unit claimed; required with definitions.
+ */
+void visitTranslationUnit(CXTranslationUnit unit, const SourceBuffer& source, const Tokenizer* tokenizer,
+                          const FunctionCache* cache, std::vector<FunctionInfo>& functionsInfo,
+                          const FunctionSplitter* splitter, DefinitionSet* definitions,
+                          std::vector<FunctionInfo>* headerFunctionsInfo) {
+    TRACE_SCOPE("visit");
+    HeaderSources headers;
+    VisitorData data;
+    data.tokenizer = tokenizer;
+    data.source = &source;
+    data.functionsInfo = &functionsInfo;
+    data.cache = cache;
+    data.fileHash = hashString(source.text());
+    data.splitter = splitter;
+    data.definitions = headerFunctionsInfo ? definitions : nullptr;
+    data.headerFunctionsInfo = headerFunctionsInfo;
+    data.headers = &headers;
+
+    CXCursor cursor = clang_getTranslationUnitCursor(unit);
+    clang_visitChildren(cursor, visitor, &data);
+}
+
+/**
+ * @brief Extracts function information from many source files concurrently.
+ * @param files The source files to parse, each parsed as its own translation unit.
+ * @param tokenizer The tokenizer shared by all worker threads, or nullptr to leave the counts at 0.
+ * @param numThreads The number of worker threads, 0 selects the hardware concurrency.
+ * @param cache The cache of token counts shared by all workers, or nullptr.
+ * @param flags The compiler arguments of each file, or nullptr.
+ * @param mode Whether to parse with libclang or scan the text lexically.
+ * @param splitter Splits functions above its token limit into fragments, or nullptr.
+ * @param definitions The definitions claimed so far, or nullptr to skip functions defined in headers.
+ * @param fileIndices Receives the input position of each function's file, or nullptr.
+ * @param readThreads Threads reading files ahead of the workers, 0 for none.
+ * @return The functions of all files, in the order of the input file list, followed by the header functions
+ *         sorted by file and offset.
+ */
+FunctionTable extractFunctionsParallel(const std::vector<fs::path>& files, const Tokenizer* tokenizer,
+                                       unsigned numThreads, const FunctionCache* cache, const CompileFlags* flags,
+                                       ExtractMode mode, const FunctionSplitter* splitter,
+                                       DefinitionSet* definitions, std::vector<uint32_t>* fileIndices,
+                                       unsigned readThreads) {
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    numThreads = std::min<unsigned>(numThreads, std::max<size_t>(files.size(), 1));
+
+    std::vector<std::vector<FunctionInfo>> perFile(files.size());
+    std::vector<std::vector<FunctionInfo>> headerFunctions(numThreads);
+    std::atomic<unsigned> nextWorker{0};
+    std::atomic<size_t> nextFile{0};
+    std::mutex logMutex;
+    FilePrefetcher prefetcher(files, readThreads);
+
+    auto worker = [&]() {
+        CXIndex index = mode == ExtractMode::Ast ? clang_createIndex(0, 0) : nullptr;
+        std::vector<FunctionInfo>* headers = definitions ? &headerFunctions[nextWorker++] : nullptr;
+
+        for (size_t i = nextFile++; i < files.size(); i = nextFile++) {
+            prefetcher.consumed(i);
+            const std::string filename = files[i].string();
+            SourceBuffer source;
+            if (!source.open(files[i])) {
+                std::lock_guard<std::mutex> lock(logMutex);
+                std::cerr << "Failed to open file: " << filename << std::endl;
+                continue;
+            }
+
+            if (mode == ExtractMode::Lexical) {
+                extractFileFunctionsLexical(files[i], source, tokenizer, cache, hashString(source.text()), perFile[i],
+                                            splitter);
+            } else if (!extractFileFunctions(index, files[i], source, flags, tokenizer, cache, perFile[i], splitter,
+                                             definitions, headers)) {
+                std::lock_guard<std::mutex> lock(logMutex);
+                std::cerr << "Unable to parse translation unit: " << filename << std::endl;
+            }
+        }
+
+        if (index) {
+            clang_disposeIndex(index);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(numThreads);
+    for (unsigned t = 0; t < numThreads; ++t) {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Which unit claims a header function depends on scheduling, so header functions are ordered by location
+    std::vector<FunctionInfo> headers;
+    for (auto& infos : headerFunctions) {
+        std::move(infos.begin(), infos.end(), std::back_inserter(headers));
+    }
+    std::sort(headers.begin(), headers.end(), [](const FunctionInfo& a, const FunctionInfo& b) {
+        return std::tie(a.filePath, a.startOffset, a.fragment) < std::tie(b.filePath, b.startOffset, b.fragment);
+    });
+
+    size_t total = headers.size();
+    for (const auto& infos : perFile) {
+        total += infos.size();
+    }
+
+    FunctionTable table;
+    table.reserve(total);
+    if (fileIndices) {
+        fileIndices->clear();
+        fileIndices->reserve(total);
+    }
+    for (size_t i = 0; i < perFile.size(); ++i) {
+        table.append(perFile[i]);
+        if (fileIndices) {
+            fileIndices->insert(fileIndices->end(), perFile[i].size(), static_cast<uint32_t>(i));
+        }
+        std::vector<FunctionInfo>().swap(perFile[i]);
+    }
+    table.append(headers);
+    if (fileIndices) {
+        fileIndices->insert(fileIndices->end(), headers.size(), kHeaderFileIndex);
+    }
+    return table;
+}
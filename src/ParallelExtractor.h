@@ -0,0 +1,99 @@
+/**
+ * @file ParallelExtractor.h
+ * @brief This file contains the declaration of the multi-file, multi-threaded function extractor.
+ */
+
+#pragma once
+#include "CompileFlags.h"
+#include "DefinitionSet.h"
+#include "FunctionCache.h"
+#include "FunctionalInfo.h"
+#include "FunctionSplitter.h"
+#include "FunctionTable.h"
+#include "SourceBuffer.h"
+#include "Tokenizer.h"
+#include <clang-c/Index.h>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+/**
+ * @brief How functions are found in a source file.
+ */
+enum class ExtractMode {
+    Ast,     ///< Full libclang parse and AST visit.
+    Lexical, ///< Brace-matching scan of the file text, see LexicalExtractor.h.
+};
+
+/**
+ * @brief File index reported for functions defined in headers, which belong to no single input file.
+ */
+constexpr uint32_t kHeaderFileIndex = UINT32_MAX;
+
+/**
+ * @brief Extracts function information from many source files concurrently.
+ * @param files The source files to parse, each parsed as its own translation unit.
+ * @param tokenizer The tokenizer shared by all worker threads, or nullptr to leave the counts at 0.
+ * @param numThreads The number of worker threads, 0 selects the hardware concurrency.
+ * @param cache The cache of token counts shared by all workers, or nullptr.
+ * @param flags The compiler arguments of each file, or nullptr to parse without any.
+ * @param mode Whether to parse with libclang or scan the text lexically.
+ * @param splitter Splits functions above its token limit into fragments, or nullptr to keep them whole.
+ * @param definitions The definitions claimed so far, or nullptr to skip functions defined in headers. When given,
+ *                    every function defined in a non-system header is recorded by the first unit that reaches it.
+ * @param fileIndices Receives, for every returned function, the position in files of the file it was found in, or
+ *                    kHeaderFileIndex for a header function. nullptr if not needed.
+ * @param readThreads Threads reading files into the page cache ahead of the workers, 0 to let each worker read
+ *                    its own file when it gets to it; see FilePrefetcher.
+ * @return The functions of all files, in the order of the input file list, followed by the header functions
+ *         sorted by file and offset.
+ *
+ * Each worker thread owns a CXIndex and pulls files from a shared counter. A file is visited with its own
+ * memory-mapped SourceBuffer, and the per-file results are appended to the table in input order so that the output
+ * does not depend on thread scheduling.
+ */
+FunctionTable extractFunctionsParallel(const std::vector<std::filesystem::path>& files, const Tokenizer* tokenizer,
+                                       unsigned numThreads, const FunctionCache* cache = nullptr,
+                                       const CompileFlags* flags = nullptr, ExtractMode mode = ExtractMode::Ast,
+                                       const FunctionSplitter* splitter = nullptr,
+                                       DefinitionSet* definitions = nullptr,
+                                       std::vector<uint32_t>* fileIndices = nullptr, unsigned readThreads = 0);
+
+/**
+ * @brief Parses one file and extracts the functions defined in it.
+ * @param index The libclang index owned by the calling thread.
+ * @param file The source file to parse.
+ * @param source The mapped content of the file.
+ * @param flags The compiler arguments of the file, or nullptr to parse without any. When a precompiled header
+ *              applies to the file it is tried first, falling back to a plain parse if it does not load.
+ * @param tokenizer The tokenizer used to count tokens, or nullptr to leave the counts at 0.
+ * @param cache The cache of token counts, or nullptr.
+ * @param functionsInfo Receives the functions of the file.
+ * @param splitter Splits functions above its token limit at statement boundaries, or nullptr to keep them whole.
+ * @param definitions The definitions claimed by all units, or nullptr to skip functions defined in headers.
+ * @param headerFunctionsInfo Receives the header functions this unit claimed; required with definitions.
+ * @return False if the translation unit could not be parsed.
+ */
+bool extractFileFunctions(CXIndex index, const std::filesystem::path& file, const SourceBuffer& source,
+                          const CompileFlags* flags, const Tokenizer* tokenizer, const FunctionCache* cache,
+                          std::vector<FunctionInfo>& functionsInfo, const FunctionSplitter* splitter = nullptr,
+                          DefinitionSet* definitions = nullptr,
+                          std::vector<FunctionInfo>* headerFunctionsInfo = nullptr);
+
+/**
+ * @brief Extracts the functions defined in the main file of a parsed translation unit.
+ * @param unit The translation unit, which is not disposed.
+ * @param source The mapped content of the unit's main file.
+ * @param tokenizer The tokenizer used to count tokens, or nullptr to leave the counts at 0.
+ * @param cache The cache of token counts, or nullptr.
+ * @param functionsInfo Receives the functions of the file.
+ * @param splitter Splits functions above its token limit at statement boundaries, or nullptr to keep them whole.
+ * @param definitions The definitions claimed by all units, or nullptr to skip functions defined in headers.
+ * @param headerFunctionsInfo Receives the header functions this unit claimed; required with definitions.
+ *
+ * Used by extractFileFunctions() and by callers that keep translation units alive to reparse them.
+ */
+void visitTranslationUnit(CXTranslationUnit unit, const SourceBuffer& source, const Tokenizer* tokenizer,
+                          const FunctionCache* cache, std::vector<FunctionInfo>& functionsInfo,
+                          const FunctionSplitter* splitter = nullptr, DefinitionSet* definitions = nullptr,
+                          std::vector<FunctionInfo>* headerFunctionsInfo = nullptr);
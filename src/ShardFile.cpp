@@ -0,0 +1,389 @@
+/**
+ * @file ShardFile.cpp
+ * @brief This file contains the implementation of shard partitioning, shard files and their merge.
+ */
+
+#include "ShardFile.h"
+#include "Hash.h"
+#include "ParallelExtractor.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <tuple>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint32_t kShardMagic = 0x48534343; // "CCSH"
+constexpr uint32_t kShardVersion = 2;
+constexpr uint64_t kShardSeed = 0x5348415244ULL;
+
+/**
+ * @brief Fixed-size fields of one record, followed in the file by the path and signature bytes.
+ */
+struct ShardRecord {
+    uint32_t fileIndex;
+    int32_t startLine;
+    int32_t endLine;
+    int32_t tokenCount;
+    uint32_t startOffset;
+    uint32_t endOffset;
+    int32_t fragment;
+    uint32_t filePathLength;
+    uint64_t fileHash;
+    uint64_t extentHash;
+    uint64_t parentHash;
+    uint32_t signatureLength;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(ShardRecord) == 64, "ShardRecord is part of the on-disk format");
+
+/**
+ * @brief The content of one shard file.
+ */
+struct ShardContents {
+    ShardHeader header{};
+    std::vector<FunctionInfo> functions;
+    std::vector<uint32_t> fileIndices;
+    std::vector<float> embeddings;
+    std::string root;
+    std::vector<std::string> files;
+};
+
+void writeString(std::ostream& out, const std::string& text) {
+    const uint32_t length = static_cast<uint32_t>(text.size());
+    out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    out.write(text.data(), length);
+}
+
+bool readString(std::istream& in, std::string& text, uint64_t fileSize) {
+    uint32_t length = 0;
+    if (!in.read(reinterpret_cast<char*>(&length), sizeof(length)) || length > fileSize) {
+        in.setstate(std::ios::failbit);
+        return false;
+    }
+    text.resize(length);
+    return static_cast<bool>(in.read(text.data(), length));
+}
+
+std::string relativeName(const fs::path& file, const fs::path& root) {
+    const fs::path relative = file.lexically_relative(root);
+    return relative.empty() ? file.generic_string() : relative.generic_string();
+}
+
+bool readShardFile(const fs::path& path, ShardContents& contents) {
+    std::ifstream in(path, std::ios::binary);
+    ShardHeader& header = contents.header;
+    if (!in || !in.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != kShardMagic ||
+        header.version != kShardVersion || header.shard >= header.shardCount) {
+        std::cerr << "Not a shard file: " << path << std::endl;
+        return false;
+    }
+
+    // Check the counts against the file size before sizing anything by them: every record, embedding row and
+    // string length prefix takes bytes in the file.
+    std::error_code error;
+    const uint64_t fileSize = fs::file_size(path, error);
+    uint64_t remaining = error || fileSize < sizeof(header) ? 0 : fileSize - sizeof(header);
+    const uint64_t rowBytes = static_cast<uint64_t>(header.dimension) * sizeof(float);
+    bool fits = !error && header.count <= remaining / sizeof(ShardRecord);
+    if (fits) {
+        remaining -= header.count * sizeof(ShardRecord);
+        fits = rowBytes == 0 || header.count <= remaining / rowBytes;
+    }
+    if (fits) {
+        remaining -= header.count * rowBytes;
+        fits = (static_cast<uint64_t>(header.fileCount) + 1) * sizeof(uint32_t) <= remaining;
+    }
+    if (!fits) {
+        std::cerr << "Truncated shard file: " << path << std::endl;
+        return false;
+    }
+
+    contents.functions.resize(header.count);
+    contents.fileIndices.resize(header.count);
+    for (uint64_t i = 0; i < header.count; ++i) {
+        ShardRecord record;
+        if (!in.read(reinterpret_cast<char*>(&record), sizeof(record)) || record.filePathLength > fileSize ||
+            record.signatureLength > fileSize) {
+            in.setstate(std::ios::failbit);
+            break;
+        }
+        FunctionInfo& info = contents.functions[i];
+        info.filePath.resize(record.filePathLength);
+        info.signature.resize(record.signatureLength);
+        in.read(info.filePath.data(), record.filePathLength);
+        in.read(info.signature.data(), record.signatureLength);
+        info.startLine = record.startLine;
+        info.endLine = record.endLine;
+        info.tokenCount = record.tokenCount;
+        info.startOffset = record.startOffset;
+        info.endOffset = record.endOffset;
+        info.fileHash = record.fileHash;
+        info.extentHash = record.extentHash;
+        info.parentHash = record.parentHash;
+        info.fragment = record.fragment;
+        contents.fileIndices[i] = record.fileIndex;
+    }
+
+    contents.embeddings.resize(header.count * header.dimension);
+    in.read(reinterpret_cast<char*>(contents.embeddings.data()),
+            static_cast<std::streamsize>(contents.embeddings.size() * sizeof(float)));
+    readString(in, contents.root, fileSize);
+    contents.files.resize(header.fileCount);
+    for (std::string& file : contents.files) {
+        if (!readString(in, file, fileSize)) {
+            break;
+        }
+    }
+    if (!in) {
+        std::cerr << "Truncated shard file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+/**
+ * @brief Parses a shard specification.
+ * @param text The text to parse, "i/N".
+ * @param shard Receives i.
+ * @param shardCount Receives N.
+ * @return True if the text was a valid specification.
+ */
+bool parseShardSpec(const char* text, uint32_t& shard, uint32_t& shardCount) {
+    char* end = nullptr;
+    const unsigned long index = std::strtoul(text, &end, 10);
+    if (end == text || *end != '/') {
+        return false;
+    }
+    const char* countText = end + 1;
+    const unsigned long count = std::strtoul(countText, &end, 10);
+    if (end == countText || *end != '\0' || count == 0 || index >= count || count > UINT32_MAX) {
+        return false;
+    }
+    shard = static_cast<uint32_t>(index);
+    shardCount = static_cast<uint32_t>(count);
+    return true;
+}
+
+/**
+ * @brief Selects the files that belong to one shard.
+ * @param files The full, sorted file list.
+ * @param root The input path.
+ * @param shard The shard number.
+ * @param shardCount The number of shards.
+ * @param positions Receives the position in files of every selected file.
+ * @return The selected files, in list order.
+ */
+std::vector<fs::path> selectShardFiles(const std::vector<fs::path>& files, const fs::path& root, uint32_t shard,
+                                       uint32_t shardCount, std::vector<uint32_t>& positions) {
+    std::vector<fs::path> selected;
+    positions.clear();
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (hashString(relativeName(files[i], root), kShardSeed) % shardCount == shard) {
+            selected.push_back(files[i]);
+            positions.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    return selected;
+}
+
+/**
+ * @brief Hashes the full file list, relative to the input path.
+ * @param files The full, sorted file list.
+ * @param root The input path.
+ * @return The hash stored in every shard file.
+ */
+uint64_t hashFileList(const std::vector<fs::path>& files, const fs::path& root) {
+    uint64_t hash = hashMix(files.size());
+    for (const auto& file : files) {
+        hash = hashCombine(hash, hashString(relativeName(file, root)));
+    }
+    return hash;
+}
+
+/**
+ * @brief Writes one shard file.
+ *
+ * The file is written under a temporary name and renamed into place, so a merge never reads a partial shard.
+ *
+ * @param path The shard file path.
+ * @param header The shard number, count and file list hash.
+ * @param functions The functions of the shard.
+ * @param fileIndices The position of each function's file in the full list, or kHeaderFileIndex.
+ * @param embeddings A row-major matrix with one row per function, or nullptr.
+ * @param dimension The number of embedding dimensions.
+ * @param root The input path.
+ * @param files The input files of the shard.
+ * @return True on success.
+ */
+bool writeShardFile(const fs::path& path, ShardHeader header, const FunctionTable& functions,
+                    const std::vector<uint32_t>& fileIndices, const float* embeddings, size_t dimension,
+                    const fs::path& root, const std::vector<fs::path>& files) {
+    TRACE_SCOPE("write_shard");
+    header.magic = kShardMagic;
+    header.version = kShardVersion;
+    header.count = functions.size();
+    header.dimension = embeddings ? static_cast<uint32_t>(dimension) : 0;
+    header.fileCount = static_cast<uint32_t>(files.size());
+
+    fs::path tempPath = path;
+    tempPath += ".tmp." + std::to_string(getpid());
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to create shard file: " << tempPath << std::endl;
+        return false;
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (size_t i = 0; i < functions.size(); ++i) {
+        ShardRecord record{};
+        record.fileIndex = fileIndices[i];
+        record.startLine = functions.startLine(i);
+        record.endLine = functions.endLine(i);
+        record.tokenCount = functions.tokenCount(i);
+        record.startOffset = functions.startOffset(i);
+        record.endOffset = functions.endOffset(i);
+        record.fragment = functions.fragment(i);
+        record.filePathLength = static_cast<uint32_t>(functions.filePath(i).size());
+        record.fileHash = functions.fileHash(i);
+        record.extentHash = functions.extentHash(i);
+        record.parentHash = functions.parentHash(i);
+        record.signatureLength = static_cast<uint32_t>(functions.signature(i).size());
+        out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        out.write(functions.filePath(i).data(), record.filePathLength);
+        out.write(functions.signature(i).data(), record.signatureLength);
+    }
+    if (header.dimension > 0) {
+        out.write(reinterpret_cast<const char*>(embeddings),
+                  static_cast<std::streamsize>(functions.size() * dimension * sizeof(float)));
+    }
+    writeString(out, root.string());
+    for (const auto& file : files) {
+        writeString(out, file.string());
+    }
+
+    out.close();
+    std::error_code ec;
+    if (!out) {
+        fs::remove(tempPath, ec);
+        std::cerr << "Failed to write shard file: " << path << std::endl;
+        return false;
+    }
+    fs::rename(tempPath, path, ec);
+    return !ec;
+}
+
+/**
+ * @brief Merges a complete set of shard files.
+ *
+ * Every input file belongs to exactly one shard, so its functions are taken from that shard in their extracted
+ * order and placed by the file's position in the full list. Header functions are claimed independently by every
+ * shard whose units include the header; they are ordered by location like in a single run, and repeated
+ * locations are kept once.
+ *
+ * @param paths The shard files.
+ * @param functions Receives the merged functions.
+ * @param embeddings Receives one row per function, or stays empty.
+ * @param dimension Receives the number of embedding dimensions.
+ * @param coveredFiles Receives the input files of all shards, or nullptr.
+ * @param root Receives the input path of the shards, or nullptr.
+ * @return False if a file could not be read or the shards do not form one complete set.
+ */
+bool mergeShardFiles(const std::vector<fs::path>& paths, FunctionTable& functions, std::vector<float>& embeddings,
+                     size_t& dimension, std::vector<std::string>* coveredFiles, std::string* root) {
+    TRACE_SCOPE("merge_shards");
+    std::vector<ShardContents> shards(paths.size());
+    for (size_t s = 0; s < paths.size(); ++s) {
+        if (!readShardFile(paths[s], shards[s])) {
+            return false;
+        }
+    }
+    if (shards.empty()) {
+        std::cerr << "No shard files to merge" << std::endl;
+        return false;
+    }
+
+    const ShardHeader& first = shards.front().header;
+    std::vector<bool> seen(first.shardCount, false);
+    for (size_t s = 0; s < shards.size(); ++s) {
+        const ShardHeader& header = shards[s].header;
+        if (header.shardCount != first.shardCount || header.fileListHash != first.fileListHash ||
+            header.dimension != first.dimension) {
+            std::cerr << "Shard " << paths[s] << " belongs to a different run than " << paths[0] << std::endl;
+            return false;
+        }
+        // File paths are stored as the shard saw them, so shards of the same tree mounted elsewhere would hash
+        // equal but mix paths.
+        if (shards[s].root != shards.front().root) {
+            std::cerr << "Shard " << paths[s] << " was written for " << shards[s].root << ", not "
+                      << shards.front().root << std::endl;
+            return false;
+        }
+        if (seen[header.shard]) {
+            std::cerr << "Shard " << header.shard << "/" << header.shardCount << " is given twice" << std::endl;
+            return false;
+        }
+        seen[header.shard] = true;
+    }
+    if (shards.size() != first.shardCount) {
+        std::cerr << "Only " << shards.size() << " of " << first.shardCount << " shards were given" << std::endl;
+        return false;
+    }
+
+    // (shard, row) of every function that is kept, input-file functions first, then header functions
+    using RowRef = std::pair<uint32_t, uint32_t>;
+    std::vector<RowRef> rows;
+    std::vector<RowRef> headerRows;
+    for (size_t s = 0; s < shards.size(); ++s) {
+        for (size_t i = 0; i < shards[s].functions.size(); ++i) {
+            RowRef ref(static_cast<uint32_t>(s), static_cast<uint32_t>(i));
+            (shards[s].fileIndices[i] == kHeaderFileIndex ? headerRows : rows).push_back(ref);
+        }
+    }
+
+    auto fileIndex = [&](const RowRef& ref) { return shards[ref.first].fileIndices[ref.second]; };
+    std::stable_sort(rows.begin(), rows.end(),
+                     [&](const RowRef& a, const RowRef& b) { return fileIndex(a) < fileIndex(b); });
+
+    auto location = [&](const RowRef& ref) {
+        const FunctionInfo& info = shards[ref.first].functions[ref.second];
+        return std::tie(info.filePath, info.startOffset, info.fragment);
+    };
+    std::stable_sort(headerRows.begin(), headerRows.end(),
+                     [&](const RowRef& a, const RowRef& b) { return location(a) < location(b); });
+    headerRows.erase(std::unique(headerRows.begin(), headerRows.end(),
+                                 [&](const RowRef& a, const RowRef& b) { return location(a) == location(b); }),
+                     headerRows.end());
+    rows.insert(rows.end(), headerRows.begin(), headerRows.end());
+
+    dimension = first.dimension;
+    functions = FunctionTable();
+    functions.reserve(rows.size());
+    embeddings.clear();
+    embeddings.reserve(rows.size() * dimension);
+    for (const RowRef& ref : rows) {
+        const ShardContents& shard = shards[ref.first];
+        functions.append(shard.functions[ref.second]);
+        const auto row = shard.embeddings.begin() + static_cast<ptrdiff_t>(ref.second * dimension);
+        embeddings.insert(embeddings.end(), row, row + static_cast<ptrdiff_t>(dimension));
+    }
+
+    if (coveredFiles) {
+        coveredFiles->clear();
+        for (const ShardContents& shard : shards) {
+            coveredFiles->insert(coveredFiles->end(), shard.files.begin(), shard.files.end());
+        }
+    }
+    if (root) {
+        *root = shards.front().root;
+    }
+    return true;
+}
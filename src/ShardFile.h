@@ -0,0 +1,103 @@
+/**
+ * @file ShardFile.h
+ * @brief This file contains the declarations of shard partitioning and the partial outputs that shards exchange.
+ *
+ * A large tree can be processed by N independent processes, on one machine or several. Every process collects the
+ * same sorted file list and keeps the files whose stable path hash falls into its shard; it extracts, counts and
+ * embeds them and writes a shard file instead of packing chunks. Merging the N shard files reproduces the function
+ * table of a single-process run, row for row, after which chunk packing and index updates run once over the whole.
+ *
+ * A shard file is a small binary stream:
+ *
+ * - ShardHeader: magic, version, shard number and count, a hash of the full file list, record count, dimension.
+ * - Records: per function, the position of its file in the full list (kHeaderFileIndex for header functions),
+ *   the fixed-size fields of FunctionInfo, and its length-prefixed file path and signature.
+ * - Embeddings: a row-major fp32 matrix with one row per record, present if the dimension is not 0.
+ * - Files: the length-prefixed input path, then the length-prefixed path of every input file of the shard, so
+ *   the merged index update knows which files the run covered.
+ */
+
+#pragma once
+#include "FunctionTable.h"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Header at the start of every shard file.
+ */
+struct ShardHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t shard;
+    uint32_t shardCount;
+    uint64_t fileListHash; ///< Hash of the full file list, so shards of different trees are never merged.
+    uint64_t count;
+    uint32_t dimension;
+    uint32_t fileCount; ///< Number of input files of the shard.
+};
+
+/**
+ * @brief Parses a shard specification.
+ * @param text The text to parse, "i/N" with 0 <= i < N.
+ * @param shard Receives i.
+ * @param shardCount Receives N.
+ * @return True if the text was a valid specification.
+ */
+bool parseShardSpec(const char* text, uint32_t& shard, uint32_t& shardCount);
+
+/**
+ * @brief Selects the files that belong to one shard.
+ * @param files The full, sorted file list.
+ * @param root The input path, which file paths are hashed relative to.
+ * @param shard The shard number.
+ * @param shardCount The number of shards.
+ * @param positions Receives the position in files of every selected file.
+ * @return The selected files, in list order.
+ *
+ * Files are assigned by a hash of their path relative to root, so the partition is the same on every machine that
+ * checks the tree out, wherever it is mounted, and adding a file does not move any other file to another shard.
+ */
+std::vector<std::filesystem::path> selectShardFiles(const std::vector<std::filesystem::path>& files,
+                                                    const std::filesystem::path& root, uint32_t shard,
+                                                    uint32_t shardCount, std::vector<uint32_t>& positions);
+
+/**
+ * @brief Hashes the full file list, relative to the input path.
+ * @param files The full, sorted file list.
+ * @param root The input path.
+ * @return The hash stored in every shard file.
+ */
+uint64_t hashFileList(const std::vector<std::filesystem::path>& files, const std::filesystem::path& root);
+
+/**
+ * @brief Writes one shard file.
+ * @param path The shard file path.
+ * @param header The shard number, count and file list hash; the count and dimension are filled in.
+ * @param functions The functions of the shard.
+ * @param fileIndices For every function, the position of its file in the full list, or kHeaderFileIndex.
+ * @param embeddings A row-major matrix with one row per function, or nullptr if dimension is 0.
+ * @param dimension The number of embedding dimensions.
+ * @param root The input path.
+ * @param files The input files of the shard.
+ * @return True on success.
+ */
+bool writeShardFile(const std::filesystem::path& path, ShardHeader header, const FunctionTable& functions,
+                    const std::vector<uint32_t>& fileIndices, const float* embeddings, size_t dimension,
+                    const std::filesystem::path& root, const std::vector<std::filesystem::path>& files);
+
+/**
+ * @brief Merges a complete set of shard files into the table a single-process run would have produced.
+ * @param paths The shard files, in any order. Every shard of the set must be given exactly once.
+ * @param functions Receives the functions: those of input files in file list order, followed by the header
+ *                  functions sorted by file and offset, each header function kept once.
+ * @param embeddings Receives one row per function, or stays empty if the shards carry no embeddings.
+ * @param dimension Receives the number of embedding dimensions.
+ * @param coveredFiles Receives the input files of all shards, or nullptr.
+ * @param root Receives the input path of the shards, or nullptr.
+ * @return False if a file could not be read or the shards do not form one complete set of the same input path.
+ */
+bool mergeShardFiles(const std::vector<std::filesystem::path>& paths, FunctionTable& functions,
+                     std::vector<float>& embeddings, size_t& dimension,
+                     std::vector<std::string>* coveredFiles = nullptr, std::string* root = nullptr);
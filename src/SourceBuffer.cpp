@@ -0,0 +1,97 @@
+/**
+ * @file SourceBuffer.cpp
+ * @brief This file contains the implementation of the SourceBuffer class.
+ */
+
+#include "SourceBuffer.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstring>
+
+/**
+ * @brief Maps a source file and builds its line index.
+ * @param path The file to open.
+ * @return True on success, false if the file could not be mapped.
+ */
+bool SourceBuffer::open(const std::filesystem::path& path) {
+    TRACE_SCOPE("read");
+    lineOffsets_.clear();
+    if (!file_.open(path)) {
+        return false;
+    }
+    traceCount(TraceCounter::Files);
+    traceCount(TraceCounter::Bytes, static_cast<int64_t>(file_.size()));
+
+    const char* begin = file_.data();
+    const char* end = begin + file_.size();
+    if (begin == end) {
+        return true;
+    }
+
+    lineOffsets_.push_back(0);
+    for (const char* p = begin; (p = static_cast<const char*>(std::memchr(p, '\n', end - p))) != nullptr;) {
+        ++p;
+        if (p == end) {
+            break;
+        }
+        lineOffsets_.push_back(static_cast<size_t>(p - begin));
+    }
+    return true;
+}
+
+/**
+ * @brief Returns a line without its line terminator.
+ * @param lineNumber The 1-based line number.
+ * @return The line content, or an empty view if the line does not exist.
+ */
+std::string_view SourceBuffer::line(size_t lineNumber) const {
+    if (lineNumber == 0 || lineNumber > lineOffsets_.size()) {
+        return {};
+    }
+
+    size_t begin = lineOffsets_[lineNumber - 1];
+    size_t end = lineNumber < lineOffsets_.size() ? lineOffsets_[lineNumber] : file_.size();
+    std::string_view content = slice(begin, end);
+    if (!content.empty() && content.back() == '\n') {
+        content.remove_suffix(1);
+    }
+    if (!content.empty() && content.back() == '\r') {
+        content.remove_suffix(1);
+    }
+    return content;
+}
+
+/**
+ * @brief Converts a 1-based line and column into a byte offset.
+ * @param lineNumber The 1-based line number.
+ * @param column The 1-based column, counted in bytes.
+ * @return The byte offset, clamped to the end of the file.
+ */
+size_t SourceBuffer::offsetOf(size_t lineNumber, size_t column) const {
+    if (lineNumber == 0 || lineNumber > lineOffsets_.size()) {
+        return file_.size();
+    }
+    return std::min(lineOffsets_[lineNumber - 1] + (column > 0 ? column - 1 : 0), file_.size());
+}
+
+/**
+ * @brief Returns the line that contains a byte offset.
+ * @param offset The byte offset.
+ * @return The 1-based line number, or 0 if the file is empty.
+ */
+size_t SourceBuffer::lineOf(size_t offset) const {
+    return static_cast<size_t>(std::upper_bound(lineOffsets_.begin(), lineOffsets_.end(), offset) -
+                               lineOffsets_.begin());
+}
+
+/**
+ * @brief Returns the bytes in the half-open range [begin, end).
+ * @param begin The first byte offset.
+ * @param end One past the last byte offset.
+ * @return The text of the range, clamped to the file bounds.
+ */
+std::string_view SourceBuffer::slice(size_t begin, size_t end) const {
+    end = std::min(end, file_.size());
+    begin = std::min(begin, end);
+    return file_.view().substr(begin, end - begin);
+}
@@ -0,0 +1,70 @@
+/**
+ * @file SourceBuffer.h
+ * @brief This file contains the declaration of the SourceBuffer class.
+ *
+ * A SourceBuffer gives zero-copy access to a source file. The file is memory-mapped, and a line-offset index
+ * is built once so that lines and byte ranges can be returned as std::string_view without any allocation.
+ */
+
+#pragma once
+#include "MappedFile.h"
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Memory-mapped source file with a precomputed line-offset index.
+ */
+class SourceBuffer {
+public:
+    /**
+     * @brief Maps a source file and builds its line index.
+     * @param path The file to open.
+     * @return True on success, false if the file could not be mapped.
+     */
+    bool open(const std::filesystem::path& path);
+
+    /**
+     * @brief Returns the whole file content.
+     */
+    std::string_view text() const { return file_.view(); }
+
+    /**
+     * @brief Returns the number of lines in the file.
+     */
+    size_t lineCount() const { return lineOffsets_.size(); }
+
+    /**
+     * @brief Returns a line without its line terminator.
+     * @param lineNumber The 1-based line number.
+     * @return The line content, or an empty view if the line does not exist.
+     */
+    std::string_view line(size_t lineNumber) const;
+
+    /**
+     * @brief Converts a 1-based line and column into a byte offset.
+     * @param lineNumber The 1-based line number.
+     * @param column The 1-based column, counted in bytes.
+     * @return The byte offset, clamped to the end of the file.
+     */
+    size_t offsetOf(size_t lineNumber, size_t column) const;
+
+    /**
+     * @brief Returns the line that contains a byte offset.
+     * @param offset The byte offset.
+     * @return The 1-based line number, or 0 if the file is empty.
+     */
+    size_t lineOf(size_t offset) const;
+
+    /**
+     * @brief Returns the bytes in the half-open range [begin, end).
+     * @param begin The first byte offset.
+     * @param end One past the last byte offset.
+     * @return The text of the range, clamped to the file bounds.
+     */
+    std::string_view slice(size_t begin, size_t end) const;
+
+private:
+    MappedFile file_;
+    std::vector<size_t> lineOffsets_;
+};
@@ -0,0 +1,457 @@
+/**
+ * @file StreamingPipeline.cpp
+ * @brief This file contains the implementation of the streaming pipeline.
+ */
+
+#include "StreamingPipeline.h"
+#include "BoundedQueue.h"
+#include "Crawler.h"
+#include "EmbeddingEngine.h"
+#include "FunctionCache.h"
+#include "FunctionTable.h"
+#include "Hash.h"
+#include "JsonUtil.h"
+#include "LexicalExtractor.h"
+#include "ParallelExtractor.h"
+#include "SourceBuffer.h"
+#include "Tokenizer.h"
+#include <clang-c/Index.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using SharedSource = std::shared_ptr<const SourceBuffer>;
+
+/**
+ * @brief The functions of one file, with the mapping their text refers to.
+ */
+struct FileBatch {
+    SharedSource source;
+    std::vector<FunctionInfo> functions;
+};
+
+/**
+ * @brief A closed chunk travelling from the packer to the sink.
+ */
+struct StreamChunk {
+    uint64_t id = 0;
+    int tokenCount = 0;
+    std::vector<FunctionInfo> functions;
+    std::vector<SharedSource> sources;
+    std::vector<float> embeddings; ///< One row per function when embedding is enabled.
+};
+
+/**
+ * @brief Runs a stage on several threads; the last thread to finish closes the stage's output queue.
+ */
+template <typename Output, typename Fn>
+std::vector<std::thread> startStage(unsigned numThreads, BoundedQueue<Output>& output, Fn fn) {
+    auto remaining = std::make_shared<std::atomic<unsigned>>(numThreads);
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < numThreads; ++t) {
+        threads.emplace_back([remaining, &output, fn]() {
+            fn();
+            if (remaining->fetch_sub(1) == 1) {
+                output.close();
+            }
+        });
+    }
+    return threads;
+}
+
+/**
+ * @brief Online best-fit packer that closes chunks once they are nearly full.
+ *
+ * The packer keeps at most maxOpen chunks, ordered by remaining capacity. A function goes to the open chunk
+ * it fills most tightly. A chunk closes when less than budget / 32 tokens remain, when the open set is full
+ * and it is the fullest chunk, or at the end of the stream.
+ */
+class OnlinePacker {
+public:
+    OnlinePacker(int budget, size_t maxOpen, BoundedQueue<StreamChunk>& output)
+        : budget_(budget), maxOpen_(std::max<size_t>(maxOpen, 1)),
+          closeThreshold_(std::max(1, budget / 32)), output_(output) {}
+
+    void add(FunctionInfo info, const SharedSource& source) {
+        const int need = info.tokenCount;
+        if (need >= budget_) {
+            StreamChunk chunk;
+            append(chunk, std::move(info), source);
+            emit(std::move(chunk));
+            return;
+        }
+
+        size_t slot;
+        auto it = byRemaining_.lower_bound({need, 0});
+        if (it != byRemaining_.end()) {
+            slot = it->second;
+            byRemaining_.erase(it);
+        } else {
+            slot = nextSlot_++;
+        }
+
+        StreamChunk& chunk = open_[slot];
+        append(chunk, std::move(info), source);
+        const int remaining = budget_ - chunk.tokenCount;
+        if (remaining < closeThreshold_) {
+            close(slot);
+            return;
+        }
+        byRemaining_.insert({remaining, slot});
+
+        if (open_.size() > maxOpen_) {
+            const size_t fullest = byRemaining_.begin()->second;
+            byRemaining_.erase(byRemaining_.begin());
+            close(fullest);
+        }
+    }
+
+    void finish() {
+        while (!open_.empty()) {
+            close(open_.begin()->first);
+        }
+        byRemaining_.clear();
+    }
+
+    size_t emitted() const { return nextId_; }
+
+private:
+    static void append(StreamChunk& chunk, FunctionInfo info, const SharedSource& source) {
+        chunk.tokenCount += info.tokenCount;
+        chunk.functions.push_back(std::move(info));
+        chunk.sources.push_back(source);
+    }
+
+    void close(size_t slot) {
+        auto it = open_.find(slot);
+        StreamChunk chunk = std::move(it->second);
+        open_.erase(it);
+        emit(std::move(chunk));
+    }
+
+    void emit(StreamChunk chunk) {
+        chunk.id = nextId_++;
+        output_.push(std::move(chunk));
+    }
+
+    int budget_;
+    size_t maxOpen_;
+    int closeThreshold_;
+    BoundedQueue<StreamChunk>& output_;
+    std::map<size_t, StreamChunk> open_;
+    std::set<std::pair<int, size_t>> byRemaining_;
+    size_t nextSlot_ = 0;
+    uint64_t nextId_ = 0;
+};
+
+/**
+ * @brief Writes closed chunks as JSONL and, optionally, as binary index segments.
+ */
+class ChunkSink {
+public:
+    ChunkSink(std::ostream& out, EmbeddingIndex* index, EmbeddingType indexType, size_t dimension)
+        : out_(out), index_(index), indexType_(indexType), dimension_(dimension) {}
+
+    bool write(const StreamChunk& chunk) {
+        out_ << "{\"chunk\":" << chunk.id << ",\"tokens\":" << chunk.tokenCount << ",\"functions\":[";
+        for (size_t i = 0; i < chunk.functions.size(); ++i) {
+            const FunctionInfo& info = chunk.functions[i];
+            out_ << (i ? "," : "") << "{\"file\":";
+            writeJsonString(out_, info.filePath);
+            out_ << ",\"signature\":";
+            writeJsonString(out_, info.signature);
+            out_ << ",\"startLine\":" << info.startLine << ",\"endLine\":" << info.endLine
+                 << ",\"tokens\":" << info.tokenCount;
+            if (info.fragment >= 0) {
+                char parent[17];
+                std::snprintf(parent, sizeof(parent), "%016" PRIx64, info.parentHash);
+                out_ << ",\"parent\":\"" << parent << "\",\"fragment\":" << info.fragment;
+            }
+            if (!chunk.embeddings.empty()) {
+                out_ << ",\"embedding\":[";
+                for (size_t d = 0; d < dimension_; ++d) {
+                    out_ << (d ? "," : "") << chunk.embeddings[i * dimension_ + d];
+                }
+                out_ << "]";
+            }
+            out_ << "}";
+        }
+        out_ << "]}\n";
+
+        if (index_) {
+            pendingFunctions_.append(chunk.functions);
+            pendingEmbeddings_.insert(pendingEmbeddings_.end(), chunk.embeddings.begin(), chunk.embeddings.end());
+            if (pendingFunctions_.size() >= kSegmentFunctions && !flush()) {
+                return false;
+            }
+        }
+        return static_cast<bool>(out_);
+    }
+
+    bool flush() {
+        out_.flush();
+        if (!index_ || pendingFunctions_.empty()) {
+            return static_cast<bool>(out_);
+        }
+        const bool embedded = pendingEmbeddings_.size() == pendingFunctions_.size() * dimension_ && dimension_ > 0;
+        const bool ok = index_->append(pendingFunctions_, embedded ? pendingEmbeddings_.data() : nullptr,
+                                       embedded ? dimension_ : 0, indexType_);
+        pendingFunctions_.clear();
+        pendingEmbeddings_.clear();
+        return ok && out_;
+    }
+
+private:
+    static constexpr size_t kSegmentFunctions = 65536;
+
+    std::ostream& out_;
+    EmbeddingIndex* index_;
+    EmbeddingType indexType_;
+    size_t dimension_;
+    FunctionTable pendingFunctions_;
+    std::vector<float> pendingEmbeddings_;
+};
+
+/**
+ * @brief Embeds the functions of a chunk, reusing and filling the cache.
+ */
+void embedChunk(StreamChunk& chunk, EmbeddingEngine& engine, const Tokenizer& tokenizer, const FunctionCache* cache,
+                std::vector<std::vector<llama_token>>& tokens, std::vector<float>& output) {
+    const size_t n_embd = engine.dimension();
+    chunk.embeddings.assign(chunk.functions.size() * n_embd, 0.0f);
+
+    std::vector<size_t> pending;
+    std::vector<std::string_view> texts;
+    for (size_t i = 0; i < chunk.functions.size(); ++i) {
+        const FunctionInfo& info = chunk.functions[i];
+        CacheEntry entry;
+        if (cache && cache->lookup({info.fileHash, info.extentHash}, entry) && entry.embedding.size() == n_embd) {
+            std::copy(entry.embedding.begin(), entry.embedding.end(), chunk.embeddings.begin() + i * n_embd);
+            continue;
+        }
+        pending.push_back(i);
+        texts.push_back(chunk.sources[i]->slice(info.startOffset, info.endOffset));
+    }
+    if (pending.empty()) {
+        return;
+    }
+
+    tokenizer.tokenize_batch(texts, tokens);
+    const bool embedded = engine.embed(tokens, output);
+    if (!embedded) {
+        std::cerr << "Failed to embed " << pending.size() << " functions of chunk " << chunk.id
+                  << "; they are not cached" << std::endl;
+    }
+    for (size_t k = 0; k < pending.size(); ++k) {
+        const size_t i = pending[k];
+        std::copy(output.begin() + k * n_embd, output.begin() + (k + 1) * n_embd, chunk.embeddings.begin() + i * n_embd);
+        if (cache && embedded) {
+            CacheEntry entry;
+            entry.tokenCount = chunk.functions[i].tokenCount;
+            entry.embedding.assign(output.begin() + k * n_embd, output.begin() + (k + 1) * n_embd);
+            cache->store({chunk.functions[i].fileHash, chunk.functions[i].extentHash}, entry);
+        }
+    }
+}
+
+/**
+ * @brief Sends the header functions one unit claimed downstream, one batch per header.
+ *
+ * Each batch maps its header again, so the functions keep a source alive for the later stages after the unit
+ * that claimed them is gone.
+ */
+void pushHeaderBatches(std::vector<FunctionInfo>& functions, BoundedQueue<FileBatch>& output) {
+    std::stable_sort(functions.begin(), functions.end(),
+                     [](const FunctionInfo& a, const FunctionInfo& b) { return a.filePath < b.filePath; });
+    for (size_t begin = 0, end = 0; begin < functions.size(); begin = end) {
+        while (end < functions.size() && functions[end].filePath == functions[begin].filePath) {
+            ++end;
+        }
+        auto source = std::make_shared<SourceBuffer>();
+        if (!source->open(functions[begin].filePath)) {
+            continue;
+        }
+        FileBatch batch;
+        batch.source = std::move(source);
+        batch.functions.assign(std::make_move_iterator(functions.begin() + begin),
+                               std::make_move_iterator(functions.begin() + end));
+        output.push(std::move(batch));
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Runs the streaming pipeline over a list of files.
+ *
+ * Stages and their queues:
+ *   extract (N threads) → FileBatch → tokenize (N threads) → FileBatch → pack (1 thread) → StreamChunk
+ *   → embed (N threads, optional) → StreamChunk → sink (calling thread).
+ *
+ * @return False if the output could not be written.
+ */
+bool runStreamingPipeline(const std::vector<fs::path>& files, const Tokenizer& tokenizer, llama_model* embeddingModel,
+                          const FunctionCache* cache, const StreamingOptions& options, StreamingStats& stats) {
+    const unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned extractThreads = options.extractThreads ? options.extractThreads : hardwareThreads;
+    const unsigned tokenizeThreads = std::max(1u, options.tokenizeThreads);
+    const bool embed = options.embed && embeddingModel;
+    const unsigned embedThreads = embed ? std::max(1u, options.embedThreads) : 0;
+
+    std::ofstream outputFile;
+    if (!options.outputPath.empty() && options.outputPath != "-") {
+        outputFile.open(options.outputPath, std::ios::trunc);
+        if (!outputFile) {
+            std::cerr << "Failed to open output file: " << options.outputPath << std::endl;
+            return false;
+        }
+    }
+    std::ostream& out = outputFile.is_open() ? outputFile : std::cout;
+
+    // The run's segments are written as chunks close, so the files it covers, and the tombstones of files that
+    // are gone, go into a record-less segment ahead of them that does not supersede their records
+    EmbeddingIndex index;
+    if (!options.indexDir.empty() &&
+        (!index.open(options.indexDir) ||
+         !index.append(FunctionTable(), nullptr, 0, options.indexType,
+                       std::vector<std::string>(files.begin(), files.end()), options.inputPath))) {
+        return false;
+    }
+
+    BoundedQueue<FileBatch> parsed(options.queueDepth);
+    BoundedQueue<FileBatch> counted(options.queueDepth);
+    BoundedQueue<StreamChunk> packed(options.queueDepth);
+    BoundedQueue<StreamChunk> embedded(options.queueDepth);
+    BoundedQueue<StreamChunk>& sinkInput = embed ? embedded : packed;
+
+    std::atomic<size_t> nextFile{0};
+    std::atomic<size_t> fileCount{0};
+    std::atomic<size_t> functionCount{0};
+    std::mutex logMutex;
+    FilePrefetcher prefetcher(files, options.readThreads, options.queueDepth);
+
+    std::vector<std::thread> threads;
+    auto join = [&threads](std::vector<std::thread> stage) {
+        for (auto& thread : stage) {
+            threads.push_back(std::move(thread));
+        }
+    };
+
+    join(startStage(extractThreads, parsed, [&]() {
+        CXIndex clangIndex = options.lexical ? nullptr : clang_createIndex(0, 0);
+        std::vector<FunctionInfo> headerFunctions;
+        for (size_t i = nextFile++; i < files.size(); i = nextFile++) {
+            prefetcher.consumed(i);
+            auto source = std::make_shared<SourceBuffer>();
+            FileBatch batch;
+            bool ok = source->open(files[i]);
+            if (ok && options.lexical) {
+                extractFileFunctionsLexical(files[i], *source, nullptr, nullptr, hashString(source->text()),
+                                            batch.functions, options.splitter);
+            } else if (ok) {
+                headerFunctions.clear();
+                ok = extractFileFunctions(clangIndex, files[i], *source, options.compileFlags, nullptr, nullptr,
+                                          batch.functions, options.splitter, options.definitions,
+                                          &headerFunctions);
+                pushHeaderBatches(headerFunctions, parsed);
+            }
+            if (!ok) {
+                std::lock_guard<std::mutex> lock(logMutex);
+                std::cerr << "Unable to process file: " << files[i] << std::endl;
+                continue;
+            }
+            ++fileCount;
+            if (batch.functions.empty()) {
+                continue;
+            }
+            batch.source = std::move(source);
+            parsed.push(std::move(batch));
+        }
+        if (clangIndex) {
+            clang_disposeIndex(clangIndex);
+        }
+    }));
+
+    join(startStage(tokenizeThreads, counted, [&]() {
+        FileBatch batch;
+        while (parsed.pop(batch)) {
+            for (FunctionInfo& info : batch.functions) {
+                CacheEntry entry;
+                if (cache && cache->lookup({info.fileHash, info.extentHash}, entry) &&
+                    entry.tokenCount != kNoTokenCount) {
+                    info.tokenCount = entry.tokenCount;
+                    continue;
+                }
+                info.tokenCount = tokenizer.count(batch.source->slice(info.startOffset, info.endOffset));
+                if (cache) {
+                    entry.tokenCount = info.tokenCount;
+                    cache->store({info.fileHash, info.extentHash}, entry);
+                }
+            }
+            functionCount += batch.functions.size();
+            counted.push(std::move(batch));
+        }
+    }));
+
+    join(startStage(1, packed, [&]() {
+        OnlinePacker packer(options.chunkBudget, options.maxOpenChunks, packed);
+        FileBatch batch;
+        while (counted.pop(batch)) {
+            for (FunctionInfo& info : batch.functions) {
+                packer.add(std::move(info), batch.source);
+            }
+        }
+        packer.finish();
+    }));
+
+    std::unique_ptr<Tokenizer> embeddingTokenizer;
+    if (embed) {
+        embeddingTokenizer = std::make_unique<Tokenizer>(embeddingModel);
+        join(startStage(embedThreads, embedded, [&]() {
+            EmbeddingEngineParams params;
+            EmbeddingEngine engine(embeddingModel, params);
+            std::vector<std::vector<llama_token>> tokens;
+            std::vector<float> output;
+            StreamChunk chunk;
+            while (packed.pop(chunk)) {
+                if (engine.valid()) {
+                    embedChunk(chunk, engine, *embeddingTokenizer, cache, tokens, output);
+                }
+                embedded.push(std::move(chunk));
+            }
+        }));
+    }
+
+    ChunkSink sink(out, options.indexDir.empty() ? nullptr : &index, options.indexType,
+                   embed ? static_cast<size_t>(llama_n_embd(embeddingModel)) : 0);
+    bool ok = true;
+    StreamChunk chunk;
+    while (sinkInput.pop(chunk)) {
+        stats.chunks++;
+        stats.tokens += chunk.tokenCount;
+        ok = sink.write(chunk) && ok;
+        chunk = StreamChunk();
+    }
+    ok = sink.flush() && ok;
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    stats.files = fileCount;
+    stats.functions = functionCount;
+    return ok;
+}
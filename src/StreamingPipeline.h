@@ -0,0 +1,72 @@
+/**
+ * @file StreamingPipeline.h
+ * @brief This file contains the declaration of the streaming parse → tokenize → pack → embed → emit pipeline.
+ *
+ * Unlike the phase-by-phase flow in main(), the streaming pipeline never holds the whole corpus. Each stage
+ * runs on its own threads and hands work to the next through a bounded lock-free queue, so a slow stage
+ * makes the earlier ones wait instead of letting memory grow. Chunks are packed online and written out as
+ * soon as they close. Source files stay mapped only while functions from them are still in flight.
+ */
+
+#pragma once
+#include "EmbeddingIndex.h"
+#include "llama.h"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+class CompileFlags;
+class DefinitionSet;
+class FunctionCache;
+class FunctionSplitter;
+class Tokenizer;
+
+/**
+ * @brief Configuration of the streaming pipeline.
+ */
+struct StreamingOptions {
+    unsigned extractThreads = 0;  ///< libclang parser threads, 0 selects the hardware concurrency.
+    unsigned readThreads = 0;     ///< Threads reading files ahead of the parsers, see FilePrefetcher.
+    unsigned tokenizeThreads = 1; ///< Token counting threads.
+    unsigned embedThreads = 1;    ///< Embedding threads, each with its own llama context.
+    size_t queueDepth = 256;      ///< Capacity of every inter-stage queue.
+    int chunkBudget = 2048;       ///< Token budget per chunk.
+    size_t maxOpenChunks = 64;    ///< Chunks the online packer keeps open before closing the fullest one.
+    bool embed = false;           ///< Whether to embed the functions of each chunk.
+    std::string outputPath;       ///< JSONL output file; empty or "-" writes to stdout.
+    std::string indexDir;         ///< Binary index to append segments to, empty to skip it.
+    EmbeddingType indexType = EmbeddingType::Fp32;
+    std::string inputPath;        ///< Indexed files under this path that are not in the file list are removed.
+    const CompileFlags* compileFlags = nullptr; ///< Per-file compiler arguments, or nullptr.
+    bool lexical = false;         ///< Whether to find functions with the lexical scan instead of libclang.
+    const FunctionSplitter* splitter = nullptr; ///< Splits functions larger than a chunk, or nullptr.
+    DefinitionSet* definitions = nullptr; ///< Claims header functions so each is emitted once, nullptr skips them.
+};
+
+/**
+ * @brief Totals reported by the streaming pipeline.
+ */
+struct StreamingStats {
+    size_t files = 0;
+    size_t functions = 0;
+    size_t chunks = 0;
+    int64_t tokens = 0;
+};
+
+/**
+ * @brief Runs the streaming pipeline over a list of files.
+ * @param files The source files to process.
+ * @param tokenizer The tokenizer whose counts the chunk budget refers to.
+ * @param embeddingModel The embedding model loaded with its weights, or nullptr when not embedding.
+ * @param cache The cache of token counts and embeddings, or nullptr.
+ * @param options The stage configuration.
+ * @param stats Receives the totals.
+ * @return False if the output could not be written.
+ *
+ * Chunks are emitted in the order they close, which depends on thread scheduling; use the phase-based flow
+ * when a deterministic order is required.
+ */
+bool runStreamingPipeline(const std::vector<std::filesystem::path>& files, const Tokenizer& tokenizer,
+                          llama_model* embeddingModel, const FunctionCache* cache, const StreamingOptions& options,
+                          StreamingStats& stats);
@@ -0,0 +1,318 @@
+/**
+ * @file TokenEstimator.cpp
+ * @brief This file contains the implementation of the TokenEstimator.
+ */
+
+#include "TokenEstimator.h"
+#include "FunctionCache.h"
+#include "SourceBuffer.h"
+#include "Tokenizer.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace {
+
+/**
+ * @brief Number of functions tokenized exactly to calibrate the estimator.
+ */
+constexpr size_t kCalibrationSamples = 512;
+
+/**
+ * @brief Fraction of the calibration sample allowed outside the error bounds on each side.
+ */
+constexpr double kBoundQuantile = 0.01;
+
+enum class CharClass { Word, Digit, Space, Punct };
+
+CharClass classify(unsigned char c) {
+    if (std::isalpha(c) || c == '_' || c >= 0x80) {
+        return CharClass::Word;
+    }
+    if (std::isdigit(c)) {
+        return CharClass::Digit;
+    }
+    if (std::isspace(c)) {
+        return CharClass::Space;
+    }
+    return CharClass::Punct;
+}
+
+/**
+ * @brief Solves the 3x3 system a * x = b by Gaussian elimination with partial pivoting.
+ * @return False if the system is singular.
+ */
+bool solve3(double a[3][3], double b[3], double x[3]) {
+    for (int col = 0; col < 3; ++col) {
+        int pivot = col;
+        for (int row = col + 1; row < 3; ++row) {
+            if (std::fabs(a[row][col]) > std::fabs(a[pivot][col])) {
+                pivot = row;
+            }
+        }
+        if (std::fabs(a[pivot][col]) < 1e-9) {
+            return false;
+        }
+        std::swap(a[col], a[pivot]);
+        std::swap(b[col], b[pivot]);
+        for (int row = col + 1; row < 3; ++row) {
+            const double factor = a[row][col] / a[col][col];
+            for (int k = col; k < 3; ++k) {
+                a[row][k] -= factor * a[col][k];
+            }
+            b[row] -= factor * b[col];
+        }
+    }
+    for (int row = 2; row >= 0; --row) {
+        double sum = b[row];
+        for (int k = row + 1; k < 3; ++k) {
+            sum -= a[row][k] * x[k];
+        }
+        x[row] = sum / a[row][row];
+    }
+    return true;
+}
+
+/**
+ * @brief Looks up the exact token count of a function in the cache.
+ */
+bool cachedCount(const FunctionCache* cache, FunctionTable& functions, size_t i) {
+    CacheEntry entry;
+    if (!cache || !cache->lookup({functions.fileHash(i), functions.extentHash(i)}, entry) ||
+        entry.tokenCount == kNoTokenCount) {
+        return false;
+    }
+    functions.setTokenCount(i, entry.tokenCount);
+    return true;
+}
+
+/**
+ * @brief Tokenizes a function exactly and stores the count in the cache.
+ */
+void exactCount(const Tokenizer& tokenizer, const FunctionCache* cache, FunctionTable& functions, size_t i,
+                std::string_view text) {
+    CacheEntry entry;
+    const CacheKey key{functions.fileHash(i), functions.extentHash(i)};
+    if (cache) {
+        // Keep an embedding stored without a count
+        cache->lookup(key, entry);
+    }
+    entry.tokenCount = tokenizer.count(text);
+    if (cache) {
+        cache->store(key, entry);
+    }
+    functions.setTokenCount(i, entry.tokenCount);
+}
+
+} // namespace
+
+/**
+ * @brief Counts the runs a BPE pre-tokenizer would split a text into.
+ *
+ * Identifier and number runs count once each. Punctuation counts once per character. A space in front of a
+ * word is usually merged into the word's token, so a whitespace run only counts when it is longer than one
+ * character or is not followed by a word.
+ *
+ * @param text The text.
+ * @return The number of runs.
+ */
+size_t TokenEstimator::countPreTokens(std::string_view text) {
+    size_t count = 0;
+    size_t i = 0;
+    while (i < text.size()) {
+        const CharClass cls = classify(static_cast<unsigned char>(text[i]));
+        size_t end = i + 1;
+        if (cls != CharClass::Punct) {
+            while (end < text.size() && classify(static_cast<unsigned char>(text[end])) == cls) {
+                ++end;
+            }
+        }
+        if (cls != CharClass::Space || end - i > 1 || end == text.size() ||
+            classify(static_cast<unsigned char>(text[end])) != CharClass::Word) {
+            ++count;
+        }
+        i = end;
+    }
+    return count;
+}
+
+/**
+ * @brief Fits the estimator to exactly counted samples.
+ *
+ * The weights are the least-squares fit of tokens = a * bytes + b * preTokens + c. With too few samples, or
+ * features that are linearly dependent, the fit falls back to a single tokens-per-byte ratio. The bounds are
+ * the low and high quantiles of the ratio between the exact and the estimated count over the sample.
+ *
+ * @param texts The sample texts.
+ * @param counts The exact token count of each sample text.
+ * @return False if there were no samples.
+ */
+bool TokenEstimator::calibrate(const std::vector<std::string_view>& texts, const std::vector<int>& counts) {
+    const size_t n = std::min(texts.size(), counts.size());
+    if (n == 0) {
+        return false;
+    }
+
+    std::vector<double> bytes(n), preTokens(n);
+    double a[3][3] = {};
+    double b[3] = {};
+    double totalBytes = 0.0, totalTokens = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        bytes[i] = static_cast<double>(texts[i].size());
+        preTokens[i] = static_cast<double>(countPreTokens(texts[i]));
+        const double features[3] = {bytes[i], preTokens[i], 1.0};
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 3; ++c) {
+                a[r][c] += features[r] * features[c];
+            }
+            b[r] += features[r] * counts[i];
+        }
+        totalBytes += bytes[i];
+        totalTokens += counts[i];
+    }
+
+    double weights[3] = {};
+    if (n >= 8 && solve3(a, b, weights)) {
+        bytesWeight_ = weights[0];
+        preTokenWeight_ = weights[1];
+        bias_ = weights[2];
+    } else {
+        bytesWeight_ = totalBytes > 0.0 ? totalTokens / totalBytes : 0.25;
+        preTokenWeight_ = 0.0;
+        bias_ = 0.0;
+    }
+
+    std::vector<double> ratios(n);
+    for (size_t i = 0; i < n; ++i) {
+        const double predicted = std::max(1.0, bytesWeight_ * bytes[i] + preTokenWeight_ * preTokens[i] + bias_);
+        ratios[i] = counts[i] / predicted;
+    }
+    std::sort(ratios.begin(), ratios.end());
+    const size_t tail = static_cast<size_t>(kBoundQuantile * static_cast<double>(n));
+    lowRatio_ = std::min(1.0, ratios[tail]);
+    highRatio_ = std::max(1.0, ratios[n - 1 - tail]);
+    calibrated_ = true;
+    return true;
+}
+
+/**
+ * @brief Estimates the token count of a text.
+ * @param text The text.
+ * @return The point estimate and its bounds.
+ */
+TokenEstimate TokenEstimator::estimate(std::string_view text) const {
+    const double predicted =
+        std::max(1.0, bytesWeight_ * static_cast<double>(text.size()) +
+                          preTokenWeight_ * static_cast<double>(countPreTokens(text)) + bias_);
+    return {static_cast<int>(std::lround(predicted)), static_cast<int>(std::floor(predicted * lowRatio_)),
+            static_cast<int>(std::ceil(predicted * highRatio_))};
+}
+
+/**
+ * @brief Fills in the token counts of functions extracted without a tokenizer.
+ *
+ * Functions of the same file are contiguous in the extractor output, so each file is mapped once per pass. The
+ * calibration sample is spread evenly over the function list, and its exact counts are kept.
+ *
+ * @param functions The functions; those with a count already set are kept as they are.
+ * @param tokenizer The tokenizer used for the calibration sample and for functions near the boundary.
+ * @param cache The cache of exact token counts, or nullptr.
+ * @param boundary The chunk budget.
+ * @param numThreads The number of worker threads, 0 selects the hardware concurrency.
+ * @param estimator Calibrated on a sample of the functions if it is not calibrated yet.
+ * @param stats Receives the totals of the pass.
+ */
+void estimateFunctionTokens(FunctionTable& functions, const Tokenizer& tokenizer, const FunctionCache* cache,
+                            int boundary, unsigned numThreads, TokenEstimator& estimator, EstimateStats& stats) {
+    TRACE_SCOPE("estimate");
+    stats = {};
+
+    // [begin, end) ranges of functions sharing a file
+    std::vector<std::pair<size_t, size_t>> files;
+    for (size_t i = 0; i < functions.size(); ++i) {
+        if (files.empty() || functions.fileId(files.back().first) != functions.fileId(i)) {
+            files.emplace_back(i, i);
+        }
+        files.back().second = i + 1;
+    }
+
+    if (!estimator.calibrated()) {
+        const size_t stride = std::max<size_t>(1, functions.size() / kCalibrationSamples);
+        // Copied, since the mapping of each file is replaced by the next one
+        std::vector<std::string> samples;
+        std::vector<int> counts;
+        SourceBuffer source;
+        size_t openFile = files.size();
+        for (size_t f = 0, i = 0; i < functions.size(); i += stride) {
+            while (files[f].second <= i) {
+                ++f;
+            }
+            if (f != openFile) {
+                openFile = source.open(functions.filePath(i)) ? f : files.size();
+            }
+            if (openFile != f) {
+                continue;
+            }
+            const std::string_view text = source.slice(functions.startOffset(i), functions.endOffset(i));
+            if (functions.tokenCount(i) <= 0 && !cachedCount(cache, functions, i)) {
+                exactCount(tokenizer, cache, functions, i, text);
+            }
+            samples.emplace_back(text);
+            counts.push_back(functions.tokenCount(i));
+        }
+        estimator.calibrate(std::vector<std::string_view>(samples.begin(), samples.end()), counts);
+    }
+
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    numThreads = std::min<unsigned>(numThreads, std::max<size_t>(files.size(), 1));
+
+    std::atomic<size_t> nextFile{0};
+    std::mutex statsMutex;
+    auto worker = [&]() {
+        EstimateStats local;
+        SourceBuffer source;
+        for (size_t f = nextFile++; f < files.size(); f = nextFile++) {
+            const bool mapped = source.open(functions.filePath(files[f].first));
+            for (size_t i = files[f].first; i < files[f].second; ++i) {
+                if (functions.tokenCount(i) <= 0 && !cachedCount(cache, functions, i) && mapped) {
+                    const std::string_view text = source.slice(functions.startOffset(i), functions.endOffset(i));
+                    const TokenEstimate estimate = estimator.estimate(text);
+                    if (boundary > 0 && estimate.low <= boundary && boundary < estimate.high) {
+                        exactCount(tokenizer, cache, functions, i, text);
+                    } else {
+                        functions.setTokenCount(i, estimate.tokens);
+                        local.low += estimate.low;
+                        local.high += estimate.high;
+                        ++local.estimated;
+                        continue;
+                    }
+                }
+                local.low += functions.tokenCount(i);
+                local.high += functions.tokenCount(i);
+                ++local.exact;
+            }
+        }
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.estimated += local.estimated;
+        stats.exact += local.exact;
+        stats.low += local.low;
+        stats.high += local.high;
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(numThreads);
+    for (unsigned t = 0; t < numThreads; ++t) {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
@@ -0,0 +1,91 @@
+/**
+ * @file TokenEstimator.h
+ * @brief This file contains the declaration of the TokenEstimator, which predicts token counts without tokenizing.
+ *
+ * The estimator is a linear model of the token count over the byte count and the pre-token count of a text,
+ * where pre-tokens are the identifier, number, whitespace and punctuation runs a BPE pre-tokenizer would split
+ * the text into. It is fitted per model on a sample of exactly tokenized functions, and the spread of the sample
+ * residuals gives the error bounds of every estimate.
+ */
+
+#pragma once
+#include "FunctionTable.h"
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief An estimated token count with its error bounds.
+ */
+struct TokenEstimate {
+    int tokens; ///< Point estimate.
+    int low;    ///< Lower bound, below which about 1% of the calibration sample fell.
+    int high;   ///< Upper bound, above which about 1% of the calibration sample fell.
+};
+
+/**
+ * @brief Totals of an estimateFunctionTokens() pass.
+ */
+struct EstimateStats {
+    size_t estimated = 0; ///< Functions whose count is an estimate.
+    size_t exact = 0;     ///< Functions that were tokenized or found in the cache.
+    int64_t low = 0;      ///< Lower bound of the total token count.
+    int64_t high = 0;     ///< Upper bound of the total token count.
+};
+
+/**
+ * @brief Predicts token counts from cheap text features, calibrated against a tokenizer.
+ */
+class TokenEstimator {
+public:
+    /**
+     * @brief Fits the estimator to exactly counted samples.
+     * @param texts The sample texts.
+     * @param counts The exact token count of each sample text.
+     * @return False if there were no samples, in which case the estimator is left uncalibrated.
+     */
+    bool calibrate(const std::vector<std::string_view>& texts, const std::vector<int>& counts);
+
+    /**
+     * @brief Returns whether calibrate() succeeded.
+     */
+    bool calibrated() const { return calibrated_; }
+
+    /**
+     * @brief Estimates the token count of a text.
+     * @param text The text.
+     * @return The point estimate and its bounds.
+     */
+    TokenEstimate estimate(std::string_view text) const;
+
+    /**
+     * @brief Counts the runs a BPE pre-tokenizer would split a text into.
+     * @param text The text.
+     * @return The number of identifier, number, whitespace and punctuation runs.
+     */
+    static size_t countPreTokens(std::string_view text);
+
+private:
+    double bytesWeight_ = 0.25;
+    double preTokenWeight_ = 0.0;
+    double bias_ = 0.0;
+    double lowRatio_ = 1.0;
+    double highRatio_ = 1.0;
+    bool calibrated_ = false;
+};
+
+/**
+ * @brief Fills in the token counts of functions extracted without a tokenizer.
+ * @param functions The functions; those with a count already set are kept as they are.
+ * @param tokenizer The tokenizer used for the calibration sample and for functions near the boundary.
+ * @param cache The cache of exact token counts, or nullptr.
+ * @param boundary The chunk budget. Functions whose bounds straddle it are tokenized exactly, since whether
+ *                 they fit decides how they are packed.
+ * @param numThreads The number of worker threads, 0 selects the hardware concurrency.
+ * @param estimator Calibrated on a sample of the functions if it is not calibrated yet.
+ * @param stats Receives the totals of the pass.
+ *
+ * Exact counts found in the cache are always preferred to an estimate. Estimates are never stored in the cache.
+ */
+void estimateFunctionTokens(FunctionTable& functions, const Tokenizer& tokenizer, const FunctionCache* cache,
+                            int boundary, unsigned numThreads, TokenEstimator& estimator, EstimateStats& stats);
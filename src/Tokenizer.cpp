@@ -0,0 +1,162 @@
+/**
+ * @file Tokenizer.cpp
+ * @brief This file contains the implementation of the Tokenizer service.
+ */
+
+#include "Tokenizer.h"
+#include "Trace.h"
+#include "common/common.h"
+#include <iostream>
+
+/**
+ * @brief Creates a tokenizer for a model and fills the context pool.
+ * @param model The model whose vocabulary is used.
+ * @param contextPoolSize The number of contexts to create up front.
+ * @param ctxParams The parameters used for every pooled context.
+ */
+Tokenizer::Tokenizer(llama_model* model, size_t contextPoolSize, llama_context_params ctxParams)
+    : model_(model), addBos_(llama_should_add_bos_token(model)) {
+    contexts_.reserve(contextPoolSize);
+    for (size_t i = 0; i < contextPoolSize; ++i) {
+        llama_context* ctx = llama_new_context_with_model(model, ctxParams);
+        if (!ctx) {
+            std::cerr << "Failed to create pooled context " << i << std::endl;
+            break;
+        }
+        contexts_.push_back(ctx);
+    }
+    freeContexts_ = contexts_;
+}
+
+/**
+ * @brief Frees every pooled context. All leases must have been returned.
+ */
+Tokenizer::~Tokenizer() {
+    for (llama_context* ctx : contexts_) {
+        llama_free(ctx);
+    }
+}
+
+/**
+ * @brief Tokenizes a string into a caller-owned buffer.
+ *
+ * The buffer is first sized to one token per byte plus the BOS token, which is enough for every BPE and
+ * SentencePiece vocabulary in practice. If llama still reports a larger requirement the call is retried once.
+ *
+ * @param text The text to tokenize.
+ * @param tokens The buffer receiving the tokens.
+ */
+void Tokenizer::tokenize(std::string_view text, std::vector<llama_token>& tokens) const {
+    TRACE_SCOPE("tokenize");
+    tokens.resize(text.size() + 2);
+    int32_t n = llama_tokenize(model_, text.data(), static_cast<int32_t>(text.size()), tokens.data(),
+                               static_cast<int32_t>(tokens.size()), addBos_, true);
+    if (n < 0) {
+        tokens.resize(-n);
+        n = llama_tokenize(model_, text.data(), static_cast<int32_t>(text.size()), tokens.data(),
+                           static_cast<int32_t>(tokens.size()), addBos_, true);
+    }
+    tokens.resize(n < 0 ? 0 : n);
+    traceCount(TraceCounter::Tokens, static_cast<int64_t>(tokens.size()));
+}
+
+/**
+ * @brief Tokenizes a string.
+ * @param text The text to tokenize.
+ * @return A vector of tokens.
+ */
+std::vector<llama_token> Tokenizer::tokenize(std::string_view text) const {
+    std::vector<llama_token> tokens;
+    tokenize(text, tokens);
+    return tokens;
+}
+
+/**
+ * @brief Counts the tokens of a string without storing them.
+ *
+ * llama_tokenize returns the negated token count when the output buffer is too small, so a zero-sized buffer
+ * yields the count with no token storage on the caller's side.
+ *
+ * @param text The text to tokenize.
+ * @return The number of tokens.
+ */
+int Tokenizer::count(std::string_view text) const {
+    TRACE_SCOPE("tokenize");
+    const int32_t n =
+        llama_tokenize(model_, text.data(), static_cast<int32_t>(text.size()), nullptr, 0, addBos_, true);
+    const int tokens = n < 0 ? -n : n;
+    traceCount(TraceCounter::Tokens, tokens);
+    return tokens;
+}
+
+/**
+ * @brief Tokenizes many strings at once, reusing the output buffers.
+ * @param texts The texts to tokenize.
+ * @param tokens The output buffers, one per text.
+ */
+void Tokenizer::tokenize_batch(const std::vector<std::string_view>& texts,
+                               std::vector<std::vector<llama_token>>& tokens) const {
+    tokens.resize(texts.size());
+    for (size_t i = 0; i < texts.size(); ++i) {
+        tokenize(texts[i], tokens[i]);
+    }
+}
+
+/**
+ * @brief Leases a context from the pool, waiting until one is free.
+ * @return A lease on a pooled context, or an empty lease if the pool has no contexts.
+ */
+Tokenizer::ContextLease Tokenizer::acquireContext() {
+    if (contexts_.empty()) {
+        return {};
+    }
+
+    std::unique_lock<std::mutex> lock(poolMutex_);
+    poolAvailable_.wait(lock, [this] { return !freeContexts_.empty(); });
+    llama_context* ctx = freeContexts_.back();
+    freeContexts_.pop_back();
+    return {this, ctx};
+}
+
+/**
+ * @brief Returns a context to the pool and wakes one waiter.
+ * @param ctx The context to return.
+ */
+void Tokenizer::releaseContext(llama_context* ctx) {
+    {
+        std::lock_guard<std::mutex> lock(poolMutex_);
+        freeContexts_.push_back(ctx);
+    }
+    poolAvailable_.notify_one();
+}
+
+Tokenizer::ContextLease::ContextLease(ContextLease&& other) noexcept : owner_(other.owner_), ctx_(other.ctx_) {
+    other.owner_ = nullptr;
+    other.ctx_ = nullptr;
+}
+
+Tokenizer::ContextLease& Tokenizer::ContextLease::operator=(ContextLease&& other) noexcept {
+    if (this != &other) {
+        release();
+        owner_ = other.owner_;
+        ctx_ = other.ctx_;
+        other.owner_ = nullptr;
+        other.ctx_ = nullptr;
+    }
+    return *this;
+}
+
+Tokenizer::ContextLease::~ContextLease() {
+    release();
+}
+
+/**
+ * @brief Returns the leased context to its pool, if any.
+ */
+void Tokenizer::ContextLease::release() {
+    if (owner_ && ctx_) {
+        owner_->releaseContext(ctx_);
+    }
+    owner_ = nullptr;
+    ctx_ = nullptr;
+}
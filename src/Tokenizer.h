@@ -0,0 +1,107 @@
+/**
+ * @file Tokenizer.h
+ * @brief This file contains the declaration of the Tokenizer service.
+ *
+ * The Tokenizer wraps a llama model and tokenizes text using only the model vocabulary, so no llama context
+ * is created per call. It optionally owns a fixed pool of llama contexts that callers lease when they need
+ * to run the model, and it offers a batch entry point that reuses the caller's token buffers across calls.
+ */
+
+#pragma once
+#include "llama.h"
+#include <condition_variable>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Tokenizes text with a llama model and manages a fixed pool of reusable contexts.
+ *
+ * All tokenization methods are const and safe to call from several threads at once.
+ */
+class Tokenizer {
+public:
+    /**
+     * @brief RAII handle to a context leased from the pool; returns it to the pool on destruction.
+     */
+    class ContextLease {
+    public:
+        ContextLease() = default;
+        ContextLease(Tokenizer* owner, llama_context* ctx) : owner_(owner), ctx_(ctx) {}
+        ContextLease(ContextLease&& other) noexcept;
+        ContextLease& operator=(ContextLease&& other) noexcept;
+        ContextLease(const ContextLease&) = delete;
+        ContextLease& operator=(const ContextLease&) = delete;
+        ~ContextLease();
+
+        llama_context* get() const { return ctx_; }
+        explicit operator bool() const { return ctx_ != nullptr; }
+
+    private:
+        void release();
+
+        Tokenizer* owner_ = nullptr;
+        llama_context* ctx_ = nullptr;
+    };
+
+    /**
+     * @brief Creates a tokenizer for a model.
+     * @param model The model whose vocabulary is used. The tokenizer does not take ownership.
+     * @param contextPoolSize The number of contexts to create up front, 0 for a vocabulary-only tokenizer.
+     * @param ctxParams The parameters used for every pooled context.
+     */
+    explicit Tokenizer(llama_model* model, size_t contextPoolSize = 0,
+                       llama_context_params ctxParams = llama_context_default_params());
+    ~Tokenizer();
+
+    Tokenizer(const Tokenizer&) = delete;
+    Tokenizer& operator=(const Tokenizer&) = delete;
+
+    /**
+     * @brief Tokenizes a string into a caller-owned buffer.
+     * @param text The text to tokenize.
+     * @param tokens The buffer receiving the tokens. Its capacity is reused between calls.
+     */
+    void tokenize(std::string_view text, std::vector<llama_token>& tokens) const;
+
+    /**
+     * @brief Tokenizes a string.
+     * @param text The text to tokenize.
+     * @return A vector of tokens.
+     */
+    std::vector<llama_token> tokenize(std::string_view text) const;
+
+    /**
+     * @brief Counts the tokens of a string without storing them.
+     * @param text The text to tokenize.
+     * @return The number of tokens, including the BOS token if the model adds one.
+     */
+    int count(std::string_view text) const;
+
+    /**
+     * @brief Tokenizes many strings at once.
+     * @param texts The texts to tokenize.
+     * @param tokens The output buffers, one per text. Existing inner vectors are reused, so passing the same
+     *               output vector on every call avoids reallocating token storage.
+     */
+    void tokenize_batch(const std::vector<std::string_view>& texts, std::vector<std::vector<llama_token>>& tokens) const;
+
+    /**
+     * @brief Leases a context from the pool, waiting until one is free.
+     * @return A lease on a pooled context, or an empty lease if the pool has no contexts.
+     */
+    ContextLease acquireContext();
+
+    llama_model* model() const { return model_; }
+    size_t contextPoolSize() const { return contexts_.size(); }
+
+private:
+    void releaseContext(llama_context* ctx);
+
+    llama_model* model_;
+    bool addBos_;
+    std::vector<llama_context*> contexts_;
+    std::vector<llama_context*> freeContexts_;
+    std::mutex poolMutex_;
+    std::condition_variable poolAvailable_;
+};
@@ -0,0 +1,271 @@
+/**
+ * @file Trace.cpp
+ * @brief This file contains the implementation of the scoped timers and counters.
+ */
+
+#include "Trace.h"
+#include "JsonUtil.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::atomic<bool> enabled{false};
+std::atomic<bool> eventsEnabled{false};
+const Clock::time_point traceEpoch = Clock::now();
+
+struct TraceEvent {
+    const char* name;
+    int64_t startNs;
+    int64_t durationNs;
+};
+
+struct TimerTotals {
+    const char* name;
+    uint64_t calls = 0;
+    int64_t totalNs = 0;
+    int64_t maxNs = 0;
+};
+
+/**
+ * @brief The trace data of one thread. Only its thread writes to it while instrumented code runs.
+ */
+struct ThreadBuffer {
+    uint32_t threadId = 0;
+    std::vector<TraceEvent> events;
+    std::vector<TimerTotals> timers; ///< Few distinct names, so a linear search beats a map.
+    std::atomic<int64_t> counters[static_cast<size_t>(TraceCounter::Count)] = {};
+
+    void add(const char* name, int64_t startNs, int64_t durationNs) {
+        auto it = std::find_if(timers.begin(), timers.end(), [name](const TimerTotals& t) { return t.name == name; });
+        if (it == timers.end()) {
+            timers.push_back({name});
+            it = timers.end() - 1;
+        }
+        it->calls++;
+        it->totalNs += durationNs;
+        it->maxNs = std::max(it->maxNs, durationNs);
+        if (eventsEnabled.load(std::memory_order_relaxed)) {
+            events.push_back({name, startNs, durationNs});
+        }
+    }
+};
+
+/**
+ * @brief Owns the buffers of every thread that has recorded something, so they outlive their threads.
+ *
+ * A thread returns its buffer to the idle list when it exits, and the next new thread continues it, so a
+ * process that keeps starting threads, like the daemon's extraction pools, holds one buffer per thread that
+ * runs at the same time rather than one per thread it ever started.
+ */
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::vector<ThreadBuffer*> idle;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+/**
+ * @brief A thread's hold on a buffer, released when the thread exits.
+ */
+struct BufferLease {
+    ThreadBuffer* buffer;
+
+    BufferLease() {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        if (!reg.idle.empty()) {
+            buffer = reg.idle.back();
+            reg.idle.pop_back();
+            return;
+        }
+        reg.buffers.push_back(std::make_unique<ThreadBuffer>());
+        reg.buffers.back()->threadId = static_cast<uint32_t>(reg.buffers.size());
+        buffer = reg.buffers.back().get();
+    }
+
+    ~BufferLease() {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.idle.push_back(buffer);
+    }
+};
+
+ThreadBuffer& threadBuffer() {
+    thread_local BufferLease lease;
+    return *lease.buffer;
+}
+
+int64_t sinceEpochNs(Clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time - traceEpoch).count();
+}
+
+const char* counterName(TraceCounter counter) {
+    switch (counter) {
+        case TraceCounter::Files:
+            return "files";
+        case TraceCounter::Bytes:
+            return "bytes";
+        case TraceCounter::Functions:
+            return "functions";
+        case TraceCounter::Tokens:
+            return "tokens";
+        case TraceCounter::CacheHits:
+            return "cache_hits";
+        case TraceCounter::CacheMisses:
+            return "cache_misses";
+        case TraceCounter::Decodes:
+            return "decodes";
+        case TraceCounter::DecodedTokens:
+            return "decoded_tokens";
+        case TraceCounter::ReadAheadBytes:
+            return "read_ahead_bytes";
+        case TraceCounter::Count:
+            break;
+    }
+    return "unknown";
+}
+
+} // namespace
+
+/**
+ * @brief Turns instrumentation on.
+ * @param recordEvents Whether to keep every timed event for traceWriteChrome().
+ */
+void traceEnable(bool recordEvents) {
+    eventsEnabled.store(recordEvents, std::memory_order_relaxed);
+    enabled.store(true, std::memory_order_release);
+}
+
+bool traceEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void traceCount(TraceCounter counter, int64_t value) {
+    if (enabled.load(std::memory_order_relaxed)) {
+        threadBuffer().counters[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+    }
+}
+
+TraceScope::TraceScope(const char* name) : name_(nullptr) {
+    if (enabled.load(std::memory_order_relaxed)) {
+        name_ = name;
+        start_ = Clock::now();
+    }
+}
+
+TraceScope::~TraceScope() {
+    if (name_) {
+        const int64_t durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_).count();
+        threadBuffer().add(name_, sinceEpochNs(start_), durationNs);
+    }
+}
+
+/**
+ * @brief Prints per-name timer totals and the counters of all threads.
+ *
+ * Timer totals are summed over threads, so a stage that ran on eight threads can report more time than the
+ * wall clock; the max column shows the longest single call.
+ *
+ * @param out The stream that receives the table.
+ */
+void traceReport(std::ostream& out) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    std::map<std::string, TimerTotals> timers;
+    int64_t counters[static_cast<size_t>(TraceCounter::Count)] = {};
+    for (const auto& buffer : reg.buffers) {
+        for (const TimerTotals& t : buffer->timers) {
+            TimerTotals& total = timers.emplace(t.name, TimerTotals{t.name}).first->second;
+            total.calls += t.calls;
+            total.totalNs += t.totalNs;
+            total.maxNs = std::max(total.maxNs, t.maxNs);
+        }
+        for (size_t c = 0; c < static_cast<size_t>(TraceCounter::Count); ++c) {
+            counters[c] += buffer->counters[c].load(std::memory_order_relaxed);
+        }
+    }
+
+    const double wallMs = sinceEpochNs(Clock::now()) / 1e6;
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-20s %12s %14s %12s %12s\n", "stage", "calls", "total ms", "mean us",
+                  "max ms");
+    out << line;
+    for (const auto& entry : timers) {
+        const TimerTotals& t = entry.second;
+        std::snprintf(line, sizeof(line), "%-20s %12llu %14.1f %12.1f %12.2f\n", entry.first.c_str(),
+                      static_cast<unsigned long long>(t.calls), t.totalNs / 1e6,
+                      t.calls ? t.totalNs / 1e3 / t.calls : 0.0, t.maxNs / 1e6);
+        out << line;
+    }
+    std::snprintf(line, sizeof(line), "%-20s %12s %14.1f\n", "wall", "", wallMs);
+    out << line;
+    for (size_t c = 0; c < static_cast<size_t>(TraceCounter::Count); ++c) {
+        std::snprintf(line, sizeof(line), "%-20s %12lld\n", counterName(static_cast<TraceCounter>(c)),
+                      static_cast<long long>(counters[c]));
+        out << line;
+    }
+}
+
+/**
+ * @brief Writes every recorded event as a Chrome trace-event JSON file.
+ *
+ * Timers become complete ("X") events on one track per buffer, which threads that did not overlap may share, and
+ * the final counter values are added as counter ("C") events at the end of the trace.
+ *
+ * @param path The output file.
+ * @return False if the file could not be written.
+ */
+bool traceWriteChrome(const std::string& path) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to open trace file: " << path << std::endl;
+        return false;
+    }
+
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    char number[64];
+    int64_t endNs = 0;
+    for (const auto& buffer : reg.buffers) {
+        for (const TraceEvent& event : buffer->events) {
+            out << (first ? "" : ",\n") << "{\"name\":";
+            writeJsonString(out, event.name);
+            std::snprintf(number, sizeof(number), "%.3f,\"dur\":%.3f", event.startNs / 1e3, event.durationNs / 1e3);
+            out << ",\"cat\":\"code_chunk\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"ts\":" << number
+                << "}";
+            endNs = std::max(endNs, event.startNs + event.durationNs);
+            first = false;
+        }
+    }
+
+    for (size_t c = 0; c < static_cast<size_t>(TraceCounter::Count); ++c) {
+        int64_t total = 0;
+        for (const auto& buffer : reg.buffers) {
+            total += buffer->counters[c].load(std::memory_order_relaxed);
+        }
+        std::snprintf(number, sizeof(number), "%.3f", endNs / 1e3);
+        out << (first ? "" : ",\n") << "{\"name\":\"" << counterName(static_cast<TraceCounter>(c))
+            << "\",\"ph\":\"C\",\"pid\":1,\"ts\":" << number << ",\"args\":{\"value\":" << total << "}}";
+        first = false;
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,90 @@
+/**
+ * @file Trace.h
+ * @brief This file contains the declarations of the scoped timers and counters used to instrument the pipeline.
+ *
+ * Instrumentation is off until traceEnable() is called, and then costs one relaxed atomic load per timer or
+ * counter. Each thread records into its own buffer, so no locks are taken on the hot path. The buffers are
+ * merged by traceReport() into a summary table and by traceWriteChrome() into a Chrome trace-event file that
+ * can be opened in chrome://tracing or Perfetto.
+ */
+
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/**
+ * @brief The counters recorded by the pipeline.
+ */
+enum class TraceCounter {
+    Files,         ///< Source files opened.
+    Bytes,         ///< Bytes of source mapped.
+    Functions,     ///< Functions recorded by an extractor.
+    Tokens,        ///< Tokens produced by the tokenizer.
+    CacheHits,     ///< Function cache lookups that found an entry.
+    CacheMisses,   ///< Function cache lookups that did not.
+    Decodes,       ///< llama_decode calls.
+    DecodedTokens, ///< Tokens passed to llama_decode.
+    ReadAheadBytes, ///< Bytes read into the page cache ahead of the parsers.
+    Count
+};
+
+/**
+ * @brief Turns instrumentation on.
+ * @param recordEvents Whether to keep every timed event for traceWriteChrome(), not only per-name totals.
+ */
+void traceEnable(bool recordEvents);
+
+/**
+ * @brief Returns whether instrumentation is on.
+ */
+bool traceEnabled();
+
+/**
+ * @brief Adds to a counter of the calling thread.
+ */
+void traceCount(TraceCounter counter, int64_t value = 1);
+
+/**
+ * @brief Times the enclosing scope under a name.
+ *
+ * The name must be a string literal or otherwise outlive the program's use of the trace.
+ */
+class TraceScope {
+public:
+    explicit TraceScope(const char* name);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * @brief Prints per-name timer totals and the counters of all threads.
+ * @param out The stream that receives the table.
+ *
+ * Must be called once the instrumented worker threads have finished.
+ */
+void traceReport(std::ostream& out);
+
+/**
+ * @brief Writes every recorded event as a Chrome trace-event JSON file.
+ * @param path The output file.
+ * @return False if the file could not be written.
+ *
+ * Requires traceEnable(true); must be called once the instrumented worker threads have finished.
+ */
+bool traceWriteChrome(const std::string& path);
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+/**
+ * @brief Times the rest of the enclosing block under a name.
+ */
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
@@ -0,0 +1,418 @@
+/**
+ * @file VectorKernels.cpp
+ * @brief This file contains the scalar and SIMD implementations of the vector kernels and their dispatch.
+ */
+
+#include "VectorKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+#if defined(CODE_CHUNK_ARCH_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CODE_CHUNK_HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#if defined(CODE_CHUNK_ARCH_AARCH64) && defined(__ARM_NEON)
+#define CODE_CHUNK_HAVE_NEON_KERNELS 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+/**
+ * @brief Table of the kernels that have architecture-specific variants.
+ */
+struct KernelTable {
+    const char* name;
+    float (*dot)(const float*, const float*, size_t);
+    void (*scale)(const float*, float, float*, size_t);
+    void (*toFp16)(const float*, uint16_t*, size_t);
+    void (*fromFp16)(const uint16_t*, float*, size_t);
+};
+
+// ---------------------------------------------------------------------------------------------------------
+// Scalar
+
+float dotScalar(const float* a, const float* b, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+void scaleScalar(const float* in, float factor, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = in[i] * factor;
+    }
+}
+
+uint16_t toFp16Scalar(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const uint32_t exponent = (bits >> 23) & 0xffu;
+    uint32_t mantissa = bits & 0x7fffffu;
+
+    if (exponent == 0xff) { // Inf or NaN
+        return static_cast<uint16_t>(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+    }
+
+    int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+    if (halfExponent >= 0x1f) { // Overflow to infinity
+        return static_cast<uint16_t>(sign | 0x7c00u);
+    }
+
+    if (halfExponent <= 0) { // Subnormal half or zero
+        if (halfExponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x800000u;
+        const uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+        uint32_t half = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1u))) {
+            ++half;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    uint32_t half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+    const uint32_t remainder = mantissa & 0x1fffu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+        ++half; // May carry into the exponent, which correctly rounds up to the next power of two or infinity
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+float fromFp16Scalar(uint16_t half) {
+    const uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1fu;
+    uint32_t mantissa = half & 0x3ffu;
+    uint32_t bits;
+
+    if (exponent == 0x1f) {
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    } else if (mantissa == 0) {
+        bits = sign;
+    } else { // Subnormal half, normalize it
+        exponent = 127 - 15 + 1;
+        while ((mantissa & 0x400u) == 0) {
+            mantissa <<= 1;
+            --exponent;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+    }
+
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void toFp16ScalarN(const float* in, uint16_t* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = toFp16Scalar(in[i]);
+    }
+}
+
+void fromFp16ScalarN(const uint16_t* in, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = fromFp16Scalar(in[i]);
+    }
+}
+
+constexpr KernelTable kScalarKernels{"scalar", dotScalar, scaleScalar, toFp16ScalarN, fromFp16ScalarN};
+
+// ---------------------------------------------------------------------------------------------------------
+// x86: AVX2 + FMA + F16C, and AVX-512F
+
+#ifdef CODE_CHUNK_HAVE_X86_KERNELS
+
+__attribute__((target("avx2,fma"))) float dotAvx2(const float* a, const float* b, size_t n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    float result = _mm_cvtss_f32(sum);
+    for (; i < n; ++i) {
+        result += a[i] * b[i];
+    }
+    return result;
+}
+
+__attribute__((target("avx2"))) void scaleAvx2(const float* in, float factor, float* out, size_t n) {
+    const __m256 f = _mm256_set1_ps(factor);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(in + i), f));
+    }
+    for (; i < n; ++i) {
+        out[i] = in[i] * factor;
+    }
+}
+
+__attribute__((target("avx2,f16c"))) void toFp16F16c(const float* in, uint16_t* out, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), half);
+    }
+    for (; i < n; ++i) {
+        out[i] = toFp16Scalar(in[i]);
+    }
+}
+
+__attribute__((target("avx2,f16c"))) void fromFp16F16c(const uint16_t* in, float* out, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(half));
+    }
+    for (; i < n; ++i) {
+        out[i] = fromFp16Scalar(in[i]);
+    }
+}
+
+__attribute__((target("avx512f"))) float dotAvx512(const float* a, const float* b, size_t n) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+    }
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+    }
+    if (i < n) {
+        const __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+        acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), acc1);
+    }
+    // Reduced by hand: GCC's _mm512_reduce_add_ps trips -Wuninitialized inside its own headers
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, _mm512_add_ps(acc0, acc1));
+    float result = 0.0f;
+    for (float lane : lanes) {
+        result += lane;
+    }
+    return result;
+}
+
+__attribute__((target("avx512f"))) void scaleAvx512(const float* in, float factor, float* out, size_t n) {
+    const __m512 f = _mm512_set1_ps(factor);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(out + i, _mm512_mul_ps(_mm512_loadu_ps(in + i), f));
+    }
+    if (i < n) {
+        const __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+        _mm512_mask_storeu_ps(out + i, mask, _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, in + i), f));
+    }
+}
+
+constexpr KernelTable kAvx2Kernels{"avx2", dotAvx2, scaleAvx2, toFp16F16c, fromFp16F16c};
+constexpr KernelTable kAvx512Kernels{"avx512", dotAvx512, scaleAvx512, toFp16F16c, fromFp16F16c};
+
+#endif // CODE_CHUNK_HAVE_X86_KERNELS
+
+// ---------------------------------------------------------------------------------------------------------
+// AArch64: NEON
+
+#ifdef CODE_CHUNK_HAVE_NEON_KERNELS
+
+float dotNeon(const float* a, const float* b, size_t n) {
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    for (; i + 4 <= n; i += 4) {
+        acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+    float result = vaddvq_f32(vaddq_f32(acc0, acc1));
+    for (; i < n; ++i) {
+        result += a[i] * b[i];
+    }
+    return result;
+}
+
+void scaleNeon(const float* in, float factor, float* out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(out + i, vmulq_n_f32(vld1q_f32(in + i), factor));
+    }
+    for (; i < n; ++i) {
+        out[i] = in[i] * factor;
+    }
+}
+
+void toFp16Neon(const float* in, uint16_t* out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1_u16(out + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(in + i))));
+    }
+    for (; i < n; ++i) {
+        out[i] = toFp16Scalar(in[i]);
+    }
+}
+
+void fromFp16Neon(const uint16_t* in, float* out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(out + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(in + i))));
+    }
+    for (; i < n; ++i) {
+        out[i] = fromFp16Scalar(in[i]);
+    }
+}
+
+constexpr KernelTable kNeonKernels{"neon", dotNeon, scaleNeon, toFp16Neon, fromFp16Neon};
+
+#endif // CODE_CHUNK_HAVE_NEON_KERNELS
+
+/**
+ * @brief Selects the best kernel set supported by the CPU, capped by CODE_CHUNK_KERNELS.
+ */
+const KernelTable& selectKernels() {
+    const char* env = std::getenv("CODE_CHUNK_KERNELS");
+    const std::string_view cap = env ? env : "";
+    if (cap == "scalar") {
+        return kScalarKernels;
+    }
+
+#ifdef CODE_CHUNK_HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    const bool hasAvx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+                         __builtin_cpu_supports("f16c");
+    if (hasAvx2 && __builtin_cpu_supports("avx512f") && cap != "avx2") {
+        return kAvx512Kernels;
+    }
+    if (hasAvx2) {
+        return kAvx2Kernels;
+    }
+#endif
+
+#ifdef CODE_CHUNK_HAVE_NEON_KERNELS
+    return kNeonKernels;
+#endif
+
+    return kScalarKernels;
+}
+
+const KernelTable& kernels() {
+    static const KernelTable& table = selectKernels();
+    return table;
+}
+
+} // namespace
+
+/**
+ * @brief Returns the name of the kernel set selected for this CPU.
+ */
+const char* vectorKernelName() {
+    return kernels().name;
+}
+
+/**
+ * @brief Computes the dot product of two vectors.
+ */
+float dotProduct(const float* a, const float* b, size_t n) {
+    return kernels().dot(a, b, n);
+}
+
+/**
+ * @brief Scales a vector to unit L2 norm; a zero vector is copied unchanged.
+ */
+void normalizeVector(const float* in, float* out, size_t n) {
+    const KernelTable& k = kernels();
+    const float norm = std::sqrt(k.dot(in, in, n));
+    if (norm == 0.0f) {
+        if (out != in) {
+            std::memmove(out, in, n * sizeof(float));
+        }
+        return;
+    }
+    k.scale(in, 1.0f / norm, out, n);
+}
+
+/**
+ * @brief Computes the dot product of a query with every row of a matrix.
+ */
+void dotBatch(const float* query, const float* matrix, size_t rows, size_t dim, float* scores) {
+    const KernelTable& k = kernels();
+    for (size_t r = 0; r < rows; ++r) {
+        scores[r] = k.dot(query, matrix + r * dim, dim);
+    }
+}
+
+/**
+ * @brief Computes the cosine similarity of a query with every row of a matrix.
+ */
+void cosineBatch(const float* query, const float* matrix, size_t rows, size_t dim, float* scores) {
+    const KernelTable& k = kernels();
+    const float queryNorm = std::sqrt(k.dot(query, query, dim));
+    for (size_t r = 0; r < rows; ++r) {
+        const float* row = matrix + r * dim;
+        const float denom = queryNorm * std::sqrt(k.dot(row, row, dim));
+        scores[r] = denom > 0.0f ? k.dot(query, row, dim) / denom : 0.0f;
+    }
+}
+
+/**
+ * @brief Converts single-precision floats to IEEE half precision.
+ */
+void fp32ToFp16(const float* in, uint16_t* out, size_t n) {
+    kernels().toFp16(in, out, n);
+}
+
+/**
+ * @brief Converts IEEE half-precision values to single precision.
+ */
+void fp16ToFp32(const uint16_t* in, float* out, size_t n) {
+    kernels().fromFp16(in, out, n);
+}
+
+/**
+ * @brief Quantizes a vector to int8 with one symmetric scale derived from its largest magnitude.
+ */
+float quantizeInt8(const float* in, int8_t* out, size_t n) {
+    float maxAbs = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        maxAbs = std::max(maxAbs, std::fabs(in[i]));
+    }
+    const float scale = maxAbs > 0.0f ? maxAbs / 127.0f : 1.0f;
+    const float inverse = 1.0f / scale;
+    for (size_t i = 0; i < n; ++i) {
+        const float q = std::nearbyint(in[i] * inverse);
+        out[i] = static_cast<int8_t>(std::clamp(q, -127.0f, 127.0f));
+    }
+    return scale;
+}
+
+/**
+ * @brief Converts int8 values back to single precision.
+ */
+void dequantizeInt8(const int8_t* in, float scale, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = static_cast<float>(in[i]) * scale;
+    }
+}
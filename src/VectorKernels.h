@@ -0,0 +1,91 @@
+/**
+ * @file VectorKernels.h
+ * @brief This file contains the declarations of the SIMD vector kernels used on embeddings.
+ *
+ * Every kernel has a scalar implementation and, depending on the target architecture selected by CMake,
+ * AVX2/FMA and AVX-512 variants on x86 or a NEON variant on AArch64. The best variant supported by the CPU
+ * is chosen once at run time. Setting the CODE_CHUNK_KERNELS environment variable to "scalar", "avx2",
+ * "avx512" or "neon" caps the selection, which is useful to compare implementations.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Returns the name of the kernel set selected for this CPU.
+ */
+const char* vectorKernelName();
+
+/**
+ * @brief Computes the dot product of two vectors.
+ * @param a The first vector.
+ * @param b The second vector.
+ * @param n The number of elements.
+ * @return The dot product.
+ */
+float dotProduct(const float* a, const float* b, size_t n);
+
+/**
+ * @brief Scales a vector to unit L2 norm.
+ * @param in The input vector.
+ * @param out The output vector, which may alias the input. A zero vector is copied unchanged.
+ * @param n The number of elements.
+ */
+void normalizeVector(const float* in, float* out, size_t n);
+
+/**
+ * @brief Computes the dot product of a query with every row of a matrix.
+ * @param query The query vector of dim elements.
+ * @param matrix The row-major matrix of rows x dim elements.
+ * @param rows The number of rows.
+ * @param dim The number of columns.
+ * @param scores Receives one score per row.
+ *
+ * For normalized vectors the dot product is the cosine similarity.
+ */
+void dotBatch(const float* query, const float* matrix, size_t rows, size_t dim, float* scores);
+
+/**
+ * @brief Computes the cosine similarity of a query with every row of a matrix.
+ * @param query The query vector of dim elements.
+ * @param matrix The row-major matrix of rows x dim elements.
+ * @param rows The number of rows.
+ * @param dim The number of columns.
+ * @param scores Receives one similarity per row, 0 for zero rows.
+ */
+void cosineBatch(const float* query, const float* matrix, size_t rows, size_t dim, float* scores);
+
+/**
+ * @brief Converts single-precision floats to IEEE half precision, rounding to nearest even.
+ * @param in The input values.
+ * @param out The output half-precision bit patterns.
+ * @param n The number of elements.
+ */
+void fp32ToFp16(const float* in, uint16_t* out, size_t n);
+
+/**
+ * @brief Converts IEEE half-precision values to single precision.
+ * @param in The input half-precision bit patterns.
+ * @param out The output values.
+ * @param n The number of elements.
+ */
+void fp16ToFp32(const uint16_t* in, float* out, size_t n);
+
+/**
+ * @brief Quantizes a vector to int8 with one symmetric scale.
+ * @param in The input values.
+ * @param out The quantized values, in [-127, 127].
+ * @param n The number of elements.
+ * @return The scale; in[i] is approximately out[i] * scale.
+ */
+float quantizeInt8(const float* in, int8_t* out, size_t n);
+
+/**
+ * @brief Converts int8 values back to single precision.
+ * @param in The quantized values.
+ * @param scale The scale returned by quantizeInt8.
+ * @param out The output values.
+ * @param n The number of elements.
+ */
+void dequantizeInt8(const int8_t* in, float scale, float* out, size_t n);
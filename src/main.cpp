@@ -14,9 +14,255 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <chrono>
+#include <memory>
 #include "ModelLoader.h"
+#include "ChunkPlanner.h"
+#include "CompileFlags.h"
+#include "Crawler.h"
+#include "Daemon.h"
+#include "DefinitionSet.h"
+#include "EmbeddingEngine.h"
+#include "EmbeddingIndex.h"
 #include "FileUtils.h"
-#include "FunctionExtractor.h"
+#include "FunctionCache.h"
+#include "FunctionSplitter.h"
+#include "HnswIndex.h"
+#include "LexicalExtractor.h"
+#include "NearDuplicates.h"
+#include "Hash.h"
+#include "Options.h"
+#include "ParallelExtractor.h"
+#include "ShardFile.h"
+#include "StreamingPipeline.h"
+#include "TokenEstimator.h"
+#include "Tokenizer.h"
+#include "Trace.h"
+#include "VectorKernels.h"
+
+/**
+ * @brief Frees a loaded model when its owner goes out of scope, on every exit path.
+ */
+struct ModelDeleter {
+    void operator()(llama_model* model) const { llama_free_model(model); }
+};
+using ModelHandle = std::unique_ptr<llama_model, ModelDeleter>;
+
+/**
+ * @brief Prints the instrumentation summary and writes the trace file, if requested.
+ * @param options The parsed command-line options.
+ */
+static void finishTrace(const Options& options) {
+    if (!traceEnabled()) {
+        return;
+    }
+    traceReport(std::cerr);
+    if (!options.tracePath.empty()) {
+        traceWriteChrome(options.tracePath);
+    }
+}
+
+/**
+ * @brief Appends the functions to the binary index and rebuilds its graph, if requested.
+ * @param options The parsed command-line options.
+ * @param functionsInfo The functions.
+ * @param embeddings One row per function, or empty.
+ * @param embeddingDimension The number of embedding dimensions.
+ * @param coveredFiles Every input file of the run.
+ * @param root The input path; indexed files under it that are not covered were removed and leave the index.
+ * @return False if the index could not be updated.
+ */
+static bool updateIndex(const Options& options, const FunctionTable& functionsInfo,
+                        const std::vector<float>& embeddings, size_t embeddingDimension,
+                        const std::vector<std::string>& coveredFiles, const std::string& root) {
+    EmbeddingIndex index;
+    if (!index.open(options.indexDir) ||
+        !index.append(functionsInfo, embeddings.empty() ? nullptr : embeddings.data(), embeddingDimension,
+                      options.indexType, coveredFiles, root) ||
+        (options.compactIndex && !index.compact(options.indexType))) {
+        std::cerr << "Failed to update index " << options.indexDir << std::endl;
+        return false;
+    }
+    std::cerr << "Index: " << index.segments().size() << " segments, " << index.liveCount() << " live records"
+              << std::endl;
+
+    if (options.buildAnn) {
+        size_t dimension = 0;
+        std::vector<float> matrix = index.liveEmbeddings(dimension);
+        if (dimension == 0) {
+            std::cerr << "The index has no embeddings; run with --embed to build the graph." << std::endl;
+            return false;
+        }
+        HnswIndex ann(dimension, options.annParams);
+        ann.build(matrix.data(), matrix.size() / dimension, options.threads);
+        if (!ann.save(index.annPath())) {
+            std::cerr << "Failed to write " << index.annPath() << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Prints every function, then packs them into chunks and prints the chunks.
+ * @param options The parsed command-line options.
+ * @param functionsInfo The functions.
+ * @param representatives For every function, the function whose embedding it shares, or empty.
+ */
+static void printReport(const Options& options, const FunctionTable& functionsInfo,
+                        const std::vector<uint32_t>& representatives) {
+    for (size_t i = 0; i < functionsInfo.size(); ++i) {
+        std::cout << "File: " << functionsInfo.filePath(i)
+                  << "\nFunction: " << functionsInfo.signature(i)
+                  << "\nStart Line: " << functionsInfo.startLine(i)
+                  << "\nEnd Line: " << functionsInfo.endLine(i)
+                  << "\nToken Count: " << functionsInfo.tokenCount(i) << std::endl;
+        if (functionsInfo.fragment(i) >= 0) {
+            std::cout << "Fragment: " << functionsInfo.fragment(i) + 1 << std::endl;
+        }
+        if (!representatives.empty() && representatives[i] != i) {
+            const uint32_t representative = representatives[i];
+            std::cout << "Duplicate Of: " << functionsInfo.filePath(representative) << ":"
+                      << functionsInfo.startLine(representative) << " " << functionsInfo.signature(representative)
+                      << std::endl;
+        }
+    }
+
+    const int64_t totalTokens = functionsInfo.totalTokens();
+
+    const int chunkBudget = options.chunkSize > 0 ? options.chunkSize : ChunkPlanner::suggestBudget(functionsInfo);
+    ChunkPlanner planner(chunkBudget, options.packing);
+    ChunkPlan plan = planner.plan(functionsInfo);
+
+    const int64_t padding = static_cast<int64_t>(plan.size()) * chunkBudget - totalTokens;
+    std::cout << "Total Tokens: " << totalTokens << std::endl;
+    std::cout << "Chunk Size: " << chunkBudget << std::endl;
+    std::cout << "Number of Chunks: " << plan.size() << std::endl;
+    std::cout << "Padding: " << std::max<int64_t>(padding, 0) << std::endl;
+
+    for (size_t i = 0; i < plan.size(); ++i) {
+        const Chunk& chunk = plan.chunks[i];
+        std::cout << "Chunk " << i + 1 << " (Total Tokens: " << chunk.tokenCount << "):" << std::endl;
+        for (size_t k = 0; k < chunk.size(); ++k) {
+            const uint32_t index = plan.function(chunk, k);
+            std::cout << "  - " << functionsInfo.signature(index) << " (" << functionsInfo.tokenCount(index)
+                      << " tokens)" << std::endl;
+        }
+    }
+}
+
+/**
+ * @brief Merges shard files and reports the result like a single run over the whole tree.
+ * @param options The parsed command-line options.
+ * @return The exit status of the program.
+ */
+static int runMerge(const Options& options) {
+    std::vector<std::filesystem::path> paths(options.shardFiles.begin(), options.shardFiles.end());
+    FunctionTable functionsInfo;
+    std::vector<float> embeddings;
+    size_t embeddingDimension = 0;
+    std::vector<std::string> coveredFiles;
+    std::string root;
+    if (!mergeShardFiles(paths, functionsInfo, embeddings, embeddingDimension, &coveredFiles, &root)) {
+        return 1;
+    }
+    if (embeddingDimension > 0) {
+        std::cout << "Embedded " << functionsInfo.size() << " functions (" << embeddingDimension << " dimensions)"
+                  << std::endl;
+    }
+    if (!options.indexDir.empty() &&
+        !updateIndex(options, functionsInfo, embeddings, embeddingDimension, coveredFiles, root)) {
+        return 1;
+    }
+    printReport(options, functionsInfo, {});
+    finishTrace(options);
+    return 0;
+}
+
+/**
+ * @brief Prints the indexed functions closest to the embedding of a text.
+ *
+ * The search walks the HNSW graph stored next to the index. An index without a graph, or whose graph no longer
+ * matches the live records, is searched exhaustively instead.
+ *
+ * @param options The parsed command-line options.
+ * @return The exit status of the program.
+ */
+static int runQuery(const Options& options) {
+    EmbeddingIndex index;
+    if (!index.open(options.indexDir)) {
+        std::cerr << "Failed to open index " << options.indexDir << std::endl;
+        return 1;
+    }
+    size_t dimension = 0;
+    const std::vector<float> matrix = index.liveEmbeddings(dimension);
+    if (dimension == 0) {
+        std::cerr << "The index has no embeddings; run with --embed to add them." << std::endl;
+        return 1;
+    }
+    const size_t rows = matrix.size() / dimension;
+
+    const ModelHandle embeddingModelHandle(load_model(options.embeddingModelPath.c_str(), false));
+    llama_model* embeddingModel = embeddingModelHandle.get();
+    if (!embeddingModel) {
+        std::cerr << "Failed to load embedding model." << std::endl;
+        return 1;
+    }
+    std::vector<float> query;
+    {
+        EmbeddingEngine engine(embeddingModel);
+        if (!engine.valid()) {
+            return 1;
+        }
+        std::vector<std::vector<llama_token>> sequences(1);
+        Tokenizer(embeddingModel).tokenize(options.queryText, sequences[0]);
+        if (!engine.embed(sequences, query)) {
+            query.clear();
+        }
+    }
+    if (query.empty()) {
+        std::cerr << "Failed to embed the query." << std::endl;
+        return 1;
+    }
+    if (query.size() != dimension) {
+        std::cerr << "The embedding model has " << query.size() << " dimensions, the index " << dimension
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<SearchResult> results;
+    HnswIndex ann(dimension);
+    if (ann.load(index.annPath(), matrix.data(), rows)) {
+        TRACE_SCOPE("ann_search");
+        results = ann.search(query.data(), options.topK, options.annEfSearch);
+    } else {
+        TRACE_SCOPE("exact_search");
+        std::cerr << "No usable graph at " << index.annPath() << "; searching all " << rows << " records"
+                  << std::endl;
+        std::vector<float> scores(rows);
+        dotBatch(query.data(), matrix.data(), rows, dimension, scores.data());
+        for (size_t i = 0; i < rows; ++i) {
+            results.push_back({scores[i], static_cast<uint32_t>(i)});
+        }
+        const size_t count = std::min<size_t>(options.topK, results.size());
+        std::partial_sort(results.begin(), results.begin() + count, results.end(),
+                          [](const SearchResult& a, const SearchResult& b) { return a.similarity > b.similarity; });
+        results.resize(count);
+    }
+
+    const auto live = index.liveRecords();
+    for (const SearchResult& result : results) {
+        const IndexSegment& segment = index.segments()[live[result.id].first];
+        const size_t i = live[result.id].second;
+        std::cout << "File: " << segment.filePath(i)
+                  << "\nFunction: " << segment.signature(i)
+                  << "\nStart Line: " << segment.record(i).startLine
+                  << "\nEnd Line: " << segment.record(i).endLine
+                  << "\nSimilarity: " << result.similarity << std::endl;
+    }
+    finishTrace(options);
+    return 0;
+}
 
 /**
  * @brief The main function of the program.
@@ -25,133 +271,238 @@
  * @return The exit status of the program.
  *
  * This function is the entry point of the program. It processes command-line arguments, loads models,
- * parses the source files, extracts function information, and performs various operations on the function data.
+ * parses the source files in parallel, extracts function information, and performs various operations on the function data.
  */
 int main(int argc, char** argv) {
-    // Adjusting the argument count check to expect one more argument
-    if (argc < 4) {
-        std::cerr << "Usage: " << argv[0] << " <model_path> <model_type> <filename>\n";
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
         return 1;
     }
+    if (options.stats || !options.tracePath.empty()) {
+        traceEnable(!options.tracePath.empty());
+    }
+    if (options.merge) {
+        return runMerge(options);
+    }
+    if (options.query) {
+        return runQuery(options);
+    }
 
-    // Additional setup or configuration based on the model_type could be done here
-    const std::string modelPath = argv[1];
-    const std::string modelType = argv[2]; // New: Use the model type argument
-    const std::string filename = argv[3];
-
-    llama_model* model = load_model(argv[1]);
+    const ModelHandle modelHandle(load_model(options.modelPath.c_str()));
+    llama_model* model = modelHandle.get();
     if (!model) {
         std::cerr << "Failed to load model." << std::endl;
         return 1;
     }
 
-    llama_model* embeddingModel = load_model(argv[2]);
+    const ModelHandle embeddingModelHandle(load_model(options.embeddingModelPath.c_str(), !options.embed));
+    llama_model* embeddingModel = embeddingModelHandle.get();
     if (!embeddingModel) {
         std::cerr << "Failed to load embedding model." << std::endl;
         return 1;
     }
 
-    std::vector<std::string> sourceLines = readSourceFiles(argv[2]);
+    CrawlStats crawlStats;
+    std::vector<std::filesystem::path> sourceFiles = crawlSourceFiles(options.inputPath, options.crawl, &crawlStats);
+    if (crawlStats.excluded + crawlStats.tooLarge + crawlStats.generated > 0) {
+        std::cerr << "Found " << crawlStats.files << " source files in " << crawlStats.directories
+                  << " directories; skipped " << crawlStats.excluded << " excluded, " << crawlStats.tooLarge
+                  << " too large, " << crawlStats.generated << " generated" << std::endl;
+    }
+    if (sourceFiles.empty()) {
+        std::cerr << "No source files found in " << options.inputPath << std::endl;
+        return 1;
+    }
 
-    VisitorData data;
-    data.model = model;
-    data.sourceLines = &sourceLines;
-    std::vector<FunctionInfo> functionsInfo;
-    data.functionsInfo = &functionsInfo;
+    // A shard keeps its part of the file list and remembers where each of its files sits in the whole
+    ShardHeader shardHeader{};
+    std::vector<uint32_t> shardPositions;
+    if (options.shardCount > 0) {
+        shardHeader.shard = options.shard;
+        shardHeader.shardCount = options.shardCount;
+        shardHeader.fileListHash = hashFileList(sourceFiles, options.inputPath);
+        sourceFiles =
+            selectShardFiles(sourceFiles, options.inputPath, options.shard, options.shardCount, shardPositions);
+    }
 
-    CXIndex index = clang_createIndex(0, 0);
-    CXTranslationUnit unit = clang_parseTranslationUnit(
-        index,
-        argv[2],
-        nullptr, 0,
-        nullptr, 0,
-        CXTranslationUnit_None);
+    std::unique_ptr<FunctionCache> cache;
+    if (!options.cacheDir.empty()) {
+        uint64_t fingerprint = hashCombine(model_fingerprint(model), model_fingerprint(embeddingModel));
+        cache = std::make_unique<FunctionCache>(options.cacheDir, fingerprint);
+    }
 
-    if (unit == nullptr) {
-        std::cerr << "Unable to parse translation unit. Quitting." << std::endl;
+    CompileFlags compileFlags;
+    if (!options.compileCommandsDir.empty() && !compileFlags.loadDatabase(options.compileCommandsDir)) {
         return 1;
     }
+    if (!options.pchDir.empty()) {
+        compileFlags.buildPrecompiledHeader(sourceFiles, options.pchDir);
+    }
+
+    Tokenizer tokenizer(model);
+    const ExtractMode extractMode = options.lexical ? ExtractMode::Lexical : ExtractMode::Ast;
+
+    // Split functions that would not fit a chunk, so one generated giant does not set the budget for all
+    SplitParams splitParams;
+    splitParams.maxTokens = options.splitTokens >= 0 ? options.splitTokens
+                            : options.chunkSize > 0  ? options.chunkSize
+                                                     : llama_n_ctx_train(model);
+    if (options.embed && splitParams.maxTokens > 0) {
+        // A fragment longer than the embedding engine takes whole would be embedded from its prefix only
+        const int embedLimit = static_cast<int>(EmbeddingEngine::maxSequenceTokens(embeddingModel));
+        splitParams.maxTokens = std::min(splitParams.maxTokens, embedLimit);
+    }
+    splitParams.overlapTokens = options.splitOverlap;
+    FunctionSplitter splitter(tokenizer, splitParams);
+    const FunctionSplitter* activeSplitter = splitter.enabled() ? &splitter : nullptr;
 
-    CXCursor cursor = clang_getTranslationUnitCursor(unit);
-    clang_visitChildren(cursor, visitor, &data);
+    // Header functions are claimed by the first translation unit that reaches them
+    DefinitionSet definitions;
+    DefinitionSet* headerDefinitions = options.headers ? &definitions : nullptr;
 
-    clang_disposeTranslationUnit(unit);
-    clang_disposeIndex(index);
+    if (!options.daemonSocket.empty()) {
+        DaemonOptions daemon;
+        daemon.socketPath = options.daemonSocket;
+        daemon.root = options.inputPath;
+        daemon.threads = options.threads;
+        daemon.chunkBudget = options.chunkSize;
+        daemon.packing = options.packing;
+        daemon.mode = extractMode;
+        daemon.compileFlags = &compileFlags;
+        daemon.splitter = activeSplitter;
+        daemon.embed = options.embed;
+        daemon.warmUnits = options.warmUnits;
+        daemon.crawl = options.crawl;
 
-    for (const auto& info : functionsInfo) {
-        std::cout << "Function: " << info.signature
-                  << "\nStart Line: " << info.startLine
-                  << "\nEnd Line: " << info.endLine
-                  << "\nToken Count: " << info.tokenCount << std::endl;
+        const bool ok = runDaemon(daemon, tokenizer, embeddingModel, cache.get());
+        finishTrace(options);
+        return ok ? 0 : 1;
     }
 
-    int totalTokens = 0;
-    int maxTokenCount = 0;
-    for (const auto& info : functionsInfo) {
-        totalTokens += info.tokenCount;
-        maxTokenCount = std::max(maxTokenCount, info.tokenCount);
+    if (options.verifyLexical) {
+        using Clock = std::chrono::steady_clock;
+        const auto astStart = Clock::now();
+        FunctionTable ast = extractFunctionsParallel(sourceFiles, &tokenizer, options.threads, cache.get(),
+                                                     &compileFlags, ExtractMode::Ast);
+        const auto lexicalStart = Clock::now();
+        FunctionTable lexical = extractFunctionsParallel(sourceFiles, &tokenizer, options.threads, cache.get(),
+                                                         &compileFlags, ExtractMode::Lexical);
+        const auto end = Clock::now();
+
+        const size_t differences = compareExtractions(ast, lexical, std::cerr);
+        const double astMs = std::chrono::duration<double, std::milli>(lexicalStart - astStart).count();
+        const double lexicalMs = std::chrono::duration<double, std::milli>(end - lexicalStart).count();
+        std::cerr << "AST: " << astMs << " ms, lexical: " << lexicalMs << " ms" << std::endl;
+        finishTrace(options);
+        return differences == 0 ? 0 : 1;
     }
 
-    int chunkSize = std::pow(2, std::ceil(std::log2(maxTokenCount)));
-    int optimalChunkSize = chunkSize;
-    int minPadding = totalTokens;
-    int optimalNumChunks = 0;
-    for (int currentChunkSize = chunkSize; currentChunkSize <= totalTokens; currentChunkSize *= 2) {
-        int numChunks = std::ceil(static_cast<double>(totalTokens) / currentChunkSize);
-        int totalCapacity = numChunks * currentChunkSize;
-        int currentPadding = totalCapacity - totalTokens;
+    if (options.stream) {
+        StreamingOptions streaming;
+        streaming.extractThreads = options.stageThreads[0] ? options.stageThreads[0] : options.threads;
+        streaming.readThreads = options.readThreads;
+        streaming.tokenizeThreads = options.stageThreads[1];
+        streaming.embedThreads = options.stageThreads[2];
+        streaming.queueDepth = options.queueDepth;
+        streaming.chunkBudget = options.chunkSize > 0 ? options.chunkSize : llama_n_ctx_train(model);
+        streaming.embed = options.embed;
+        streaming.outputPath = options.outputPath;
+        streaming.indexDir = options.indexDir;
+        streaming.inputPath = options.inputPath;
+        streaming.indexType = options.indexType;
+        streaming.compileFlags = &compileFlags;
+        streaming.lexical = options.lexical;
+        streaming.splitter = activeSplitter;
+        streaming.definitions = headerDefinitions;
 
-        if (currentPadding < minPadding) {
-            minPadding = currentPadding;
-            optimalChunkSize = currentChunkSize;
-            optimalNumChunks = numChunks;
+        StreamingStats stats;
+        const bool ok = runStreamingPipeline(sourceFiles, tokenizer, embeddingModel, cache.get(), streaming, stats);
+        std::cerr << "Streamed " << stats.files << " files, " << stats.functions << " functions, " << stats.tokens
+                  << " tokens into " << stats.chunks << " chunks" << std::endl;
+        if (cache) {
+            std::cerr << "Cache: " << cache->hits() << " hits, " << cache->misses() << " misses" << std::endl;
+        }
+        finishTrace(options);
+        return ok ? 0 : 1;
+    }
+
+    std::vector<uint32_t> fileIndices;
+    FunctionTable functionsInfo = extractFunctionsParallel(
+        sourceFiles, options.estimateTokens ? nullptr : &tokenizer, options.threads, cache.get(), &compileFlags,
+        extractMode, activeSplitter, headerDefinitions, options.shardCount > 0 ? &fileIndices : nullptr,
+        options.readThreads);
+    if (options.estimateTokens) {
+        TokenEstimator estimator;
+        EstimateStats estimateStats;
+        const int boundary = options.chunkSize > 0 ? options.chunkSize : splitParams.maxTokens;
+        estimateFunctionTokens(functionsInfo, tokenizer, cache.get(), boundary, options.threads, estimator,
+                               estimateStats);
+        std::cerr << "Estimated " << estimateStats.estimated << " functions, counted " << estimateStats.exact
+                  << " exactly; total tokens between " << estimateStats.low << " and " << estimateStats.high
+                  << std::endl;
+    }
 
-            if (minPadding == 0) break;
-        } else {
-            break;
+    // Functions that share an embedding with an earlier near-duplicate; empty unless --dedup is given
+    std::vector<uint32_t> representatives;
+    if (options.dedupThreshold > 0.0) {
+        NearDuplicateParams dedupParams;
+        dedupParams.threshold = options.dedupThreshold;
+        representatives = findNearDuplicates(functionsInfo, dedupParams, options.threads);
+        size_t duplicates = 0;
+        for (size_t i = 0; i < representatives.size(); ++i) {
+            duplicates += representatives[i] != i;
         }
+        std::cerr << "Near-duplicates: " << duplicates << " of " << functionsInfo.size()
+                  << " functions reuse an embedding" << std::endl;
     }
 
-    std::cout << "Total Tokens: " << totalTokens << std::endl;
-    std::cout << "Minimum Chunk Size (Power of 2): " << chunkSize << std::endl;
-    std::cout << "Optimal Chunk Size (Power of 2): " << optimalChunkSize << std::endl;
-    std::cout << "Number of Chunks: " << optimalNumChunks << std::endl;
-    std::cout << "Min padding: " << minPadding << std::endl;
-
-    std::vector<std::vector<FunctionInfo>> chunks;
-    std::vector<int> chunkTokenCounts;
-
-    for (const auto& func : functionsInfo) {
-        bool addedToChunk = false;
-
-        for (size_t i = 0; i < chunks.size(); ++i) {
-            if (chunkTokenCounts[i] + func.tokenCount <= optimalChunkSize) {
-                chunks[i].push_back(func);
-                chunkTokenCounts[i] += func.tokenCount;
-                addedToChunk = true;
-                break;
-            }
+    std::vector<float> embeddings;
+    size_t embeddingDimension = 0;
+    if (options.embed) {
+        EmbeddingEngineParams engineParams;
+        engineParams.threads = options.threads;
+        EmbeddingEngine engine(embeddingModel, engineParams);
+        if (!engine.valid()) {
+            return 1;
         }
+        Tokenizer embeddingTokenizer(embeddingModel);
+        embeddings = embedFunctions(functionsInfo, engine, embeddingTokenizer, cache.get(),
+                                    representatives.empty() ? nullptr : &representatives, !options.estimateTokens);
+        embeddingDimension = engine.dimension();
+        std::cout << "Embedded " << functionsInfo.size() << " functions (" << engine.dimension() << " dimensions)"
+                  << std::endl;
+    }
 
-        if (!addedToChunk) {
-            std::vector<FunctionInfo> newChunk = {func};
-            chunks.push_back(newChunk);
-            chunkTokenCounts.push_back(func.tokenCount);
+    if (options.shardCount > 0) {
+        for (uint32_t& fileIndex : fileIndices) {
+            if (fileIndex != kHeaderFileIndex) {
+                fileIndex = shardPositions[fileIndex];
+            }
         }
+        const bool ok = writeShardFile(options.outputPath, shardHeader, functionsInfo, fileIndices,
+                                       embeddings.empty() ? nullptr : embeddings.data(), embeddingDimension,
+                                       options.inputPath, sourceFiles);
+        std::cerr << "Shard " << options.shard << "/" << options.shardCount << ": " << sourceFiles.size()
+                  << " files, " << functionsInfo.size() << " functions written to " << options.outputPath
+                  << std::endl;
+        finishTrace(options);
+        return ok ? 0 : 1;
     }
 
-    for (size_t i = 0; i < chunks.size(); ++i) {
-        int chunkTokenCount = std::accumulate(chunks[i].begin(), chunks[i].end(), 0,
-            [](int sum, const FunctionInfo& fi) { return sum + fi.tokenCount; });
+    if (!options.indexDir.empty() &&
+        !updateIndex(options, functionsInfo, embeddings, embeddingDimension,
+                     std::vector<std::string>(sourceFiles.begin(), sourceFiles.end()), options.inputPath)) {
+        return 1;
+    }
 
-        std::cout << "Chunk " << i + 1 << " (Total Tokens: " << chunkTokenCount << "):" << std::endl;
-        for (const auto& func : chunks[i]) {
-            std::cout << "  - " << func.signature << " (" << func.tokenCount << " tokens)" << std::endl;
-        }
+    if (cache) {
+        std::cerr << "Cache: " << cache->hits() << " hits, " << cache->misses() << " misses" << std::endl;
     }
 
-    llama_free_model(model); // Free the main model
-    llama_free_model(embeddingModel); // Free the embedding model
+    printReport(options, functionsInfo, representatives);
+
+    finishTrace(options);
 
     return 0;
 }
\ No newline at end of file